@@ -52,6 +52,7 @@
 
 #include "misc.h"
 #include "bconf.h" 
+#include "checkpoint.h"
 
 struct stat_stat_t *bconf_correct_dist = NULL;
 struct stat_stat_t *bconf_incorrect_dist = NULL;
@@ -476,3 +477,30 @@ bconf_after_priming(struct bconf *bc)
 
   bc->very_low = 0;
 }
+
+/* write confidence table and history to a checkpoint */
+void
+bconf_ckpt_save(struct bconf *bc, FILE *fd)
+{
+  ckpt_put_tag(fd, "bconf");
+  CKPT_PUT(fd, bc->table_size);
+  CKPT_PUT(fd, bc->gbhr);
+  CKPT_PUT(fd, bc->very_low);
+  ckpt_write(fd, bc->table, bc->table_size * sizeof(int));
+}
+
+/* read confidence table and history back from a checkpoint */
+void
+bconf_ckpt_restore(struct bconf *bc, FILE *fd)
+{
+  int table_size;
+
+  ckpt_get_tag(fd, "bconf");
+  CKPT_GET(fd, table_size);
+  if (table_size != bc->table_size)
+    fatal("checkpoint: confidence table was saved with %d entries",
+	  table_size);
+  CKPT_GET(fd, bc->gbhr);
+  CKPT_GET(fd, bc->very_low);
+  ckpt_read(fd, bc->table, bc->table_size * sizeof(int));
+}
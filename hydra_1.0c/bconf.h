@@ -36,6 +36,7 @@
 #ifndef BCONF_H
 #define BCONF_H
 
+#include <stdio.h>
 #include "ss.h"
 #include "stats.h"
 
@@ -127,4 +128,12 @@ bconf_reg_stats(struct bconf *bc,
 void
 bconf_after_priming(struct bconf *bc);
 
+/* write confidence table and history to a checkpoint */
+void
+bconf_ckpt_save(struct bconf *bc, FILE *fd);
+
+/* read confidence table and history back from a checkpoint */
+void
+bconf_ckpt_restore(struct bconf *bc, FILE *fd);
+
 #endif
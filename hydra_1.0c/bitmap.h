@@ -94,6 +94,11 @@
 /* BITMAPs:
      BMAP: int * to an array of ints
      SZ: number of ints in the bitmap
+
+   SZ need not be a compile-time constant; BITMAP_TYPE() with a run-time
+   BITS declares an automatic (variable-length) array.  Bitmaps of one or
+   two words, the common case for small thread configurations, are handled
+   without a loop.
 */
 
 /* declare a bitmap type */
@@ -105,13 +110,23 @@
 typedef unsigned int BITMAP_ENT_TYPE;
 typedef unsigned int *BITMAP_PTR_TYPE;
 
+/* apply STMT, which refers to word i, to each word of a SZ-word bitmap */
+#define __BITMAP_FOREACH(SZ, STMT)				\
+  { int i;							\
+    switch (SZ)							\
+      {								\
+      case 2: i = 1; STMT; /* fall through */			\
+      case 1: i = 0; STMT; break;				\
+      default: for (i=0; i<(SZ); i++) STMT;			\
+      } }
+
 /* set entire bitmap */
 #define BITMAP_SET_MAP(BMAP, SZ)				\
-  { int i; for (i=0; i<(SZ); i++) (BMAP)[i] = 0xffffffff; }
+  __BITMAP_FOREACH(SZ, (BMAP)[i] = 0xffffffff)
 
 /* clear entire bitmap */
 #define BITMAP_CLEAR_MAP(BMAP, SZ)				\
-  { int i; for (i=0; i<(SZ); i++) (BMAP)[i] = 0; }
+  __BITMAP_FOREACH(SZ, (BMAP)[i] = 0)
 
 /* set bit BIT in bitmap BMAP, returns BMAP */
 #define BITMAP_SET(BMAP, SZ, BIT)				\
@@ -123,11 +138,11 @@ typedef unsigned int *BITMAP_PTR_TYPE;
 
 /* copy bitmap SRC to DEST */
 #define BITMAP_COPY(DESTMAP, SRCMAP, SZ)			\
-  { int i; for (i=0; i<(SZ); i++) (DESTMAP)[i] = (SRCMAP)[i]; }
+  __BITMAP_FOREACH(SZ, (DESTMAP)[i] = (SRCMAP)[i])
 
 /* store bitmap B2 OP B3 into B1 */
 #define __BITMAP_OP(B1, B2, B3, SZ, OP)				\
-  { int i; for (i=0; i<(SZ); i++) (B1)[i] = (B2)[i] OP (B3)[i]; }
+  __BITMAP_FOREACH(SZ, (B1)[i] = (B2)[i] OP (B3)[i])
 
 /* store bitmap B2 | B3 into B1 */
 #define BITMAP_IOR(B1, B2, B3, SZ)				\
@@ -143,15 +158,17 @@ typedef unsigned int *BITMAP_PTR_TYPE;
 
 /* store ~B2 into B1 */
 #define BITMAP_NOT(B1, B2, SZ)					\
-  { int i; for (i=0; i<(SZ); i++) (B1)[i] = ~((B2)[i]); }
+  __BITMAP_FOREACH(SZ, (B1)[i] = ~((B2)[i]))
 
 /* return non-zero if bitmap is empty */
 #define BITMAP_EMPTY_P(BMAP, SZ)				\
-  ({ int i, res=0; for (i=0; i<(SZ); i++) res |= (BMAP)[i]; !res; })
+  ({ unsigned int res=0;					\
+     __BITMAP_FOREACH(SZ, res |= (BMAP)[i]); !res; })
 
 /* return non-zero if the intersection of bitmaps B1 and B2 is non-empty */
 #define BITMAP_DISJOINT_P(B1, B2, SZ)				\
-  ({ int i, res=0; for (i=0; i<(SZ); i++) res |= (B1)[i] & (B2)[i]; !res; })
+  ({ unsigned int res=0;					\
+     __BITMAP_FOREACH(SZ, res |= (B1)[i] & (B2)[i]); !res; })
 
 /* return non-zero if bit BIT is set in bitmap BMAP */
 #define BITMAP_SET_P(BMAP, SZ, BIT)				\
@@ -164,24 +181,43 @@ typedef unsigned int *BITMAP_PTR_TYPE;
 #define BITMAP_PRINT_BITSTR(BMAP, SZ, STREAM)			\
   { int i; for (i=0; i<(SZ); i++) fprintf((STREAM), "%08x", (BMAP)[i]); }
 
-#define BITMAP_COUNT_ONES(BMAP, SZ)                  \
-({                                                   \
-  int i, j, n = 0;                                   \
-  for (i = 0; i < (SZ) ; i++)                        \
-    {                                                \
-      unsigned int word = (BMAP)[i];                 \
-      for (j=0; j < (sizeof(unsigned int)*8); j++)   \
-	{                                            \
-	  unsigned int new_val, old_val = word;      \
-	  word >>= 1;                                \
-	  new_val = word << 1;                       \
-	  if (old_val != new_val)                    \
-	    n++;                                     \
-	}                                            \
-    }                                                \
-  n;                                                 \
-})
-	  
+/* return the number of bits set in bitmap BMAP */
+#define BITMAP_COUNT_ONES(BMAP, SZ)				\
+  ({ int n=0;							\
+     __BITMAP_FOREACH(SZ, n += __builtin_popcount((BMAP)[i])); n; })
+
+/* mask of the bits LO through HI (0..31) of a word */
+#define __BITMAP_WORD_MASK(LO, HI)				\
+  ((0xffffffffU << (LO)) & (0xffffffffU >> (31 - (HI))))
+
+/* return non-zero if bitmaps B1 and B2 differ in any of bits LO through HI,
+   LO <= HI; compares a word at a time, masking the partial end words */
+#define BITMAP_RANGE_DIFF_P(B1, B2, SZ, LO, HI)			\
+  ({ unsigned int __lo=(LO), __hi=(HI);				\
+     unsigned int __lw=__lo/32, __hw=__hi/32, __w, __diff;	\
+     if (__lw == __hw)						\
+       __diff = ((B1)[__lw] ^ (B2)[__lw])			\
+	 & __BITMAP_WORD_MASK(__lo % 32, __hi % 32);		\
+     else							\
+       {							\
+	 __diff = ((B1)[__lw] ^ (B2)[__lw])			\
+	   & __BITMAP_WORD_MASK(__lo % 32, 31);			\
+	 for (__w=__lw+1; __w<__hw && !__diff; __w++)		\
+	   __diff = (B1)[__w] ^ (B2)[__w];			\
+	 __diff |= ((B1)[__hw] ^ (B2)[__hw])			\
+	   & __BITMAP_WORD_MASK(0, __hi % 32);			\
+       }							\
+     __diff != 0; })
+
+/* return non-zero if bitmaps B1 and B2 match in all bits from FROM through
+   TO, counting up circularly in a bitmap used as a ring of NBITS bits (FROM
+   after TO wraps around through bit NBITS-1 to bit 0) */
+#define BITMAP_RING_MATCH_P(B1, B2, SZ, FROM, TO, NBITS)	\
+  ({ unsigned int __from=(FROM), __to=(TO);			\
+     (__from <= __to						\
+      ? !BITMAP_RANGE_DIFF_P(B1, B2, SZ, __from, __to)		\
+      : (!BITMAP_RANGE_DIFF_P(B1, B2, SZ, __from, (NBITS) - 1)	\
+	 && !BITMAP_RANGE_DIFF_P(B1, B2, SZ, 0, __to))); })
 
 #endif /* BITMAP_H */
 
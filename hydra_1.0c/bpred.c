@@ -404,6 +404,7 @@
 #include "misc.h"
 #include "ss.h"
 #include "bpred.h"
+#include "checkpoint.h"
 
 static unsigned char dummy_taken;
 static unsigned char dummy_nottaken;
@@ -1033,6 +1034,232 @@ bpred_after_priming(struct bpred *bpred)
 #endif
 }
 
+/* checkpoint record of a BTB or return-address-stack entry, with the LRU
+   chain pointers turned into indices into the same table */
+struct bpred_ckpt_ent {
+  SS_ADDR_TYPE addr;
+  enum ss_opcode op;
+  SS_ADDR_TYPE target;
+  int prev, next;
+};
+
+/* write the NUM entries of BTB-entry table TBL to checkpoint FD */
+static void
+bpred_ckpt_save_ents(struct bpred_btb_ent *tbl, int num, FILE *fd)
+{
+  struct bpred_ckpt_ent rec;
+  int i;
+
+  for (i=0; i < num; i++)
+    {
+      rec.addr = tbl[i].addr;
+      rec.op = tbl[i].op;
+      rec.target = tbl[i].target;
+      rec.prev = tbl[i].prev ? tbl[i].prev - tbl : -1;
+      rec.next = tbl[i].next ? tbl[i].next - tbl : -1;
+      CKPT_PUT(fd, rec);
+    }
+}
+
+/* read the NUM entries of BTB-entry table TBL from checkpoint FD */
+static void
+bpred_ckpt_restore_ents(struct bpred_btb_ent *tbl, int num, FILE *fd)
+{
+  struct bpred_ckpt_ent rec;
+  int i;
+
+  for (i=0; i < num; i++)
+    {
+      CKPT_GET(fd, rec);
+      if (rec.prev >= num || rec.next >= num)
+	fatal("checkpoint: bad BTB chain index");
+      tbl[i].addr = rec.addr;
+      tbl[i].op = rec.op;
+      tbl[i].target = rec.target;
+      tbl[i].prev = (rec.prev == -1) ? NULL : &tbl[rec.prev];
+      tbl[i].next = (rec.next == -1) ? NULL : &tbl[rec.next];
+    }
+}
+
+/* sizes of a predictor's tables, checked when a checkpoint is restored */
+struct bpred_ckpt_geom {
+  enum bpred_class class;
+  int dir1, dir2, btb, retstack, bq;
+};
+
+static void
+bpred_ckpt_geom(struct bpred *pred, struct bpred_ckpt_geom *geom)
+{
+  geom->class = pred->class;
+  geom->dir1 = geom->dir2 = 0;
+  switch (pred->class)
+    {
+    case BPredHybrid:
+      geom->dir1 = pred->dirpred.hybrid.size;
+      break;
+    case BPred2Level:
+      geom->dir1 = pred->dirpred.two.l1size;
+      geom->dir2 = pred->dirpred.two.l2size;
+      break;
+    case BPred2bit:
+      geom->dir1 = pred->dirpred.bimod.size;
+      break;
+    default:
+      break;
+    }
+  geom->btb = pred->btb.btb_data ? pred->btb.sets * pred->btb.assoc : 0;
+  geom->retstack = pred->retstack.stack ? pred->retstack.size : 0;
+  geom->bq = pred->bq.tbl ? pred->bq.size : 0;
+}
+
+/* write predictor tables, history and stats to a checkpoint */
+void
+bpred_ckpt_save(struct bpred *pred,	/* branch predictor instance */
+		FILE *fd)		/* checkpoint file */
+{
+  struct bpred_ckpt_geom geom;
+
+  ckpt_put_tag(fd, "bpred");
+  bpred_ckpt_geom(pred, &geom);
+  CKPT_PUT(fd, geom);
+
+  /* direction-predictor state */
+  CKPT_PUT(fd, pred->aux_global_shift_reg);
+  switch (pred->class)
+    {
+    case BPredHybrid:
+      CKPT_PUT(fd, pred->dirpred.hybrid.shift_reg);
+      ckpt_write(fd, pred->dirpred.hybrid.table, geom.dir1);
+      bpred_ckpt_save(pred->dirpred.hybrid.pred1, fd);
+      bpred_ckpt_save(pred->dirpred.hybrid.pred2, fd);
+      break;
+    case BPred2Level:
+      ckpt_write(fd, pred->dirpred.two.shiftregs,
+		 geom.dir1 * sizeof(struct bpred_tab1_ent));
+      ckpt_write(fd, pred->dirpred.two.l2table, geom.dir2);
+      break;
+    case BPred2bit:
+      ckpt_write(fd, pred->dirpred.bimod.table, geom.dir1);
+      break;
+    default:
+      break;
+    }
+
+  /* BTB, return-address stack, branch queue */
+  bpred_ckpt_save_ents(pred->btb.btb_data, geom.btb, fd);
+  bpred_ckpt_save_ents(pred->retstack.stack, geom.retstack, fd);
+  CKPT_PUT(fd, pred->retstack.tos);
+  CKPT_PUT(fd, pred->bq.head);
+  CKPT_PUT(fd, pred->bq.tail);
+  CKPT_PUT(fd, pred->bq.num);
+  ckpt_write(fd, pred->bq.tbl, geom.bq * sizeof(struct bq_ent));
+
+  /* stats */
+  CKPT_PUT(fd, pred->addr_hits);
+  CKPT_PUT(fd, pred->dir_hits);
+  CKPT_PUT(fd, pred->cond_hits);
+  CKPT_PUT(fd, pred->cond_seen);
+  CKPT_PUT(fd, pred->jr_hits);
+  CKPT_PUT(fd, pred->jr_seen);
+  CKPT_PUT(fd, pred->indir_hits);
+  CKPT_PUT(fd, pred->indir_seen);
+  CKPT_PUT(fd, pred->misses);
+  CKPT_PUT(fd, pred->lookups);
+#ifdef FSIM_IN_FETCH
+  CKPT_PUT(fd, pred->spec_lookups);
+#endif
+  CKPT_PUT(fd, pred->updates);
+  CKPT_PUT(fd, pred->used_pred1);
+  CKPT_PUT(fd, pred->bq_overflows);
+#ifdef RETSTACK_COUNTS
+  CKPT_PUT(fd, pred->retstack_pops);
+  CKPT_PUT(fd, pred->retstack_pushes);
+#endif
+  CKPT_PUT(fd, pred->int_addr_hits);
+  CKPT_PUT(fd, pred->int_cond_hits);
+  CKPT_PUT(fd, pred->int_cond_seen);
+  CKPT_PUT(fd, pred->int_indir_hits);
+  CKPT_PUT(fd, pred->int_indir_seen);
+  CKPT_PUT(fd, pred->int_lookups);
+}
+
+/* read predictor tables, history and stats back from a checkpoint, the
+   predictor must have the configuration it was saved with */
+void
+bpred_ckpt_restore(struct bpred *pred,	/* branch predictor instance */
+		   FILE *fd)		/* checkpoint file */
+{
+  struct bpred_ckpt_geom geom, saved;
+
+  ckpt_get_tag(fd, "bpred");
+  bpred_ckpt_geom(pred, &geom);
+  CKPT_GET(fd, saved);
+  if (saved.class != geom.class || saved.dir1 != geom.dir1
+      || saved.dir2 != geom.dir2 || saved.btb != geom.btb
+      || saved.retstack != geom.retstack || saved.bq != geom.bq)
+    fatal("checkpoint: branch predictor configuration differs from the one "
+	  "the checkpoint was saved with");
+
+  /* direction-predictor state */
+  CKPT_GET(fd, pred->aux_global_shift_reg);
+  switch (pred->class)
+    {
+    case BPredHybrid:
+      CKPT_GET(fd, pred->dirpred.hybrid.shift_reg);
+      ckpt_read(fd, pred->dirpred.hybrid.table, geom.dir1);
+      bpred_ckpt_restore(pred->dirpred.hybrid.pred1, fd);
+      bpred_ckpt_restore(pred->dirpred.hybrid.pred2, fd);
+      break;
+    case BPred2Level:
+      ckpt_read(fd, pred->dirpred.two.shiftregs,
+		geom.dir1 * sizeof(struct bpred_tab1_ent));
+      ckpt_read(fd, pred->dirpred.two.l2table, geom.dir2);
+      break;
+    case BPred2bit:
+      ckpt_read(fd, pred->dirpred.bimod.table, geom.dir1);
+      break;
+    default:
+      break;
+    }
+
+  /* BTB, return-address stack, branch queue */
+  bpred_ckpt_restore_ents(pred->btb.btb_data, geom.btb, fd);
+  bpred_ckpt_restore_ents(pred->retstack.stack, geom.retstack, fd);
+  CKPT_GET(fd, pred->retstack.tos);
+  CKPT_GET(fd, pred->bq.head);
+  CKPT_GET(fd, pred->bq.tail);
+  CKPT_GET(fd, pred->bq.num);
+  ckpt_read(fd, pred->bq.tbl, geom.bq * sizeof(struct bq_ent));
+
+  /* stats */
+  CKPT_GET(fd, pred->addr_hits);
+  CKPT_GET(fd, pred->dir_hits);
+  CKPT_GET(fd, pred->cond_hits);
+  CKPT_GET(fd, pred->cond_seen);
+  CKPT_GET(fd, pred->jr_hits);
+  CKPT_GET(fd, pred->jr_seen);
+  CKPT_GET(fd, pred->indir_hits);
+  CKPT_GET(fd, pred->indir_seen);
+  CKPT_GET(fd, pred->misses);
+  CKPT_GET(fd, pred->lookups);
+#ifdef FSIM_IN_FETCH
+  CKPT_GET(fd, pred->spec_lookups);
+#endif
+  CKPT_GET(fd, pred->updates);
+  CKPT_GET(fd, pred->used_pred1);
+  CKPT_GET(fd, pred->bq_overflows);
+#ifdef RETSTACK_COUNTS
+  CKPT_GET(fd, pred->retstack_pops);
+  CKPT_GET(fd, pred->retstack_pushes);
+#endif
+  CKPT_GET(fd, pred->int_addr_hits);
+  CKPT_GET(fd, pred->int_cond_hits);
+  CKPT_GET(fd, pred->int_cond_seen);
+  CKPT_GET(fd, pred->int_indir_hits);
+  CKPT_GET(fd, pred->int_indir_seen);
+  CKPT_GET(fd, pred->int_lookups);
+}
+
 /* Update interval stats */
 void 
 bpred_new_interval(struct bpred *bpred)
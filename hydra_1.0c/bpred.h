@@ -581,6 +581,17 @@ bpred_reg_stats(struct bpred *pred,	/* branch predictor instance */
 void 
 bpred_after_priming(struct bpred *bpred);
 
+/* write predictor tables, history and stats to a checkpoint */
+void
+bpred_ckpt_save(struct bpred *pred,	/* branch predictor instance */
+		FILE *fd);		/* checkpoint file */
+
+/* read predictor tables, history and stats back from a checkpoint, the
+   predictor must have the configuration it was saved with */
+void
+bpred_ckpt_restore(struct bpred *pred,	/* branch predictor instance */
+		   FILE *fd);		/* checkpoint file */
+
 /* reflect a new interval for interval-miss-rate observations */
 void 
 bpred_new_interval(struct bpred *bpred);
@@ -148,11 +148,19 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <strings.h>
+#include <string.h>
 #include <assert.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "misc.h"
 #include "ss.h"
 #include "sim.h"
 #include "cache.h"
+#include "checkpoint.h"
 
 
 /* cache access macros */
@@ -161,6 +169,8 @@
 #define CACHE_BLK(cp, addr)	((addr) & (cp)->blk_mask)
 #define CACHE_TAGSET(cp, addr)	((addr) & (cp)->tagset_mask)
 #define CACHE_MSHRTAG(cp, addr) ((addr) >> (cp)->set_shift)
+#define CACHE_MSHR_HASH(cp, mshrtag)					\
+  (((mshrtag) ^ ((mshrtag) >> 7)) & (cp)->mshr_hmask)
 
 /* extract/reconstruct a block address */
 #define CACHE_BADDR(cp, addr)	((addr) & ~(cp)->blk_mask)
@@ -173,6 +183,32 @@
 			(i)*(sizeof(struct cache_blk) +			\
 			     ((cp)->balloc ? (cp)->bsize*sizeof(char) : 0))))
 
+/* index of block BLK within set SET */
+#define CACHE_WAY(cp, set, blk)						\
+  (((char *)(blk) - (char *)(cp)->sets[set].blks)			\
+   / ((char *)CACHE_BINDEX(cp, (cp)->data, 1) - (cp)->data))
+
+/* ways compared by one flat layout tag compare */
+#if defined(__AVX2__)
+#define CACHE_FLAT_WIDTH	8
+#elif defined(__SSE2__)
+#define CACHE_FLAT_WIDTH	4
+#else
+#define CACHE_FLAT_WIDTH	1
+#endif
+
+/* bytes per set of flat layout way list positions, padded with 0xff to a
+   whole number of SIMD vectors */
+#if defined(__SSE2__)
+#define CACHE_FPOS_STRIDE(cp)	(((cp)->assoc + 15) & ~15)
+#else
+#define CACHE_FPOS_STRIDE(cp)	((cp)->assoc)
+#endif
+
+/* flat layout tags and way list positions of set SET */
+#define CACHE_FTAGS(cp, set)	((cp)->ftags + (set) * (cp)->fways)
+#define CACHE_FPOS(cp, set)	((cp)->fpos + (set) * CACHE_FPOS_STRIDE(cp))
+
 /* cache data block accessor, type parameterized */
 #define __CACHE_ACCESS(type, data, bofs)				\
   (*((type *)(((char *)data) + (bofs))))
@@ -351,6 +387,130 @@ update_way_list(struct cache_set *set,	/* set contained way chain */
     panic("bogus WHERE designator");
 }
 
+/* return the way of set SET holding the valid block with tag TAG, or -1,
+   in a flat layout cache */
+static INLINE int
+flat_find(struct cache *cp, SS_ADDR_TYPE set, SS_ADDR_TYPE tag)
+{
+  SS_ADDR_TYPE *tags = CACHE_FTAGS(cp, set);
+  int i;
+#if defined(__AVX2__)
+  __m256i key = _mm256_set1_epi32((int)tag);
+  int mask;
+
+  for (i=0; i < cp->fways; i += 8)
+    {
+      mask = _mm256_movemask_ps(_mm256_castsi256_ps(
+	       _mm256_cmpeq_epi32(key,
+				  _mm256_loadu_si256((__m256i *)(tags + i)))));
+      if (mask)
+	return i + ffs(mask) - 1;
+    }
+#elif defined(__SSE2__)
+  __m128i key = _mm_set1_epi32((int)tag);
+  int mask;
+
+  for (i=0; i < cp->fways; i += 4)
+    {
+      mask = _mm_movemask_ps(_mm_castsi128_ps(
+	       _mm_cmpeq_epi32(key, _mm_loadu_si128((__m128i *)(tags + i)))));
+      if (mask)
+	return i + ffs(mask) - 1;
+    }
+#else
+  for (i=0; i < cp->fways; i++)
+    {
+      if (tags[i] == tag)
+	return i;
+    }
+#endif
+  return -1;
+}
+
+/* move way WAY of set SET to WHERE in the way list of a flat layout cache,
+   the blocks it passes each shift one position */
+static INLINE void
+flat_update_pos(struct cache *cp,	/* cache to update */
+		SS_ADDR_TYPE set,	/* set containing the block */
+		int way,		/* block to move */
+		enum list_loc_t where)	/* new location */
+{
+  unsigned char *pos = CACHE_FPOS(cp, set);
+  int i, p = pos[way];
+
+  if (where == Head)
+    {
+      if (p == 0)
+	return;
+#if defined(__SSE2__)
+      {
+	/* blocks at or before P-1 move back one, padding never does */
+	__m128i lim = _mm_set1_epi8((char)(p - 1)), v;
+
+	for (i=0; i < cp->assoc; i += 16)
+	  {
+	    v = _mm_loadu_si128((__m128i *)(pos + i));
+	    v = _mm_sub_epi8(v, _mm_cmpeq_epi8(_mm_min_epu8(v, lim), v));
+	    _mm_storeu_si128((__m128i *)(pos + i), v);
+	  }
+      }
+#else
+      for (i=0; i < cp->assoc; i++)
+	pos[i] += (pos[i] < p);
+#endif
+      pos[way] = 0;
+    }
+  else
+    {
+      for (i=0; i < cp->assoc; i++)
+	pos[i] -= (pos[i] > p);
+      pos[way] = cp->assoc - 1;
+    }
+}
+
+/* return the way at position N of the way list of set SET in a flat
+   layout cache */
+static INLINE int
+flat_way(struct cache *cp, SS_ADDR_TYPE set, int n)
+{
+  unsigned char *pos = CACHE_FPOS(cp, set);
+  int i;
+#if defined(__SSE2__)
+  __m128i key = _mm_set1_epi8((char)n);
+  int mask;
+
+  for (i=0; i < cp->assoc; i += 16)
+    {
+      mask = _mm_movemask_epi8(
+	       _mm_cmpeq_epi8(key, _mm_loadu_si128((__m128i *)(pos + i))));
+      if (mask)
+	return i + ffs(mask) - 1;
+    }
+#else
+  for (i=0; i < cp->assoc; i++)
+    {
+      if (pos[i] == n)
+	return i;
+    }
+#endif
+  panic("broken way list positions");
+}
+
+/* return the block at position N of the way list of set SET, PREV being
+   the block at position N-1, or NULL past the tail */
+static struct cache_blk *
+way_list_nth(struct cache *cp,		/* cache instance */
+	     SS_ADDR_TYPE set,		/* set to walk */
+	     int n,			/* position in the way list */
+	     struct cache_blk *prev)	/* block at position N-1 */
+{
+  if (!cp->ftags)
+    return n ? prev->way_next : cp->sets[set].way_head;
+  if (n >= cp->assoc)
+    return NULL;
+  return CACHE_BINDEX(cp, cp->sets[set].blks, flat_way(cp, set, n));
+}
+
 /* create and initialize a general cache structure */
 struct cache *				/* pointer to cache created */
 cache_create(char *name,		/* name of the cache */
@@ -416,7 +576,9 @@ cache_create(char *name,		/* name of the cache */
   cp->base_lat = base_lat;
   cp->extra_hit_lat = extra_hit_lat;
   cp->num_mshrs = num_mshrs;
-  cp->bus_free = calloc(1, sizeof(SS_TIME_TYPE));
+  cp->bus = calloc(1, sizeof(struct cache_bus));
+  if (!cp->bus)
+    fatal("out of virtual memory");
   cp->bus_interval = bus_interval;
   cp->perfect = FALSE;
 
@@ -449,6 +611,8 @@ cache_create(char *name,		/* name of the cache */
   cp->replacements = 0;
   cp->writebacks = 0;
   cp->invalidations = 0;
+  cp->sec_misses = 0;
+  cp->mshr_waits = 0;
 
   /* initialize interval stats */
   cp->int_hits = 0;
@@ -527,6 +691,20 @@ cache_create(char *name,		/* name of the cache */
 	  else
 	    cp->mshrs[j].next = &(cp->mshrs[j+1]);
 	}
+
+      /* hash them by block, at least two buckets per mshr; they all
+	 start out in the bucket of tag 0 */
+      for (j = 2; j < 2 * cp->num_mshrs; j <<= 1)
+	;
+      cp->mshr_hmask = j - 1;
+      cp->mshr_hash = (struct mshr **)calloc(j, sizeof(struct mshr *));
+      if (!cp->mshr_hash)
+	fatal("out of virtual memory");
+      for (j = 0; j < cp->num_mshrs; j++)
+	{
+	  cp->mshrs[j].hash_next = cp->mshr_hash[CACHE_MSHR_HASH(cp, 0)];
+	  cp->mshr_hash[CACHE_MSHR_HASH(cp, 0)] = &cp->mshrs[j];
+	}
     }
   else
     cp->mshrs = NULL;
@@ -539,9 +717,108 @@ void cache_set_perfect(struct cache *cp)
   cp->perfect = TRUE;
 }
 
+/* Switch a cache to the flat tag layout; may be called at any time, the
+ * cache's contents and replacement order are kept.  Way list positions are
+ * bytes, with 0xff as padding, so caches of more than 128 ways keep the list
+ * layout, as do direct-mapped caches, which have nothing to search. */
+void cache_set_flat(struct cache *cp)
+{
+  struct cache_blk *blk;
+  SS_ADDR_TYPE *tags;
+  int i, j, n;
+
+  if (cp->ftags || cp->assoc == 1 || cp->assoc > 128)
+    return;
+
+  cp->fways = (cp->assoc + CACHE_FLAT_WIDTH-1) & ~(CACHE_FLAT_WIDTH-1);
+  cp->ftags = (SS_ADDR_TYPE *)
+    malloc(cp->nsets * cp->fways * sizeof(SS_ADDR_TYPE));
+  cp->fpos = (unsigned char *)malloc(cp->nsets * CACHE_FPOS_STRIDE(cp));
+  if (!cp->ftags || !cp->fpos)
+    fatal("out of virtual memory");
+
+  for (i=0; i < cp->nsets; i++)
+    {
+      tags = CACHE_FTAGS(cp, i);
+      for (j=0; j < cp->fways; j++)
+	tags[j] = CACHE_FLAT_INVALID;
+      for (j=0; j < CACHE_FPOS_STRIDE(cp); j++)
+	CACHE_FPOS(cp, i)[j] = 0xff;
+      for (n=0, blk=cp->sets[i].way_head; blk; n++, blk=blk->way_next)
+	{
+	  j = CACHE_WAY(cp, i, blk);
+	  if (blk->status & CACHE_BLK_VALID)
+	    tags[j] = blk->tag;
+	  CACHE_FPOS(cp, i)[j] = n;
+	}
+
+      /* the way list and hash table chains are no longer maintained */
+      if (cp->hsize)
+	free(cp->sets[i].hash);
+      cp->sets[i].hash = NULL;
+      cp->sets[i].way_head = cp->sets[i].way_tail = NULL;
+    }
+  cp->hsize = 0;
+}
+
 void cache_set_bus(struct cache *cp_set, struct cache* cp_target)
 {
-  cp_set->bus_free = cp_target->bus_free;
+  cp_set->bus = cp_target->bus;
+}
+
+/* Make the bus of a cache (and of the caches sharing it) slotted, see
+ * struct cache_bus; should be called once the caches share their buses.
+ * A request with no free cycles within CACHE_BUS_WINDOW of it is queued
+ * behind the last transaction, as on an unslotted bus. */
+void cache_set_bus_slotted(struct cache *cp)
+{
+  if (cp->bus->slots)
+    return;
+  cp->bus->slots = (SS_TIME_TYPE *)
+    calloc(CACHE_BUS_WINDOW, sizeof(SS_TIME_TYPE));
+  if (!cp->bus->slots)
+    fatal("out of virtual memory");
+}
+
+/* slot of cycle T in the window of slotted bus BUS */
+#define BUS_SLOT(bus, t)						\
+  ((bus)->slots[(unsigned long)(t) & (CACHE_BUS_WINDOW-1)])
+
+/* reserve BUS for a transaction of INTERVAL cycles requested at time WHEN,
+   returns when the transaction starts */
+static SS_TIME_TYPE
+bus_reserve(struct cache_bus *bus, SS_TIME_TYPE when, int interval)
+{
+  SS_TIME_TYPE start, t;
+
+  if (bus->slots && interval < CACHE_BUS_WINDOW)
+    {
+      /* the earliest INTERVAL free cycles at or after WHEN */
+      for (start = when;
+	   start + interval <= when + CACHE_BUS_WINDOW;
+	   start = t + 1)
+	{
+	  for (t = start; t < start + interval; t++)
+	    if (BUS_SLOT(bus, t) == t + 1)
+	      break;
+	  if (t == start + interval)
+	    {
+	      for (t = start; t < start + interval; t++)
+		BUS_SLOT(bus, t) = t + 1;
+	      bus->free = MAX(bus->free, start + interval);
+	      return start;
+	    }
+	}
+    }
+
+  /* queue behind the last transaction, taking its cycles in the window
+     as well so that no later request is slotted into them */
+  start = MAX(bus->free, when);
+  bus->free = start + interval;
+  if (bus->slots && interval < CACHE_BUS_WINDOW)
+    for (t = start; t < start + interval; t++)
+      BUS_SLOT(bus, t) = t + 1;
+  return start;
 }
 
 /* Update interval stats */
@@ -652,6 +929,12 @@ cache_reg_stats(struct cache *cp,	/* cache instance */
   sprintf(buf, "%s.invalidations.PP", name);
   stat_reg_llong(sdb, buf, "total number of invalidations",
 		 &cp->invalidations, 0, NULL);
+  sprintf(buf, "%s.sec_misses.PP", name);
+  stat_reg_llong(sdb, buf, "hits on a block (or mshr) still being filled",
+		 &cp->sec_misses, 0, NULL);
+  sprintf(buf, "%s.mshr_waits.PP", name);
+  stat_reg_llong(sdb, buf, "misses that waited for a free mshr",
+		 &cp->mshr_waits, 0, NULL);
   sprintf(buf, "%s.miss_rate", name);
   sprintf(buf1, "%s.misses / %s.accesses", name, name);
   stat_reg_formula(sdb, buf, "miss rate (i.e., misses/ref)", buf1, NULL);
@@ -707,6 +990,8 @@ void cache_after_priming(struct cache *cp)
   cp->replacements = 0;
   cp->writebacks = 0;
   cp->invalidations = 0;
+  cp->sec_misses = 0;
+  cp->mshr_waits = 0;
 }
 
 /* warmup doesn't use time, so the cache times get trashed.  reset. */
@@ -720,7 +1005,9 @@ void cache_after_warmup(struct cache *cp)
   if (cp == NULL)
     return;
 
-  *cp->bus_free = 0;
+  cp->bus->free = 0;
+  if (cp->bus->slots)
+    memset(cp->bus->slots, 0, CACHE_BUS_WINDOW * sizeof(SS_TIME_TYPE));
 
   /* mshr's */
   for (mshr_ptr = cp->mshrs, i = 0; 
@@ -747,6 +1034,159 @@ void cache_after_warmup(struct cache *cp)
 }
 
 
+/* cache geometry, checked when a checkpoint is restored */
+struct cache_ckpt_geom
+{
+  int nsets, assoc, bsize, balloc, usize;
+};
+
+/* checkpoint record of one cache block */
+struct cache_ckpt_blk
+{
+  int way;			/* index of the block within its set */
+  SS_ADDR_TYPE tag;
+  unsigned int status;
+  SS_TIME_TYPE ready;
+};
+
+/* index of block BLK within the cache's block array, -1 for NULL */
+static int
+cache_blk_index(struct cache *cp, struct cache_blk *blk)
+{
+  if (!blk)
+    return -1;
+  return ((char *)blk - cp->data) / ((char *)CACHE_BINDEX(cp, cp->data, 1)
+				     - cp->data);
+}
+
+/* write cache contents and stats to a checkpoint */
+void
+cache_ckpt_save(struct cache *cp, FILE *fd)
+{
+  struct cache_ckpt_geom geom;
+  struct cache_ckpt_blk rec;
+  struct cache_blk *blk;
+  int i, n, last;
+
+  ckpt_put_tag(fd, cp->name);
+  geom.nsets = cp->nsets;
+  geom.assoc = cp->assoc;
+  geom.bsize = cp->bsize;
+  geom.balloc = cp->balloc;
+  geom.usize = cp->usize;
+  CKPT_PUT(fd, geom);
+
+  CKPT_PUT(fd, cp->hits);
+  CKPT_PUT(fd, cp->misses);
+  CKPT_PUT(fd, cp->reads);
+  CKPT_PUT(fd, cp->read_hits);
+  CKPT_PUT(fd, cp->writes);
+  CKPT_PUT(fd, cp->replacements);
+  CKPT_PUT(fd, cp->writebacks);
+  CKPT_PUT(fd, cp->invalidations);
+  CKPT_PUT(fd, cp->int_hits);
+  CKPT_PUT(fd, cp->int_misses);
+  CKPT_PUT(fd, cp->last_tagset);
+  last = cache_blk_index(cp, cp->last_blk);
+  CKPT_PUT(fd, last);
+
+  /* each set's blocks, in way-list (replacement) order */
+  for (i=0; i < cp->nsets; i++)
+    for (n=0, blk=way_list_nth(cp, i, 0, NULL);
+	 blk;
+	 blk=way_list_nth(cp, i, ++n, blk))
+      {
+	rec.way = cache_blk_index(cp, blk) - i * cp->assoc;
+	rec.tag = blk->tag;
+	rec.status = blk->status;
+	rec.ready = blk->ready;
+	CKPT_PUT(fd, rec);
+	ckpt_write(fd, blk->user_data, cp->usize);
+	if (cp->balloc)
+	  ckpt_write(fd, blk->data, cp->bsize);
+      }
+}
+
+/* read cache contents and stats back from a checkpoint, the cache must
+   have the geometry it was saved with */
+void
+cache_ckpt_restore(struct cache *cp, FILE *fd)
+{
+  struct cache_ckpt_geom geom;
+  struct cache_ckpt_blk rec;
+  struct cache_blk *blk, *prev;
+  int i, j, last;
+
+  ckpt_get_tag(fd, cp->name);
+  CKPT_GET(fd, geom);
+  if (geom.nsets != cp->nsets || geom.assoc != cp->assoc
+      || geom.bsize != cp->bsize || geom.balloc != cp->balloc
+      || geom.usize != cp->usize)
+    fatal("checkpoint: cache `%s' was saved as %d sets x %d ways x %d bytes",
+	  cp->name, geom.nsets, geom.assoc, geom.bsize);
+
+  CKPT_GET(fd, cp->hits);
+  CKPT_GET(fd, cp->misses);
+  CKPT_GET(fd, cp->reads);
+  CKPT_GET(fd, cp->read_hits);
+  CKPT_GET(fd, cp->writes);
+  CKPT_GET(fd, cp->replacements);
+  CKPT_GET(fd, cp->writebacks);
+  CKPT_GET(fd, cp->invalidations);
+  CKPT_GET(fd, cp->int_hits);
+  CKPT_GET(fd, cp->int_misses);
+  CKPT_GET(fd, cp->last_tagset);
+  CKPT_GET(fd, last);
+  cp->last_blk = (last == -1) ? NULL : CACHE_BINDEX(cp, cp->data, last);
+
+  /* relink each set's way list in the saved order, then rebuild the hash
+     table chains from scratch */
+  for (i=0; i < cp->nsets; i++)
+    {
+      prev = NULL;
+      for (j=0; j < cp->assoc; j++)
+	{
+	  CKPT_GET(fd, rec);
+	  if (rec.way < 0 || rec.way >= cp->assoc)
+	    fatal("checkpoint: bad block index in cache `%s'", cp->name);
+	  blk = CACHE_BINDEX(cp, cp->sets[i].blks, rec.way);
+	  blk->tag = rec.tag;
+	  blk->status = rec.status;
+	  blk->ready = rec.ready;
+	  ckpt_read(fd, blk->user_data, cp->usize);
+	  if (cp->balloc)
+	    ckpt_read(fd, blk->data, cp->bsize);
+
+	  if (cp->ftags)
+	    {
+	      CACHE_FTAGS(cp, i)[rec.way] =
+		(blk->status & CACHE_BLK_VALID) ? blk->tag : CACHE_FLAT_INVALID;
+	      CACHE_FPOS(cp, i)[rec.way] = j;
+	      continue;
+	    }
+
+	  blk->way_prev = prev;
+	  blk->way_next = NULL;
+	  if (prev)
+	    prev->way_next = blk;
+	  else
+	    cp->sets[i].way_head = blk;
+	  prev = blk;
+	}
+      cp->sets[i].way_tail = prev;
+
+      if (cp->hsize)
+	{
+	  for (j=0; j < cp->hsize; j++)
+	    cp->sets[i].hash[j] = NULL;
+	  for (j=0; j < cp->assoc; j++)
+	    link_htab_ent(cp, &cp->sets[i],
+			  CACHE_BINDEX(cp, cp->sets[i].blks, j));
+	}
+    }
+}
+
+
 /* access a cache, perform a CMD operation on cache CP at address ADDR,
    places NBYTES of data at *P, returns latency of operation if initiated
    at NOW, places pointer to block user data in *UDATA, *P is untouched if
@@ -770,7 +1210,7 @@ cache_access(struct cache *cp,		/* cache to access */
   unsigned int lat = cp->base_lat;	/* Every access incurs the base lat */
   SS_TIME_TYPE curr_time = now + cp->base_lat;
   struct mshr *mshr_ptr = NULL;
-  int i;
+  int i, way = -1;
 #ifndef __alpha__
   extern long random(void);
 #endif
@@ -803,7 +1243,17 @@ cache_access(struct cache *cp,		/* cache to access */
       goto cache_all_true_hits;
     }
     
-  if (cp->hsize)
+  if (cp->ftags)
+    {
+      /* flat layout, compare all the set's tags at once */
+      way = flat_find(cp, set, tag);
+      if (way >= 0)
+	{
+	  blk = CACHE_BINDEX(cp, cp->sets[set].blks, way);
+	  goto cache_hit;
+	}
+    }
+  else if (cp->hsize)
     {
       /* high-associativity cache, access through the per-set hash tables */
       int hindex = CACHE_HASH(cp, tag);
@@ -836,35 +1286,46 @@ cache_access(struct cache *cp,		/* cache to access */
   /* Check mshrs for reads */
   if (cp->num_mshrs != 0)
     {
+      struct mshr *hit = NULL;
 #ifndef NDEBUG
       SS_TIME_TYPE last_time = 0;
-#endif
-      /* See if an mshr has been allocated for this block.  If not, 
-       * wait for the head of the mshr list to get free (list is sorted). */
-      for (mshr_ptr = cp->mshrs, i = 0; 
-	   i < cp->num_mshrs; 
-#ifndef NDEBUG
-	   last_time = mshr_ptr->when_free, 
-#endif
-	     mshr_ptr = mshr_ptr->next, i++)
+
+      for (mshr_ptr = cp->mshrs, i = 0;
+	   i < cp->num_mshrs;
+	   last_time = mshr_ptr->when_free, mshr_ptr = mshr_ptr->next, i++)
 	{
-	  if (mshr_ptr->tag == mshrtag && 
-	      mshr_ptr->when_free > now && mshr_ptr->valid)
-	    {
-	      /* An mshr-hit!  Normal mshr-hits are hits as above.
-	       * We got here because the hit-upon block has already
-	       * been replaced.  But we should treat this like a hit. */
-	      lat = MAX(0, mshr_ptr->when_free - curr_time);
-	      curr_time += lat;
-	      goto mshr_hit;
-	    }
-#ifndef NDEBUG
 	  if (mshr_ptr->when_free < last_time && !sim_warmup && !cp->perfect)
 	    panic("mshr ordering broken");
+	}
 #endif
+
+      /* See if an mshr has been allocated for this block, the one that
+       * frees first if several have (accesses are not made in time order).
+       * If not, wait for the head of the mshr list to get free (list is
+       * sorted). */
+      for (mshr_ptr = cp->mshr_hash[CACHE_MSHR_HASH(cp, mshrtag)];
+	   mshr_ptr;
+	   mshr_ptr = mshr_ptr->hash_next)
+	{
+	  if (mshr_ptr->tag == mshrtag && 
+	      mshr_ptr->when_free > now && mshr_ptr->valid
+	      && (!hit || mshr_ptr->when_free < hit->when_free))
+	    hit = mshr_ptr;
+	}
+      if (hit)
+	{
+	  /* An mshr-hit!  Normal mshr-hits are hits as above.
+	   * We got here because the hit-upon block has already
+	   * been replaced.  But we should treat this like a hit. */
+	  cp->sec_misses++;
+	  lat = MAX(0, hit->when_free - curr_time);
+	  curr_time += lat;
+	  goto mshr_hit;
 	}
 
       lat = MAX(0, (int)(cp->mshrs->when_free - curr_time));
+      if (lat > 0)
+	cp->mshr_waits++;
       curr_time += lat;
       mshr_ptr = cp->mshrs;
     }
@@ -876,6 +1337,13 @@ cache_access(struct cache *cp,		/* cache to access */
   switch (cp->policy) {
   case LRU:
   case FIFO:
+    if (cp->ftags)
+      {
+	way = flat_way(cp, set, cp->assoc - 1);
+	repl = CACHE_BINDEX(cp, cp->sets[set].blks, way);
+	flat_update_pos(cp, set, way, Head);
+	break;
+      }
     repl = cp->sets[set].way_tail;
     update_way_list(&cp->sets[set], repl, Head);
     break;
@@ -888,6 +1356,7 @@ cache_access(struct cache *cp,		/* cache to access */
       int bindex = random() & (cp->assoc - 1);
 #endif
       repl = CACHE_BINDEX(cp, cp->sets[set].blks, bindex);
+      way = bindex;
     }
     break;
   default:
@@ -924,18 +1393,17 @@ cache_access(struct cache *cp,		/* cache to access */
 	}
     }
   
-  /* stall until the bus to next level of memory is available */
-  assert(cp->bus_interval > 0 || *cp->bus_free == 0);
-  lat = MAX(0, (int)(*cp->bus_free - curr_time));
-  curr_time += lat;
- 
-  /* track bus resource usage */
+  /* stall until the bus to next level of memory is available, and track
+     bus resource usage */
+  assert(cp->bus_interval > 0 || cp->bus->free == 0);
   if (cp->bus_interval > 0)
-    *cp->bus_free = MAX(*cp->bus_free, curr_time) + cp->bus_interval;
+    curr_time = bus_reserve(cp->bus, curr_time, cp->bus_interval);
 
   /* update block tags */
   repl->tag = tag;
   repl->status = CACHE_BLK_VALID;	/* dirty bit set on update */
+  if (cp->ftags)
+    CACHE_FTAGS(cp, set)[way] = tag;
 
   /* read data block */
   lat = cp->blk_access_fn(Read, CACHE_BADDR(cp, addr), cp->bsize,
@@ -972,9 +1440,19 @@ cache_access(struct cache *cp,		/* cache to access */
   if (mshr_ptr && (mshr_ptr->tag != mshrtag || mshr_ptr->when_free <= now))
     {
       /* Have a primary miss, here, and so mshr_ptr == cp->mshrs */
-      struct mshr *prev, *curr, *new_head;
+      struct mshr *prev, *curr, *new_head, **bucket;
       new_head = cp->mshrs->next;
 
+      /* move the mshr to the hash bucket of its new block */
+      for (bucket = &cp->mshr_hash[CACHE_MSHR_HASH(cp, mshr_ptr->tag)];
+	   *bucket != mshr_ptr;
+	   bucket = &(*bucket)->hash_next)
+	;
+      *bucket = mshr_ptr->hash_next;
+      bucket = &cp->mshr_hash[CACHE_MSHR_HASH(cp, mshrtag)];
+      mshr_ptr->hash_next = *bucket;
+      *bucket = mshr_ptr;
+
       mshr_ptr->tag = mshrtag;
       mshr_ptr->valid = TRUE;
       mshr_ptr->when_free = curr_time;
@@ -1025,7 +1503,12 @@ cache_access(struct cache *cp,		/* cache to access */
   
  /* **HIT** */
   /* if LRU replacement and this is not the first element of list, reorder */
-  if (blk->way_prev && cp->policy == LRU)
+  if (cp->ftags)
+    {
+      if (cp->policy == LRU)
+	flat_update_pos(cp, set, way, Head);
+    }
+  else if (blk->way_prev && cp->policy == LRU)
     {
       /* move this block to head of the way (MRU) list */
       update_way_list(&cp->sets[set], blk, Head);
@@ -1067,6 +1550,11 @@ cache_access(struct cache *cp,		/* cache to access */
    * of looking back in time -- so don't change hash links, way list, 
    * or dirty status */
 
+  /* a hit on a block still being filled is a secondary miss, merged into
+   * the outstanding one */
+  if (blk && blk->ready > curr_time)
+    cp->sec_misses++;
+
   /* return first cycle data is available to access */
   lat = cp->extra_hit_lat;
   curr_time += lat;
@@ -1093,6 +1581,9 @@ cache_probe(struct cache *cp,		/* cache instance to probe */
 
   /* permissions are checked on cache misses */
 
+  if (cp->ftags)
+    return flat_find(cp, set, tag) >= 0;
+
   if (cp->hsize)
   {
     /* higly-associativity cache, access through the per-set hash tables */
@@ -1127,7 +1618,7 @@ unsigned int				/* latency of the flush operation */
 cache_flush(struct cache *cp,		/* cache instance to flush */
 	    SS_TIME_TYPE now)		/* time of cache flush */
 {
-  int i, lat = cp->base_lat; /* min latency to probe cache */
+  int i, n, lat = cp->base_lat; /* min latency to probe cache */
   struct cache_blk *blk;
 
   /* blow away the last block to hit */
@@ -1137,12 +1628,16 @@ cache_flush(struct cache *cp,		/* cache instance to flush */
   /* no way list updates required because all blocks are being invalidated */
   for (i=0; i<cp->nsets; i++)
     {
-      for (blk=cp->sets[i].way_head; blk; blk=blk->way_next)
+      for (n=0, blk=way_list_nth(cp, i, 0, NULL);
+	   blk;
+	   blk=way_list_nth(cp, i, ++n, blk))
 	{
 	  if (blk->status & CACHE_BLK_VALID)
 	    {
 	      cp->invalidations++;
 	      blk->status &= ~CACHE_BLK_VALID;
+	      if (cp->ftags)
+		CACHE_FTAGS(cp, i)[CACHE_WAY(cp, i, blk)] = CACHE_FLAT_INVALID;
 
 	      if (blk->status & CACHE_BLK_DIRTY)
 		{
@@ -1169,10 +1664,17 @@ cache_flush_addr(struct cache *cp,	/* cache instance to flush */
 {
   SS_ADDR_TYPE tag = CACHE_TAG(cp, addr);
   SS_ADDR_TYPE set = CACHE_SET(cp, addr);
-  struct cache_blk *blk;
-  int lat = cp->base_lat; /* min latency to probe cache */
+  struct cache_blk *blk = NULL;
+  int way = -1, lat = cp->base_lat; /* min latency to probe cache */
 
-  if (cp->hsize)
+  if (cp->ftags)
+    {
+      /* flat layout, compare all the set's tags at once */
+      way = flat_find(cp, set, tag);
+      if (way >= 0)
+	blk = CACHE_BINDEX(cp, cp->sets[set].blks, way);
+    }
+  else if (cp->hsize)
     {
       /* higly-associativity cache, access through the per-set hash tables */
       int hindex = CACHE_HASH(cp, tag);
@@ -1215,7 +1717,13 @@ cache_flush_addr(struct cache *cp,	/* cache instance to flush */
 				   cp->bsize, blk, now+lat);
 	}
       /* move this block to tail of the way (LRU) list */
-      update_way_list(&cp->sets[set], blk, Tail);
+      if (cp->ftags)
+	{
+	  CACHE_FTAGS(cp, set)[way] = CACHE_FLAT_INVALID;
+	  flat_update_pos(cp, set, way, Tail);
+	}
+      else
+	update_way_list(&cp->sets[set], blk, Tail);
     }
 
   /* return latency of the operation */
@@ -143,6 +143,14 @@
  * associative, a hash table (indexed by address) is allocated for each set
  * in the cache.
  *
+ * Alternatively, a cache may use a flat layout (see cache_set_flat()): the
+ * tags of each set are kept in a contiguous array, with invalid blocks
+ * holding a tag no address can have, so a lookup compares the wanted tag
+ * against four (SSE2) or eight (AVX2) ways with one instruction, and the
+ * replacement order is kept as a byte per block, its position in the way
+ * list, instead of by relinking the way list.  The two layouts make the
+ * same replacement decisions, so they give identical hits and misses.
+ *
  * This module also tracks latency of accessing the data cache, each cache has
  * a hit latency defined when instantiated, miss latency is returned by the
  * cache's block access function, the calling simulator should limit the number
@@ -165,6 +173,10 @@ enum cache_policy {
   FIFO		/* replace the oldest block in the set */
 };
 
+/* tag of an invalid block in the flat layout, tags are addresses shifted
+   right by at least three bits, so none can have it */
+#define CACHE_FLAT_INVALID	0xffffffff
+
 /* block status values */
 #define CACHE_BLK_VALID		0x00000001	/* block in valid, in use */
 #define CACHE_BLK_DIRTY		0x00000002	/* dirty block */
@@ -205,13 +217,37 @@ struct cache_set
 /* mshr definition 
  * An mshr is allocated for each primary miss (a miss is primary when there
  * are no currently outstanding misses to that block; secondary otherwise)
- * and freed once current time reaches 'when_free' */
+ * and freed once current time reaches 'when_free'.  A secondary miss waits
+ * for the primary's fill; it hits on the block being filled, or, if that
+ * was replaced meanwhile, on the mshr. */
 struct mshr
 {
   int valid;			/* does this contain a pending miss? */
   SS_ADDR_TYPE tag;		/* which cache block does this mshr describe */
   SS_TIME_TYPE when_free;	/* when will this mshr next be available */
   struct mshr *next;		/* list is kept sorted by ascending time */
+  struct mshr *hash_next;	/* next mshr in the hash bucket of TAG */
+};
+
+/* number of cycles ahead a slotted bus keeps track of, a power of two */
+#define CACHE_BUS_WINDOW	1024
+
+/* bus to the next level of memory, may be shared by several caches (see
+ * cache_set_bus()).  The bus is pipelined, each transaction holds it for
+ * the 'bus_interval' cycles of the cache making it.  By default requests
+ * are queued in the order they are made, a transaction starts once the
+ * previous one is done with the bus.  As accesses are not made in time
+ * order (a miss in the next level is made at the time of the miss, ahead
+ * of the current cycle), a slotted bus instead reserves the cycles of
+ * each transaction, and a request takes the earliest free ones at or
+ * after its time, see cache_set_bus_slotted(). */
+struct cache_bus
+{
+  SS_TIME_TYPE free;		/* when the bus is next free, in order */
+  SS_TIME_TYPE *slots;		/* slotted: 1 + the cycle each slot of the
+				   window is reserved for, indexed by the
+				   cycle modulo CACHE_BUS_WINDOW, NULL if
+				   requests are queued in order */
 };
 
 /* cache definition */
@@ -262,15 +298,18 @@ struct cache
    * level of memory that requires 'bus_interval' cycles per bus
    * transaction.  (0 means perfect bus.)  A cache line is received
    * in a single cycle. */
-  SS_TIME_TYPE *bus_free;       /* time when bus to next level of cache is
-                                   free.  This is a pointer so several
-				   caches may share a bus. */
+  struct cache_bus *bus;	/* bus to next level of cache.  This is a
+				   pointer so several caches may share a
+				   bus. */
   int bus_interval;		/* How many cycles per request --  1
 				   means one new request every cycle, 2
 				   one new request every other cycle, etc. */
 
   /* mshrs */
   struct mshr *mshrs;		/* soonest-to-retire mshr */
+  struct mshr **mshr_hash;	/* mshrs hashed by block, every mshr is in
+				   the bucket of its tag */
+  int mshr_hmask;		/* bucket index mask */
 
   /* per-cache stats */
   SS_COUNTER_TYPE hits;		/* total number of hits */
@@ -281,6 +320,8 @@ struct cache
   SS_COUNTER_TYPE replacements;	/* total number of replacements at misses */
   SS_COUNTER_TYPE writebacks;	/* total number of writebacks at misses */
   SS_COUNTER_TYPE invalidations; /* total number of external invalidations */
+  SS_COUNTER_TYPE sec_misses;	/* secondary misses */
+  SS_COUNTER_TYPE mshr_waits;	/* primary misses that waited for an mshr */
 
   SS_COUNTER_TYPE prime_reads;  /* reads during priming */
   SS_COUNTER_TYPE prime_writes; /* reads during priming */
@@ -294,6 +335,14 @@ struct cache
   SS_COUNTER_TYPE int_hits;	/* total number of hits thru last interval */
   SS_COUNTER_TYPE int_misses;	/* total number of misses thru last interval */
 
+  /* flat layout, see cache_set_flat(); FTAGS is NULL if it is not used */
+  int fways;			/* ways per set in FTAGS, ASSOC rounded up to
+				   the SIMD width */
+  SS_ADDR_TYPE *ftags;		/* per-set tags, CACHE_FLAT_INVALID for
+				   invalid blocks and padding */
+  unsigned char *fpos;		/* per-set way list position of each block,
+				   0 is the head (MRU), ASSOC-1 the tail */
+
   /* last block to hit, used to optimize cache hit processing */
   SS_ADDR_TYPE last_tagset;	/* tag of last line accessed */
   struct cache_blk *last_blk;	/* cache block last accessed */
@@ -326,9 +375,16 @@ cache_create(char *name,		/* name of the cache */
  * cache_create(); */
 void cache_set_perfect(struct cache *cp);
 
+/* Switch a cache to the flat tag layout; may be called at any time, the
+ * cache's contents and replacement order are kept */
+void cache_set_flat(struct cache *cp);
+
 /* Allow caches to share a bus */
 void cache_set_bus(struct cache *cp_set, struct cache* cp_target);
 
+/* Make the bus of a cache (and of the caches sharing it) slotted */
+void cache_set_bus_slotted(struct cache *cp);
+
 /* Update interval stats */
 void cache_new_interval(struct cache *cp);
 
@@ -360,6 +416,13 @@ void cache_after_priming(struct cache *cp);
 /* reset state after warmup, if appropriate */
 void cache_after_warmup(struct cache *cp);
 
+/* write cache contents and stats to a checkpoint */
+void cache_ckpt_save(struct cache *cp, FILE *fd);
+
+/* read cache contents and stats back from a checkpoint, the cache must
+   have the geometry it was saved with */
+void cache_ckpt_restore(struct cache *cp, FILE *fd);
+
 /* access a cache, perform a CMD operation on cache CP at address ADDR,
    places NBYTES of data at *P, returns latency of operation if initiated
    at NOW, places pointer to block user data in *UDATA, *P is untouched if
@@ -390,6 +453,28 @@ cache_access(struct cache *cp,		/* cache to access */
 #define cache_byte(cp, cmd, addr, p, now, udata)	\
   cache_access(cp, cmd, addr, p, sizeof(char), now, udata)
 
+/* cache_access() for callers that want neither data, user data, the
+   replaced address nor the latency, i.e., functional warming: an access to
+   the block accessed last only counts a hit (and dirties the block on a
+   write, or counts a secondary miss if the block is still being filled at
+   time 0, the time these accesses are made at), so do that inline and call
+   cache_access() for anything else */
+#ifndef LAT_INFO
+#define cache_access_fast(cp, cmd, addr, nbytes)			\
+  ((!(cp)->balloc && ((addr) & (cp)->tagset_mask) == (cp)->last_tagset)\
+   ? (void)((cmd) == Read						\
+	    ? ((cp)->reads++, (cp)->read_hits++)			\
+	    : ((cp)->writes++,						\
+	       (cp)->last_blk->status |= CACHE_BLK_DIRTY),		\
+	    (cp)->hits++,						\
+	    ((cp)->last_blk->ready > (cp)->base_lat			\
+	     ? (cp)->sec_misses++ : 0))					\
+   : (void)cache_access((cp), (cmd), (addr), NULL, (nbytes), 0, NULL, NULL))
+#else /* LAT_INFO */
+#define cache_access_fast(cp, cmd, addr, nbytes)			\
+  ((void)cache_access((cp), (cmd), (addr), NULL, (nbytes), 0, NULL, NULL))
+#endif /* LAT_INFO */
+
 /* return non-zero if block containing address ADDR is contained in cache
    CP, this interface is used primarily for debugging and asserting cache
    invariants */
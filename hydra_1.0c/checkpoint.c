@@ -0,0 +1,193 @@
+/*
+ * checkpoint.c - program state checkpoint routines
+ *
+ * This file is a part of the SimpleScalar tool suite, and is distributed
+ * under the same terms as the rest of the tool suite; see the copyright
+ * notice in any of the original SimpleScalar sources.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "misc.h"
+#include "ss.h"
+#include "regs.h"
+#include "memory.h"
+#include "loader.h"
+#include "syscall.h"
+#include "predecode.h"
+#include "checkpoint.h"
+
+/* checkpoint file magic string */
+#define CKPT_MAGIC		"hydra-ckpt"
+
+/* longest section tag */
+#define CKPT_TAG_SIZE		16
+
+/* write SIZE bytes at P to checkpoint FD, fatal on error */
+void
+ckpt_write(FILE *fd, void *p, int size)
+{
+  if (size > 0 && fwrite(p, size, 1, fd) != 1)
+    fatal("checkpoint: write failed");
+}
+
+/* read SIZE bytes from checkpoint FD into P, fatal on error */
+void
+ckpt_read(FILE *fd, void *p, int size)
+{
+  if (size > 0 && fread(p, size, 1, fd) != 1)
+    fatal("checkpoint: file is truncated");
+}
+
+/* start a checkpoint section named TAG */
+void
+ckpt_put_tag(FILE *fd, char *tag)
+{
+  char buf[CKPT_TAG_SIZE];
+
+  memset(buf, 0, CKPT_TAG_SIZE);
+  strncpy(buf, tag, CKPT_TAG_SIZE - 1);
+  ckpt_write(fd, buf, CKPT_TAG_SIZE);
+}
+
+/* check that the next checkpoint section is named TAG, fatal if not */
+void
+ckpt_get_tag(FILE *fd, char *tag)
+{
+  char buf[CKPT_TAG_SIZE];
+
+  ckpt_read(fd, buf, CKPT_TAG_SIZE);
+  buf[CKPT_TAG_SIZE - 1] = '\0';
+  if (strncmp(buf, tag, CKPT_TAG_SIZE - 1) != 0)
+    fatal("checkpoint: expected section `%s', found `%s'; was the checkpoint "
+          "written by a different simulator or configuration?", tag, buf);
+}
+
+/* create checkpoint file FNAME and write header HDR to it */
+FILE *
+ckpt_create(char *fname, struct ckpt_header *hdr)
+{
+  FILE *fd;
+
+  if (!(fd = fopen(fname, "wb")))
+    fatal("checkpoint: cannot create `%s'", fname);
+
+  memset(hdr->magic, 0, sizeof(hdr->magic));
+  strcpy(hdr->magic, CKPT_MAGIC);
+  hdr->version = CKPT_VERSION;
+  memset(hdr->prog_fname, 0, sizeof(hdr->prog_fname));
+  if (ld_prog_fname)
+    strncpy(hdr->prog_fname, ld_prog_fname, sizeof(hdr->prog_fname) - 1);
+  CKPT_PUT(fd, *hdr);
+
+  return fd;
+}
+
+/* open checkpoint file FNAME and read its header into HDR */
+FILE *
+ckpt_open(char *fname, struct ckpt_header *hdr)
+{
+  FILE *fd;
+
+  if (!(fd = fopen(fname, "rb")))
+    fatal("checkpoint: cannot open `%s'", fname);
+
+  CKPT_GET(fd, *hdr);
+  if (strcmp(hdr->magic, CKPT_MAGIC) != 0)
+    fatal("checkpoint: `%s' is not a checkpoint file", fname);
+  if (hdr->version != CKPT_VERSION)
+    fatal("checkpoint: `%s' is format version %d, this simulator reads "
+          "version %d", fname, hdr->version, CKPT_VERSION);
+
+  return fd;
+}
+
+/* finish with a checkpoint file; after a restore, this also reopens the
+   program's files (which may reuse the checkpoint's descriptor number) */
+void
+ckpt_close(FILE *fd)
+{
+  if (fclose(fd) != 0)
+    fatal("checkpoint: close failed");
+
+  ss_syscall_ckpt_reopen();
+}
+
+/* write architected program state (registers, memory, open files) */
+void
+ckpt_save_arch(FILE *fd)
+{
+  int i;
+
+  /* registers */
+  ckpt_put_tag(fd, "regs");
+  CKPT_PUT(fd, regs_R);
+  CKPT_PUT(fd, regs_F);
+  CKPT_PUT(fd, regs_HI);
+  CKPT_PUT(fd, regs_LO);
+  CKPT_PUT(fd, regs_FCC);
+  CKPT_PUT(fd, regs_PC);
+
+  /* memory: heap and stack limits, then each populated page, by index */
+  ckpt_put_tag(fd, "memory");
+  CKPT_PUT(fd, mem_brk_point);
+  CKPT_PUT(fd, mem_stack_min);
+  for (i = 0; i < MEM_TABLE_SIZE; i++)
+    if (mem_table[i])
+    {
+      if (!mem_table_arch[i])
+        panic("checkpoint: speculative page in memory table");
+      CKPT_PUT(fd, i);
+      ckpt_write(fd, mem_table[i], MEM_BLOCK_SIZE);
+    }
+  i = -1;
+  CKPT_PUT(fd, i);
+
+  /* open files */
+  ss_syscall_ckpt_save(fd);
+}
+
+/* replace the loaded program's architected state with the checkpoint's */
+void
+ckpt_restore_arch(FILE *fd)
+{
+  int i, page;
+
+  /* registers */
+  ckpt_get_tag(fd, "regs");
+  CKPT_GET(fd, regs_R);
+  CKPT_GET(fd, regs_F);
+  CKPT_GET(fd, regs_HI);
+  CKPT_GET(fd, regs_LO);
+  CKPT_GET(fd, regs_FCC);
+  CKPT_GET(fd, regs_PC);
+
+  /* memory: drop what the loader set up, then read back the pages */
+  ckpt_get_tag(fd, "memory");
+  CKPT_GET(fd, mem_brk_point);
+  CKPT_GET(fd, mem_stack_min);
+  for (i = 0; i < MEM_TABLE_SIZE; i++)
+  {
+    if (mem_table[i])
+      free(mem_table[i]);
+    mem_table[i] = NULL;
+    mem_table_arch[i] = TRUE;
+  }
+  for (;;)
+  {
+    CKPT_GET(fd, page);
+    if (page == -1)
+      break;
+    if (page < 0 || page >= MEM_TABLE_SIZE)
+      fatal("checkpoint: bad memory page index %d", page);
+    mem_table[page] = mem_newblock();
+    ckpt_read(fd, mem_table[page], MEM_BLOCK_SIZE);
+  }
+  pd_text_changed();
+
+  /* open files, reopened by ckpt_close() */
+  ss_syscall_ckpt_restore(fd);
+}
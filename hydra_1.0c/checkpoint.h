@@ -0,0 +1,93 @@
+/*
+ * checkpoint.h - program state checkpoint interfaces
+ *
+ * This file is a part of the SimpleScalar tool suite, and is distributed
+ * under the same terms as the rest of the tool suite; see the copyright
+ * notice in any of the original SimpleScalar sources.
+ *
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+
+#include "ss.h"
+
+/*
+ * A checkpoint captures the architected state of the simulated program at
+ * some instruction count, so that many simulations of the same benchmark
+ * can skip straight to that point instead of re-executing (and re-warming)
+ * everything that comes before it.  A checkpoint file holds:
+ *
+ *	1) a header naming the program and the instruction count
+ *	2) the architected registers (regs_R, regs_F, HI, LO, FCC, PC)
+ *	3) every populated page of mem_table[], plus the brk/stack limits
+ *	4) the program's open file descriptors and their file offsets
+ *	5) optionally, microarchitectural state (warmed caches, TLBs, branch
+ *	   and confidence predictors) written by the simulator itself
+ *
+ * Checkpoints are raw host-endian dumps, meant to be read back by the same
+ * simulator build on the same host.  Every section starts with a tag, so
+ * restoring with mismatched code or a mismatched configuration fails
+ * loudly instead of silently simulating garbage.
+ */
+
+/* checkpoint file format version, bump when the layout changes */
+#define CKPT_VERSION		1
+
+/* checkpoint file header */
+struct ckpt_header
+{
+  char magic[16];		/* "hydra-ckpt" */
+  int version;			/* CKPT_VERSION */
+  int has_uarch;		/* microarchitectural state follows? */
+  SS_COUNTER_TYPE num_insn;	/* sim_num_insn when the checkpoint was made */
+  SS_COUNTER_TYPE num_refs;	/* sim_num_refs when the checkpoint was made */
+  SS_COUNTER_TYPE num_loads;	/* sim_num_loads when the checkpoint was made */
+  unsigned int warmup_insn;	/* -warmup_insts of the run that wrote it */
+  char prog_fname[256];		/* program the checkpoint was taken from */
+};
+
+/* write SIZE bytes at P to checkpoint FD, fatal on error */
+void
+ckpt_write(FILE *fd, void *p, int size);
+
+/* read SIZE bytes from checkpoint FD into P, fatal on error */
+void
+ckpt_read(FILE *fd, void *p, int size);
+
+/* write/read a single variable */
+#define CKPT_PUT(FD, VAR)	ckpt_write((FD), &(VAR), sizeof(VAR))
+#define CKPT_GET(FD, VAR)	ckpt_read((FD), &(VAR), sizeof(VAR))
+
+/* start a checkpoint section named TAG */
+void
+ckpt_put_tag(FILE *fd, char *tag);
+
+/* check that the next checkpoint section is named TAG, fatal if not */
+void
+ckpt_get_tag(FILE *fd, char *tag);
+
+/* create checkpoint file FNAME and write header HDR to it */
+FILE *
+ckpt_create(char *fname, struct ckpt_header *hdr);
+
+/* open checkpoint file FNAME and read its header into HDR */
+FILE *
+ckpt_open(char *fname, struct ckpt_header *hdr);
+
+/* finish with a checkpoint file; after a restore, this also reopens the
+   program's files (which may reuse the checkpoint's descriptor number) */
+void
+ckpt_close(FILE *fd);
+
+/* write architected program state (registers, memory, open files) */
+void
+ckpt_save_arch(FILE *fd);
+
+/* replace the loaded program's architected state with the checkpoint's */
+void
+ckpt_restore_arch(FILE *fd);
+
+#endif /* CHECKPOINT_H */
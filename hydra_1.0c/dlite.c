@@ -405,6 +405,10 @@ ident_evaluator(struct eval_state_t *es)	/* expression evaluator */
 	    eval_delete(es);
 	  }
 	  break;
+	case sc_sample:
+	  val.type = et_double;
+	  val.value.as_double = stat->variant.for_sample.mean;
+	  break;
 	default:
 	  panic("bogus stat class");
 	}
@@ -865,6 +865,254 @@ eval_expr(struct eval_state_t *es,	/* expression evaluator */
   return val;
 }
 
+/*
+ * compiled expressions
+ */
+
+/* allocate an expression tree node */
+static struct eval_node_t *
+new_node(enum eval_token_t op,		/* node operation */
+	 struct eval_node_t *left,	/* left operand */
+	 struct eval_node_t *right)	/* right operand */
+{
+  struct eval_node_t *node;
+
+  node = (struct eval_node_t *)calloc(1, sizeof(struct eval_node_t));
+  if (!node)
+    fatal("out of virtual memory");
+  node->op = op;
+  node->left = left;
+  node->right = right;
+
+  return node;
+}
+
+/* forward declaration */
+static struct eval_node_t *c_expr(struct eval_state_t *es);
+
+/* compile an expression factor, returns NULL and sets eval_error on a
+   syntax error */
+static struct eval_node_t *		/* factor tree */
+c_factor(struct eval_state_t *es)	/* expression tokenizer */
+{
+  struct eval_node_t *node;
+
+  switch (peek_next_token(es))
+    {
+    case tok_oparen:
+      (void)get_next_token(es);
+      node = c_expr(es);
+      if (!node)
+	return NULL;
+      if (peek_next_token(es) != tok_cparen)
+	{
+	  eval_free(node);
+	  eval_error = ERR_UPAREN;
+	  return NULL;
+	}
+      (void)get_next_token(es);
+      return node;
+
+    case tok_minus:
+      /* negation operator, a tok_minus node without a right operand */
+      (void)get_next_token(es);
+      node = c_factor(es);
+      if (!node)
+	return NULL;
+      return new_node(tok_minus, node, NULL);
+
+    case tok_ident:
+      (void)get_next_token(es);
+      node = new_node(tok_ident, NULL, NULL);
+      node->ident = mystrdup(es->tok_buf);
+      return node;
+
+    case tok_const:
+      (void)get_next_token(es);
+      node = new_node(tok_const, NULL, NULL);
+      node->val = constant(es);
+      if (eval_error)
+	{
+	  eval_free(node);
+	  return NULL;
+	}
+      return node;
+
+    default:
+      eval_error = ERR_NOTERM;
+      return NULL;
+    }
+}
+
+/* compile an expression term, the same (right-associative) way term()
+   evaluates it */
+static struct eval_node_t *		/* term tree */
+c_term(struct eval_state_t *es)		/* expression tokenizer */
+{
+  enum eval_token_t tok;
+  struct eval_node_t *node, *right;
+
+  node = c_factor(es);
+  if (!node)
+    return NULL;
+
+  tok = peek_next_token(es);
+  if (tok == tok_mult || tok == tok_div)
+    {
+      (void)get_next_token(es);
+      right = c_term(es);
+      if (!right)
+	{
+	  eval_free(node);
+	  return NULL;
+	}
+      node = new_node(tok, node, right);
+    }
+
+  return node;
+}
+
+/* compile an expression, the same (right-associative) way expr()
+   evaluates it */
+static struct eval_node_t *		/* expression tree */
+c_expr(struct eval_state_t *es)		/* expression tokenizer */
+{
+  enum eval_token_t tok;
+  struct eval_node_t *node, *right;
+
+  node = c_term(es);
+  if (!node)
+    return NULL;
+
+  tok = peek_next_token(es);
+  if (tok == tok_plus || tok == tok_minus)
+    {
+      (void)get_next_token(es);
+      right = c_expr(es);
+      if (!right)
+	{
+	  eval_free(node);
+	  return NULL;
+	}
+      node = new_node(tok, node, right);
+    }
+
+  return node;
+}
+
+/* compile expression P into a tree, returns NULL and sets eval_error if it
+   is malformed, the tree evaluates to exactly what eval_expr() would
+   return for P, only without re-parsing it each time */
+struct eval_node_t *			/* expression tree */
+eval_compile(char *p,			/* ptr to expression string */
+	     char **endp)		/* returns ptr to 1st unused char */
+{
+  struct eval_state_t es;
+  struct eval_node_t *node;
+
+  eval_error = ERR_NOERR;
+  es.p = p;
+  *es.tok_buf = '\0';
+  es.peek_tok = tok_invalid;
+
+  node = c_expr(&es);
+
+  if (endp)
+    *endp = (es.peek_tok != tok_invalid) ? es.lastp : es.p;
+
+  return node;
+}
+
+/* evaluate a compiled expression subtree */
+static struct eval_value_t		/* value of the subtree */
+run_node(struct eval_node_t *node,	/* expression subtree */
+	 eval_node_ident_t f_eval_ident,/* identifier evaluator */
+	 void *user_ptr)		/* user ptr passed to ident fn */
+{
+  struct eval_value_t val, val1;
+
+  switch (node->op)
+    {
+    case tok_const:
+      return node->val;
+
+    case tok_ident:
+      val = f_eval_ident(node, user_ptr);
+      break;
+
+    case tok_plus:
+      val = run_node(node->left, f_eval_ident, user_ptr);
+      if (eval_error)
+	return err_value;
+      val = f_add(val, run_node(node->right, f_eval_ident, user_ptr));
+      break;
+
+    case tok_minus:
+      val = run_node(node->left, f_eval_ident, user_ptr);
+      if (eval_error)
+	return err_value;
+      if (!node->right)
+	val = f_neg(val);
+      else
+	val = f_sub(val, run_node(node->right, f_eval_ident, user_ptr));
+      break;
+
+    case tok_mult:
+      val = run_node(node->left, f_eval_ident, user_ptr);
+      if (eval_error)
+	return err_value;
+      val = f_mult(val, run_node(node->right, f_eval_ident, user_ptr));
+      break;
+
+    case tok_div:
+      val = run_node(node->left, f_eval_ident, user_ptr);
+      if (eval_error)
+	return err_value;
+      val1 = run_node(node->right, f_eval_ident, user_ptr);
+      if (eval_error)
+	return err_value;
+      if (f_eq_zero(val1))
+	{
+	  eval_error = ERR_DIV0;
+	  return err_value;
+	}
+      val = f_div(val, val1);
+      break;
+
+    default:
+      panic("bogus expression node");
+    }
+
+  if (eval_error)
+    return err_value;
+  return val;
+}
+
+/* evaluate compiled expression NODE, if an error occurs during evaluation,
+   the global variable eval_error will be set to a value other than
+   ERR_NOERR */
+struct eval_value_t			/* value of the expression */
+eval_run(struct eval_node_t *node,	/* compiled expression */
+	 eval_node_ident_t f_eval_ident,/* identifier evaluator */
+	 void *user_ptr)		/* user ptr passed to ident fn */
+{
+  eval_error = ERR_NOERR;
+  return run_node(node, f_eval_ident, user_ptr);
+}
+
+/* free compiled expression NODE */
+void
+eval_free(struct eval_node_t *node)	/* compiled expression */
+{
+  if (!node)
+    return;
+  eval_free(node->left);
+  eval_free(node->right);
+  if (node->ident)
+    free(node->ident);
+  free(node);
+}
+
 /* print an expression value */
 void
 eval_print(FILE *stream,		/* output stream */
@@ -192,6 +192,45 @@ eval_expr(struct eval_state_t *es,	/* expression evaluator */
 	  char *p,			/* ptr to expression string */
 	  char **endp);			/* returns ptr to 1st unused char */
 
+/* a compiled expression, a tree of these, see eval_compile() */
+struct eval_node_t {
+  enum eval_token_t op;			/* tok_const, tok_ident, or operator
+					   tok_plus, tok_minus, tok_mult or
+					   tok_div; a tok_minus without a
+					   RIGHT operand is negation */
+  struct eval_node_t *left, *right;	/* operands */
+  struct eval_value_t val;		/* value, for tok_const */
+  char *ident;				/* identifier, for tok_ident */
+  void *ident_data;			/* free for the identifier evaluator
+					   to use, e.g., to cache what IDENT
+					   refers to, initially NULL */
+};
+
+/* an identifier evaluator for compiled expressions, returns the value of
+   identifier NODE->IDENT, setting eval_error if it has none */
+typedef struct eval_value_t		  /* value of the identifier */
+(*eval_node_ident_t)(struct eval_node_t *node,	/* tok_ident node */
+		     void *user_ptr);		/* user-supplied pointer */
+
+/* compile expression P into a tree, returns NULL and sets eval_error if it
+   is malformed, the tree evaluates to exactly what eval_expr() would
+   return for P, only without re-parsing it each time */
+struct eval_node_t *			/* expression tree */
+eval_compile(char *p,			/* ptr to expression string */
+	     char **endp);		/* returns ptr to 1st unused char */
+
+/* evaluate compiled expression NODE, if an error occurs during evaluation,
+   the global variable eval_error will be set to a value other than
+   ERR_NOERR */
+struct eval_value_t			/* value of the expression */
+eval_run(struct eval_node_t *node,	/* compiled expression */
+	 eval_node_ident_t f_eval_ident,/* identifier evaluator */
+	 void *user_ptr);		/* user ptr passed to ident fn */
+
+/* free compiled expression NODE */
+void
+eval_free(struct eval_node_t *node);	/* compiled expression */
+
 /* print an expression value */
 void
 eval_print(FILE *stream,		/* output stream */
@@ -247,6 +247,11 @@ extern long random(void);
 #endif
 #include <limits.h>
 #include <strings.h>
+#include <string.h>
+#include <time.h>
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#endif
 
 #include "misc.h"
 #include "ss.h"
@@ -262,6 +267,9 @@ extern long random(void);
 #include "options.h"
 #include "stats.h"
 #include "ptrace.h"
+#include "checkpoint.h"
+#include "simpoint.h"
+#include "tseries.h"
 #include "dlite.h"
 #include "sim.h"
 
@@ -310,44 +318,29 @@ extern long random(void);
  * simulator options
  */
 
-/* can mis-speculate past at most this many branches */
-#ifdef CFG64
-#define N_SPEC_LEVELS 640 /* related arrays are statically allocated */
-#elif CFG40
-#define N_SPEC_LEVELS 384
-#elif CFG24
-#define N_SPEC_LEVELS 256
-#elif CFG16
-#define N_SPEC_LEVELS 128
-#elif CFG8
-#define N_SPEC_LEVELS 64
-#else
-#define N_SPEC_LEVELS 32
-#endif
+/* can mis-speculate past at most this many branches; set at startup from
+ * -threads:max (see spec_levels_for_threads()), related arrays are
+ * allocated once the option is known */
+static int n_spec_levels;
+#define N_SPEC_LEVELS (n_spec_levels)
 static int max_spec_level;
 
-/* max number of threads */
-#ifdef CFG64
-#define N_THREAD_RECS 64 /* related arrays are statically allocated */
-#elif CFG40
-#define N_THREAD_RECS 40
-#elif CFG24
-#define N_THREAD_RECS 24
-#elif CFG16
-#define N_THREAD_RECS 16
-#elif CFG8
-#define N_THREAD_RECS 8
-#else
-#define N_THREAD_RECS 1
-#endif
+/* max number of threads; thread records are allocated at startup, one per
+ * thread allowed by -threads:max */
+static int n_thread_recs;
+#define N_THREAD_RECS (n_thread_recs)
 static int max_threads;
 
-/* fork history depth */
-#define THREADS_BMAP_SZ (BITMAP_SIZE(N_SPEC_LEVELS))
+/* fork history depth, in bitmap words */
+static int threads_bmap_sz;
+#define THREADS_BMAP_SZ (threads_bmap_sz)
 
 /* file to receive simulator output; defaults to stderr */
 extern char *outfile_name;
 
+/* simulator stats database */
+extern struct stat_sdb_t *sim_sdb;
+
 /* pipeline trace range and output filename */
 static int ptrace_nelt = 0;
 static char *ptrace_opts[3];
@@ -614,6 +607,14 @@ static int cache_il2_lat_nelt = 2;
 static int cache_il2_lat[2] =
     {/* base access lat */ 2, /* extra lat for hits */ 1};
 
+/* caches and TLBs to use the flat tag layout, comma-separated names, or
+   "all" or "none" */
+static char *cache_flat_opt;
+
+/* reserve the buses to the next level of memory by time slot, instead of
+   queueing requests in the order they are made */
+static int cache_bus_slotted;
+
 /* flush caches on system calls */
 int flush_on_syscalls;
 
@@ -671,6 +672,82 @@ static unsigned int num_prime_insn;
 /* number of committed instructions for which to simulate after priming */
 static unsigned int num_fullsim_insn;
 
+/* checkpoint to write once warmup is done, and whether it also holds the
+   warmed caches, TLBs and predictors */
+static char *ckpt_save_fname;
+static int ckpt_save_uarch;
+
+/* checkpoint to start from in place of warmup */
+static char *ckpt_restore_fname;
+
+/* simulation points to sample (see simpoint.h), and number of committed
+   instructions to simulate in detail before measuring each one */
+static char *simpoint_fname;
+static unsigned int simpoint_warm_insn;
+
+/* SimPoint sampling state: the points, sorted by interval, the one being
+   simulated, and the weighted sum of the finished points' per-interval
+   stats */
+static struct simpoint_t *simpoints;
+static int simpoint_num = 0;
+static SS_COUNTER_TYPE simpoint_interval;
+static int simpoint_cur;
+static double *simpoint_est;
+static double simpoint_weight = 0.0;
+
+/* SMARTS periodic sampling: a sampling unit is measured every
+   smarts_period committed instructions, after smarts_warm instructions of
+   detailed warming; sampling stops once the confidence interval on CPI is
+   within smarts_ci percent of the mean */
+static unsigned int smarts_period = 0;
+static unsigned int smarts_unit;
+static unsigned int smarts_warm;
+static float smarts_ci;
+static float smarts_confidence;
+static unsigned int smarts_min_units;
+
+/* further stats sampled per unit, besides CPI */
+#define MAX_SMARTS_STATS 16
+static int smarts_nelt = 0;
+static char *smarts_stats[MAX_SMARTS_STATS];
+
+/* SMARTS state: the unit being simulated, and the stat sampled per unit
+   and sampled metric for CPI and each of -smarts:stats */
+static SS_COUNTER_TYPE smarts_cur;
+static int smarts_nmetrics;
+static struct stat_stat_t *smarts_metric[MAX_SMARTS_STATS + 1];
+static struct stat_stat_t *smarts_sample[MAX_SMARTS_STATS + 1];
+
+/* the detailed window a sampling mode is simulating: warming in detail from
+   sample_warm_start, then measuring from sample_start to sample_end; it is
+   in one of three phases */
+static SS_COUNTER_TYPE sample_warm_start, sample_start, sample_end;
+static enum sample_phase_t {
+  SP_Warm,                      /* detailed, before the measurement */
+  SP_Measure,                   /* detailed, measuring */
+  SP_Drain                      /* fetch stopped, emptying the pipeline */
+} sample_phase;
+
+/* scalar stats when the current window's measurement began */
+static int sample_nstats;
+static double *sample_before;
+static SS_COUNTER_TYPE sample_before_insn;
+
+/* no fetching while the pipeline drains for a fast-forward */
+static int fetch_stopped = FALSE;
+
+/* stats time series file, sampled every stats_interval cycles or
+   committed instructions (stats_interval_unit) */
+static char *stats_series_fname;
+static unsigned int stats_interval;
+static char *stats_interval_unit;
+
+/* stats time series state: the series, whether it counts instructions,
+   and when the next sample is due */
+static struct tseries_t *stats_series = NULL;
+static int stats_by_insts;
+static SS_COUNTER_TYPE stats_next_sample;
+
 /* reporting options */
 static int report_fetch = FALSE;
 static int report_issue = FALSE;
@@ -707,6 +784,64 @@ static struct stat_stat_t *d1miss_cluster_dist = NULL;
 static struct stat_stat_t *i1miss_cluster_dist = NULL;
 static struct stat_stat_t *cbr_data_dist = NULL;
 
+/* time the pipeline stages in sim_main(), in host time stamp counter
+   ticks, and report them when stats are printed */
+static int profile_stages = FALSE;
+
+/* the profiled stages */
+enum prof_stage_t {
+  PS_Commit,
+  PS_ReleaseFU,
+  PS_Writeback,
+  PS_LSQRefresh,
+  PS_Issue,
+  PS_Dispatch,
+  PS_Fetch,
+  PS_KillThreads,
+  PS_NUM
+};
+static char *prof_stage_names[PS_NUM] = {
+  "ruu_commit", "ruu_release_fu", "ruu_writeback", "lsq_refresh",
+  "ruu_issue", "ruu_dispatch", "ruu_fetch_wrapper", "kill_threads"
+};
+
+/* ticks spent in, and calls of, each stage; and the ticks, host time and
+   simulator state when the main loop started */
+static unsigned long long prof_ticks[PS_NUM];
+static SS_COUNTER_TYPE prof_calls[PS_NUM];
+static unsigned long long prof_start_ticks;
+static double prof_start_ns;
+static SS_COUNTER_TYPE prof_start_cycle, prof_start_insn;
+
+/* time the pipeline stages: PROF_BEGIN() before the first one, and
+   PROF_END(STAGE) after each, which charges the time since the last mark
+   to STAGE, so there is one time stamp per stage; without -profile:stages
+   each costs a predictable branch */
+static unsigned long long prof_t0;
+#define PROF_BEGIN()                                         \
+  do {                                                       \
+    if (profile_stages)                                      \
+      prof_t0 = host_ticks();                                \
+  } while (0)
+#define PROF_END(STAGE)                                      \
+  do {                                                       \
+    if (profile_stages)                                      \
+    {                                                        \
+      unsigned long long now = host_ticks();                 \
+      prof_ticks[STAGE] += now - prof_t0;                    \
+      prof_calls[STAGE]++;                                   \
+      prof_t0 = now;                                         \
+    }                                                        \
+  } while (0)
+
+/* skip the cycles in which the pipeline only waits on long latency events,
+   crediting their stats in bulk; see idle_skip() */
+static int skip_idle = TRUE;
+
+/* bumped by each pipeline stage whenever it changes machine state, so a
+   cycle that leaves it alone changed nothing but the stats */
+static unsigned long pipe_activity = 0;
+
 extern struct stat_stat_t *bconf_correct_dist;
 extern struct stat_stat_t *bconf_incorrect_dist;
 
@@ -749,12 +884,14 @@ struct res_desc fu_config[] = {
     {"integer-ALU",
      4,
      0,
-     {{IntALU, 1, 1}}},
+     {{IntALU, 1, 1}},
+     0, NULL, NULL},
     {"integer-shift-branch",
      4,
      0,
      {{Branch, 1, 1},
-      {IntSHIFT, 1, 1}}},
+      {IntSHIFT, 1, 1}},
+     0, NULL, NULL},
     {"integer-MULT/DIV",
      1,
      0,
@@ -766,17 +903,20 @@ struct res_desc fu_config[] = {
          {IntMULT, 12, 8},
          {IntDIV, 20, 19}
 #endif
-     }},
+     },
+     0, NULL, NULL},
     /* FIXME: If mem-port issuelat > 1, dl1-port bookkeeping breaks */
     {
         "memory-load-port",
         2,
         0,
-        {{RdPort, 1, 1}}},
+        {{RdPort, 1, 1}},
+        0, NULL, NULL},
     {"memory-store-port",
      1,
      0,
-     {{WrPort, 1, 1}}},
+     {{WrPort, 1, 1}},
+     0, NULL, NULL},
     {"FP-adder",
      4,
      0,
@@ -790,7 +930,8 @@ struct res_desc fu_config[] = {
          {FloatCMP, 4, 1},
          {FloatCVT, 4, 1}
 #endif
-     }},
+     },
+     0, NULL, NULL},
     {"FP-MULT",
      2,
      0,
@@ -800,7 +941,8 @@ struct res_desc fu_config[] = {
 #else
          {FloatMULT, 4, 1}
 #endif
-     }},
+     },
+     0, NULL, NULL},
     {"FP-DIV/SQRT",
      1,
      0,
@@ -812,7 +954,8 @@ struct res_desc fu_config[] = {
          {FloatDIV, 16, 16},
          {FloatSQRT, 33, 33}
 #endif
-     }}};
+     },
+     0, NULL, NULL}};
 
 static int fu_oplat_arr[NUM_FU_CLASSES];
 int infinite_fu;
@@ -903,7 +1046,7 @@ static SS_TIME_TYPE last_dmiss_cycle = 0;
 static BITMAP_ENT_TYPE fork_hist_bmap_head = 0;
 static int num_active_forks = 0;
 static int num_zombie_forks = 0;
-static int last_thread_fetched = N_THREAD_RECS - 1;
+static int last_thread_fetched;
 
 /* current integer-issue-queue (IIQ) occupancy */
 static int IIQ_occ = 0;
@@ -1179,12 +1322,16 @@ void sim_reg_options(struct opt_odb_t *odb)
                "	   shows correctly-speculated instructions in ruu_dispatch())\n"
                "  Memory info prints each load or store's address, and the value of the\n"
                "  4-byte word at that address after the load/store has executed.\n"
+               "  A `b' after the level (e.g. 4b) writes a binary trace, which is several\n"
+               "  times faster to write; a .gz file name compresses it (through gzip).\n"
+               "  Use ptrace-read to convert it to text, filtered by thread, PC or cycle.\n"
                "\n"
                "    Examples:   -ptrace 1 FOO.trc #0:#1000\n"
                "                -ptrace 1 BAR.trc @2000:\n"
                "                -ptrace 1 BLAH.trc :1500\n"
                "                -ptrace 1 UXXE.trc :\n"
-               "                -ptrace 3 FOOBAR.trc @main:+278\n");
+               "                -ptrace 3 FOOBAR.trc @main:+278\n"
+               "                -ptrace 4b FOO.bpt.gz #0:#1000000\n");
 
   /* multi-path/multi-threading options */
   opt_reg_int(sim_odb, "-threads:max",
@@ -1676,6 +1823,34 @@ void sim_reg_options(struct opt_odb_t *odb)
                    /* default */ cache_il2_lat, /* print */ TRUE,
                    /* format */ NULL, /* accrue */ FALSE);
 
+  opt_reg_string(odb, "-cache:flat",
+                 "caches and TLBs to look up through flat SIMD tag arrays, "
+                 "i.e., {<name>[,<name>...]|all|none}",
+                 &cache_flat_opt, "all", /* print */ TRUE, NULL);
+
+  opt_reg_note(odb,
+               "  Caches named by -cache:flat keep each set's tags in an array that is\n"
+               "  searched with one SIMD compare, and their LRU order as a position per\n"
+               "  block instead of a linked list.  Hits, misses and replacements are the\n"
+               "  same either way, only simulation speed differs.\n"
+               "\n"
+               "    Examples:   -cache:flat dl1,il1,dtlb,itlb\n"
+               "                -cache:flat none\n");
+
+  opt_reg_flag(odb, "-cache:bus_slotted",
+               "reserve cache buses by time slot instead of in request order",
+               &cache_bus_slotted, /* default */ FALSE, /* print */ TRUE, NULL);
+
+  opt_reg_note(odb,
+               "  Each cache's <bus interval> is a pipelined bus to the next level (dl2's\n"
+               "  is the memory bus), taking a new transaction every <bus interval>\n"
+               "  cycles.  Misses are made ahead of time, at the cycle they reach the\n"
+               "  bus, and not in time order, e.g., by different paths of a thread.\n"
+               "  By default the bus takes them in the order they are made, so a miss\n"
+               "  waits for any made before it, even if they use the bus later.  With\n"
+               "  -cache:bus_slotted each transaction reserves its cycles on the bus,\n"
+               "  and a miss takes the earliest free ones from its cycle on.\n");
+
   opt_reg_flag(odb, "-cache:flush", "flush caches on system calls",
                &flush_on_syscalls, /* default */ FALSE, /* print */ TRUE, NULL);
 
@@ -1785,8 +1960,97 @@ void sim_reg_options(struct opt_odb_t *odb)
                "number of committed instructions for which to warm up caches",
                &num_warmup_insn, /* default */ 0, /* print */ TRUE, NULL);
 
+  opt_reg_string(odb, "-ckpt:save",
+                 "write a checkpoint of program state to this file once "
+                 "warmup is done",
+                 &ckpt_save_fname, /* default */ NULL,
+                 /* print */ TRUE, /* format */ NULL);
+
+  opt_reg_flag(odb, "-ckpt:uarch",
+               "include warmed caches, TLBs and predictors in -ckpt:save",
+               &ckpt_save_uarch, /* default */ FALSE, /* print */ TRUE, NULL);
+
+  opt_reg_string(odb, "-ckpt:restore",
+                 "start from this checkpoint instead of warming up",
+                 &ckpt_restore_fname, /* default */ NULL,
+                 /* print */ TRUE, /* format */ NULL);
+
+  opt_reg_string(odb, "-simpoint:file",
+                 "simulate in detail only the simulation points in this file "
+                 "(from sim-profile -simpoint:file)",
+                 &simpoint_fname, /* default */ NULL,
+                 /* print */ TRUE, /* format */ NULL);
+
+  opt_reg_uint(odb, "-simpoint:warm",
+               "number of insts to simulate in detail before measuring each "
+               "simulation point",
+               &simpoint_warm_insn, /* default */ 100000,
+               /* print */ TRUE, NULL);
+
+  opt_reg_uint(odb, "-smarts:period",
+               "measure a sampling unit every this many insts, warming "
+               "functionally in between (0 = no periodic sampling)",
+               &smarts_period, /* default */ 0,
+               /* print */ TRUE, NULL);
+
+  opt_reg_uint(odb, "-smarts:unit",
+               "number of insts measured per sampling unit",
+               &smarts_unit, /* default */ 1000,
+               /* print */ TRUE, NULL);
+
+  opt_reg_uint(odb, "-smarts:warm",
+               "number of insts to simulate in detail before each unit",
+               &smarts_warm, /* default */ 2000,
+               /* print */ TRUE, NULL);
+
+  opt_reg_float(odb, "-smarts:ci",
+                "stop once the confidence interval on CPI is within this "
+                "percentage of the mean (0 = run to completion)",
+                &smarts_ci, /* default */ 3.0,
+                /* print */ TRUE, NULL);
+
+  opt_reg_float(odb, "-smarts:confidence",
+                "confidence level of the reported intervals, in percent",
+                &smarts_confidence, /* default */ 99.7,
+                /* print */ TRUE, NULL);
+
+  opt_reg_uint(odb, "-smarts:min_units",
+               "minimum number of units to measure before stopping",
+               &smarts_min_units, /* default */ 30,
+               /* print */ TRUE, NULL);
+
+  opt_reg_string_list(odb, "-smarts:stats",
+                      "further stats to sample per unit, besides sim_CPI",
+                      smarts_stats, MAX_SMARTS_STATS, &smarts_nelt, NULL,
+                      /* print */ TRUE, /* format */ NULL, /* accrue */ TRUE);
+
   /* Reporting options */
 
+  opt_reg_string(odb, "-stats:series",
+                 "write the change of every counter over each interval to "
+                 "this stats time series file",
+                 &stats_series_fname, /* default */ NULL,
+                 /* print */ TRUE, /* format */ NULL);
+
+  opt_reg_uint(odb, "-stats:interval",
+               "stats time series interval length",
+               &stats_interval, /* default */ 100000,
+               /* print */ TRUE, NULL);
+
+  opt_reg_string(odb, "-stats:interval_unit",
+                 "stats time series interval unit, i.e., {cycles|insts}",
+                 &stats_interval_unit, /* default */ "cycles",
+                 /* print */ TRUE, /* format */ NULL);
+
+  opt_reg_note(odb,
+               "  The stats time series is binary, only counters that changed in an\n"
+               "  interval are written; a name ending in `.gz' is compressed.  Convert\n"
+               "  it to CSV, with each formula (sim_IPC, ...) computed per interval,\n"
+               "  with tseries-read.\n"
+               "\n"
+               "    Examples:   -stats:series run.ts.gz -stats:interval 1000000\n"
+               "                tseries-read -s sim_IPC,dl1.miss_rate run.ts.gz\n");
+
   opt_reg_flag(odb, "-report_fetch",
                "report histogram of no. insts fetched/cycle",
                &report_fetch, /* default */ FALSE, /* print */ TRUE, NULL);
@@ -1845,6 +2109,16 @@ void sim_reg_options(struct opt_odb_t *odb)
                &report_miss_clustering,
                /* default */ FALSE, /* print */ TRUE, NULL);
 
+  opt_reg_flag(odb, "-profile:stages",
+               "report host time spent per simulated cycle in each pipeline "
+               "stage, and simulation speed",
+               &profile_stages, /* default */ FALSE, /* print */ TRUE, NULL);
+
+  opt_reg_flag(odb, "-skip:idle",
+               "skip ahead over cycles in which the pipeline is stalled on "
+               "long latency events (does not change the results)",
+               &skip_idle, /* default */ TRUE, /* print */ TRUE, NULL);
+
   /* dummy options */
   opt_reg_flag(odb, "-Z", "dummy", &dummy_flag, FALSE, TRUE, NULL);
   opt_reg_int(odb, "-z", "dummy", &dummy_int, FALSE, TRUE, NULL);
@@ -2104,27 +2378,130 @@ sim_check_bpred(struct opt_odb_t *odb,  /* options database */
   return pred;
 }
 
+/* number of thread records to provide for 'threads' thread contexts;
+ * these are the sizes the old CFG1..CFG64 builds used, the fetch
+ * round-robin policies cycle over all records, so results match those
+ * builds */
+static int
+thread_recs_for_threads(int threads)
+{
+  if (threads <= 1)
+    return 1;
+  else if (threads <= 8)
+    return 8;
+  else if (threads <= 16)
+    return 16;
+  else if (threads <= 24)
+    return 24;
+  else if (threads <= 40)
+    return 40;
+  else if (threads <= 64)
+    return 64;
+  else
+    return threads;
+}
+
+/* number of speculation levels (and fork-history bits) to provide for
+ * 'threads' thread contexts; these are the depths the old CFG1..CFG64
+ * builds used, so results match those builds */
+static int
+spec_levels_for_threads(int threads)
+{
+  if (threads <= 1)
+    return 32;
+  else if (threads <= 8)
+    return 64;
+  else if (threads <= 16)
+    return 128;
+  else if (threads <= 24)
+    return 256;
+  else if (threads <= 40)
+    return 384;
+  else if (threads <= 64)
+    return 640;
+  else
+    return 10 * threads;
+}
+
 /* check simulator-specific option values */
 void sim_check_options(struct opt_odb_t *odb, /* options database */
                        int argc, char **argv) /* command line arguments */
 {
   char name[128], c;
-  int nsets, bsize, assoc, mshrs, busint;
+  int i, nsets, bsize, assoc, mshrs, busint;
+  unsigned int warmup_insn = num_warmup_insn;
 
   if (ptrace_nelt != 3 && ptrace_nelt != 0)
     fatal("ptrace takes 3 arguments: <level> <fname|stdout|stderr> <range>");
 
-  if (num_warmup_insn > 0 && num_prime_insn == 0)
-    num_prime_insn = num_warmup_insn + 1000000;
-  else if (num_warmup_insn > 0)
-    num_prime_insn += num_warmup_insn;
+  if (simpoint_fname)
+  {
+    if (num_warmup_insn > 0 || num_prime_insn > 0
+        || ckpt_save_fname || ckpt_restore_fname)
+      fatal("-simpoint:file does its own warming; don't also give "
+            "-warmup_insts, -prime_insts or -ckpt:*");
+    simpoint_num = simpoint_read(simpoint_fname, &simpoint_interval,
+                                 &simpoints);
+  }
+
+  if (stats_series_fname)
+  {
+    if (stats_interval == 0)
+      fatal("-stats:interval must be positive");
+    if (!mystricmp(stats_interval_unit, "insts"))
+      stats_by_insts = TRUE;
+    else if (!mystricmp(stats_interval_unit, "cycles"))
+      stats_by_insts = FALSE;
+    else
+      fatal("-stats:interval_unit must be `cycles' or `insts'");
+  }
+
+  if (smarts_period)
+  {
+    if (simpoint_fname || num_warmup_insn > 0 || num_prime_insn > 0
+        || ckpt_save_fname || ckpt_restore_fname)
+      fatal("-smarts:period does its own warming; don't also give "
+            "-simpoint:file, -warmup_insts, -prime_insts or -ckpt:*");
+    if (smarts_unit == 0)
+      fatal("-smarts:unit must be positive");
+    if (smarts_period < smarts_warm + smarts_unit)
+      fatal("-smarts:period must cover -smarts:warm plus -smarts:unit");
+    if (smarts_ci < 0.0)
+      fatal("-smarts:ci must not be negative");
+  }
+
+  /* pipetraces show every cycle, and sampling keeps its own stats */
+  if (ptrace_nelt || simpoint_fname || smarts_period)
+    skip_idle = FALSE;
+
+  if (ckpt_save_fname && num_warmup_insn == 0)
+    fatal("-ckpt:save writes the checkpoint after warmup; give -warmup_insts");
+  if (ckpt_save_fname && ckpt_restore_fname)
+    fatal("can't both -ckpt:save and -ckpt:restore");
+  if (ckpt_restore_fname)
+  {
+    struct ckpt_header hdr;
+
+    if (num_warmup_insn > 0)
+      fatal("-ckpt:restore replaces warmup; don't also give -warmup_insts");
+
+    /* prime exactly as the run that wrote the checkpoint would have */
+    fclose(ckpt_open(ckpt_restore_fname, &hdr));
+    warmup_insn = hdr.warmup_insn;
+  }
+
+  if (warmup_insn > 0 && num_prime_insn == 0)
+    num_prime_insn = warmup_insn + 1000000;
+  else if (warmup_insn > 0)
+    num_prime_insn += warmup_insn;
 
   if (max_threads < 1)
     fatal("max number of threads must be at least 1");
-  if (max_threads > N_THREAD_RECS)
-    fatal("max number of threads can't currently exceed %d.  \n"
-          "   Try increasing N_THREAD_RECS",
-          N_THREAD_RECS);
+
+  /* size the per-thread and per-spec-level tables */
+  n_thread_recs = thread_recs_for_threads(max_threads);
+  n_spec_levels = spec_levels_for_threads(max_threads);
+  threads_bmap_sz = BITMAP_SIZE(n_spec_levels);
 
   if (ruu_ifq_size < 1 || (ruu_ifq_size & (ruu_ifq_size - 1)) != 0)
     fatal("inst fetch queue size must be positive > 0 and a power of two");
@@ -2522,6 +2899,41 @@ void sim_check_options(struct opt_odb_t *odb, /* options database */
       cache_set_perfect(itlb);
   }
 
+  if (mystricmp(cache_flat_opt, "none"))
+  {
+    struct cache *caches[6];
+    char *names = mystrdup(cache_flat_opt), *fname;
+    int all = !mystricmp(cache_flat_opt, "all"), found;
+
+    caches[0] = cache_dl1; caches[1] = cache_dl2;
+    caches[2] = cache_il1; caches[3] = cache_il2;
+    caches[4] = dtlb; caches[5] = itlb;
+    for (fname = strtok(names, ","); fname; fname = strtok(NULL, ","))
+    {
+      for (i = 0, found = FALSE; i < 6; i++)
+        if (caches[i] && (all || !strcmp(fname, caches[i]->name)))
+        {
+          cache_set_flat(caches[i]);
+          found = TRUE;
+        }
+      if (!found && !all)
+        fatal("-cache:flat: no cache or TLB named `%s'", fname);
+    }
+    free(names);
+  }
+
+  if (cache_bus_slotted)
+  {
+    if (cache_dl1)
+      cache_set_bus_slotted(cache_dl1);
+    if (cache_dl2)
+      cache_set_bus_slotted(cache_dl2);
+    if (cache_il1)
+      cache_set_bus_slotted(cache_il1);
+    if (cache_il2)
+      cache_set_bus_slotted(cache_il2);
+  }
+
   if (cache_dl1_lat_nelt != 2)
     fatal("bad l1 data cache latency (<base lat> <extra hit lat>)");
 
@@ -2655,6 +3067,9 @@ void sim_reg_stats(struct stat_sdb_t *sdb) /* stats database */
   stat_reg_formula(sdb, "sim_inst_rate",
                    "simulation speed (in insts/sec)",
                    "sim_num_insn / sim_elapsed_time", NULL);
+  stat_reg_int(sdb, "sim_host_maxrss",
+               "peak host memory used by the simulator (in KB)",
+               &sim_host_maxrss, 0, NULL);
 
   stat_reg_counter(sdb, "sim_total_insn",
                    "total number of instructions executed",
@@ -3013,6 +3428,31 @@ void sim_reg_stats(struct stat_sdb_t *sdb) /* stats database */
                                    (PF_COUNT | PF_PDF | PF_CDF),
                                    NULL,  /* opt output format */
                                    NULL); /* optional user print func*/
+
+  if (smarts_period)
+  {
+    /* sample CPI, then each -smarts:stats stat, once per unit */
+    smarts_nmetrics = smarts_nelt + 1;
+    for (i = 0; i < smarts_nmetrics; i++)
+    {
+      char buf[512], buf1[512];
+      char *name = i == 0 ? "sim_CPI" : smarts_stats[i - 1];
+      struct stat_stat_t *stat;
+
+      stat = stat_find_stat(sdb, name);
+      if (!stat)
+        fatal("cannot locate any statistic named `%s'", name);
+      if (stat->sc == sc_dist || stat->sc == sc_sdist || stat->sc == sc_sample)
+        fatal("`-smarts:stats' statistical variable `%s' is not a scalar "
+              "or formula", stat->name);
+      smarts_metric[i] = stat;
+
+      sprintf(buf, "smarts.%s", stat->name);
+      sprintf(buf1, "%s, per sampling unit", stat->desc);
+      smarts_sample[i] = stat_reg_sample(sdb, buf, buf1, smarts_confidence,
+                                         NULL);
+    }
+  }
 }
 
 /* forward declarations */
@@ -3121,6 +3561,8 @@ struct RUU_station
      instructions complete and need to wake up dependent insts */
   int onames[MAX_ODEPS];                /* output logical names (NA=unused) */
   struct RS_link *odep_list[MAX_ODEPS]; /* chains to consuming operations */
+  struct cv_ref *cv_refs[MAX_ODEPS];    /* create vector chunks that may
+                                         * name each output as the creator */
   struct res_template *fu;              /* a ptr to the func. unit used by
 					 * this instr. */
 
@@ -3147,12 +3589,29 @@ struct RUU_station
   int pred_thread;
   int correct_thread;
   int token2forked;                           /* gave token to forked-off thread? */
-  int squashable;                             /* short-term flag: to be squashed? */
   int squashed;                               /* squashed inst; treat as no-op */
   int thread_id;                              /* which thread fetched this inst */
+  int thread_prev;                            /* next older RUU entry of this
+                                                 thread, and its seq (it has
+                                                 left the RUU if RUU[thread_prev]
+                                                 has another seq) */
+  INST_SEQ_TYPE thread_prev_seq;
+  int lsq_index;                              /* addr comps: the LSQ entry of
+                                                 the memory access */
+  int addr_hashed;                            /* LSQ stores: in the store
+                                                 address hash? */
+  struct RUU_station *addr_next, *addr_prev;  /* LSQ stores: its bucket */
+  struct RUU_station *lsq_waiters;            /* LSQ stores: loads waiting
+                                                 for the store data */
+  struct RUU_station *lsq_next, *lsq_prev;    /* LSQ entries: on lsq_touched,
+                                                 or waiting for a store */
+  struct RUU_station **lsq_list;              /* the head of that list, NULL
+                                                 if on neither */
   int pred_path_token;                        /* branches:is this on the pred-path?*/
   int new_pred_path_token;                    /* same as above, for a diff. scheme */
-  BITMAP_TYPE(N_SPEC_LEVELS, fork_hist_bmap); /* fork history bitmap */
+  BITMAP_PTR_TYPE fork_hist_bmap;             /* fork history bitmap, each
+                                                 entry owns its storage, so
+                                                 copy the bits, not this */
   BITMAP_ENT_TYPE fork_hist_bmap_ptr;         /* ptr to this inst's pos'n in bmap */
 };
 
@@ -3160,6 +3619,20 @@ struct RUU_station
 #define OPERANDS_READY(RS) \
   ((RS)->idep_ready[0] && (RS)->idep_ready[1] && (RS)->idep_ready[2])
 
+/* allocate NUM zeroed fork-history bitmaps, THREADS_BMAP_SZ words each, in
+ * one contiguous block; bitmap I starts at word I * THREADS_BMAP_SZ */
+static BITMAP_PTR_TYPE
+fork_hist_bmap_alloc(int num) /* number of bitmaps */
+{
+  BITMAP_PTR_TYPE bmaps;
+
+  bmaps = calloc(num * THREADS_BMAP_SZ, sizeof(BITMAP_ENT_TYPE));
+  if (!bmaps)
+    fatal("out of virtual memory");
+
+  return bmaps;
+}
+
 /* register update unit, combination of reservation stations and reorder
    buffer device, organized as a circular queue */
 static struct RUU_station *RUU; /* register update unit */
@@ -3170,10 +3643,17 @@ static int RUU_num;             /* num entries currently in RUU */
 static void
 ruu_init(void)
 {
+  int i;
+  BITMAP_PTR_TYPE bmaps;
+
   RUU = calloc(RUU_size, sizeof(struct RUU_station));
   if (!RUU)
     fatal("out of virtual memory");
 
+  bmaps = fork_hist_bmap_alloc(RUU_size);
+  for (i = 0; i < RUU_size; i++)
+    RUU[i].fork_hist_bmap = bmaps + i * THREADS_BMAP_SZ;
+
   RUU_num = 0;
   RUU_head = RUU_tail = 0;
 }
@@ -3280,6 +3760,28 @@ static struct RUU_station *LSQ; /* load/store queue */
 static int LSQ_head, LSQ_tail;  /* LSQ head and tail pointers */
 static int LSQ_num;             /* num entries currently in LSQ */
 
+/*
+ * memory disambiguation state, see lsq_refresh(): the number of LSQ entries
+ * from LSQ_head on that have been checked for memory dependences; the one
+ * after them, if any, is a store with an unknown address, which blocks all
+ * later loads
+ */
+static int lsq_checked;
+
+/* the checked stores that are not squashed, hashed on their address */
+static struct RUU_station **lsq_addr_hash;
+static int lsq_addr_hash_mask;
+#define LSQ_ADDR_HASH(ADDR) (&lsq_addr_hash[((ADDR) >> 2) & lsq_addr_hash_mask])
+
+/* LSQ entries with an operand that became ready since the last
+   lsq_refresh(), and loads whose store got its data or went away; the
+   lists are threaded through the entries, an entry is on one at most */
+static struct RUU_station *lsq_touched;
+
+/* position of LSQ entry RS in the LSQ, 0 at LSQ_head */
+#define LSQ_POS(RS) \
+  ((int)((RS) - LSQ) - LSQ_head + ((int)((RS) - LSQ) < LSQ_head ? LSQ_size : 0))
+
 /*
  * input dependencies for stores in the LSQ:
  *   idep #0 - operand input (value that is store'd)
@@ -3295,12 +3797,29 @@ static int LSQ_num;             /* num entries currently in LSQ */
 static void
 lsq_init(void)
 {
+  int i;
+  BITMAP_PTR_TYPE bmaps;
+
   LSQ = calloc(LSQ_size, sizeof(struct RUU_station));
   if (!LSQ)
     fatal("out of virtual memory");
 
+  bmaps = fork_hist_bmap_alloc(LSQ_size);
+  for (i = 0; i < LSQ_size; i++)
+    LSQ[i].fork_hist_bmap = bmaps + i * THREADS_BMAP_SZ;
+
   LSQ_num = 0;
   LSQ_head = LSQ_tail = 0;
+
+  /* a store address hash with at least one bucket per entry */
+  for (i = 1; i < LSQ_size; i <<= 1)
+    ;
+  lsq_addr_hash = calloc(i, sizeof(struct RUU_station *));
+  if (!lsq_addr_hash)
+    fatal("out of virtual memory");
+  lsq_addr_hash_mask = i - 1;
+  lsq_checked = 0;
+  lsq_touched = NULL;
 }
 
 /* dump the contents of the LSQ */
@@ -3343,7 +3862,7 @@ struct thread_state
 						 * different scheme */
 #endif
   BITMAP_ENT_TYPE fork_hist_bmap_ptr;         /* this thread's bmap slot */
-  BITMAP_TYPE(N_SPEC_LEVELS, fork_hist_bmap); /* this thread's br-hist bmap*/
+  BITMAP_PTR_TYPE fork_hist_bmap;             /* this thread's br-hist bmap*/
 
   struct bpred_btb_ent *retstack; /* return-address stack */
   int retstack_tos;               /* ret-stack top-of-stack */
@@ -3356,30 +3875,90 @@ struct thread_state
   int spec_level;               /* speculated past this many
 						 * branches (count from 1) */
   int squashed;                 /* flag for cleanup */
+  unsigned int squash_epoch;    /* the recovery that last squashed
+						 * this thread, see thread_cleanup() */
+  int ruu_youngest;             /* youngest RUU entry of this thread,
+						 * and its seq, see ruu_recover() */
+  INST_SEQ_TYPE ruu_youngest_seq;
   int valid;                    /* is this record valid? */
 };
 
-/* The central structure to keep track of per-thread state */
-static struct thread_state thread_info[N_THREAD_RECS];
+/* The central structure to keep track of per-thread state, one record per
+ * thread context (N_THREAD_RECS) */
+static struct thread_state *thread_info;
 
 /* which thread is currently at leaf of predicted path? */
 int pred_thread = INIT_THREAD;
 
+/* per thread being squashed by ruu_recover(), its youngest RUU entry not
+ * squashed yet, and that entry's seq */
+struct recover_cursor
+{
+  int thread;
+  int index;
+  INST_SEQ_TYPE seq;
+};
+static struct recover_cursor *recover_cursors;
+
+/* the branch-misprediction recovery in progress, an RUU or LSQ entry is
+ * to be squashed by it if its thread's squash_epoch matches; bumped at the
+ * start and end of each recovery, so no thread matches outside of one */
+static unsigned int squash_epoch = 0;
+#define RS_SQUASHABLE(RS) \
+  (thread_info[(RS)->thread_id].squash_epoch == squash_epoch)
+
 #ifdef DEBUG_PRED_PRI
 /* current value of a valid new_pred_path_token; any other value is
  * invalid */
 static int new_pred_path_token_val = 1;
 #endif
 
-/* keeps data about how many insts each thread has in the ruu.  designed
- * to be qsorted */
+/* keeps data about how many insts each thread has in the ruu, in the
+ * order ruu-pri fetch should visit the threads this cycle */
 struct ruu_occ_by_thread_t
 {
   int count; /* # of insts in RUU */
   int thread;
 };
 
-static struct ruu_occ_by_thread_t ruu_occ_by_thread[N_THREAD_RECS];
+static struct ruu_occ_by_thread_t *ruu_occ_by_thread;
+
+/* per-thread count of unissued, unsquashed RUU entries, kept up to date
+ * at dispatch, issue and squash time when fetching by ruu-pri */
+static int *ruu_occ_count;
+
+/* thread ids sorted by ascending (ruu_occ_count, thread id), and each
+ * thread's position in that array */
+static int *ruu_occ_order;
+static int *ruu_occ_pos;
+
+/* allocate thread records and the per-thread tables that go with them */
+static void
+thread_info_init(void)
+{
+  int t;
+  BITMAP_PTR_TYPE bmaps;
+
+  thread_info = calloc(N_THREAD_RECS, sizeof(struct thread_state));
+  ruu_occ_by_thread = calloc(N_THREAD_RECS,
+                             sizeof(struct ruu_occ_by_thread_t));
+  ruu_occ_count = calloc(N_THREAD_RECS, sizeof(int));
+  ruu_occ_order = calloc(N_THREAD_RECS, sizeof(int));
+  ruu_occ_pos = calloc(N_THREAD_RECS, sizeof(int));
+  recover_cursors = calloc(N_THREAD_RECS, sizeof(struct recover_cursor));
+  if (!thread_info || !ruu_occ_by_thread
+      || !ruu_occ_count || !ruu_occ_order || !ruu_occ_pos || !recover_cursors)
+    fatal("out of virtual memory");
+
+  for (t = 0; t < N_THREAD_RECS; t++)
+    ruu_occ_order[t] = ruu_occ_pos[t] = t;
+
+  bmaps = fork_hist_bmap_alloc(N_THREAD_RECS);
+  for (t = 0; t < N_THREAD_RECS; t++)
+    thread_info[t].fork_hist_bmap = bmaps + t * THREADS_BMAP_SZ;
+
+  last_thread_fetched = N_THREAD_RECS - 1;
+}
 
 /* sum CURRENT priority values */
 static int
@@ -3419,17 +3998,53 @@ reset_priorities(void)
   }
 }
 
-int ruu_occ_cmp(const void *el1, const void *el2)
+/* does thread T1 sort ahead of thread T2 in ruu_occ_order[]? */
+#define RUU_OCC_BEFORE(T1, T2)                                \
+  (ruu_occ_count[T1] < ruu_occ_count[T2]                      \
+   || (ruu_occ_count[T1] == ruu_occ_count[T2] && (T1) < (T2)))
+
+/* is RUU entry RS counted in its thread's ruu_occ_count[]? */
+#define RUU_OCC_COUNTED(RS) \
+  (!(RS)->in_LSQ && (RS)->squashed != TRUE && !(RS)->issued)
+
+/* add DELTA (+1 or -1) to THREAD's RUU occupancy, and slide it into
+ * place in ruu_occ_order[].  A thread only moves past threads with its
+ * old count, so this is cheap in the common case */
+static void
+ruu_occ_adjust(int thread, int delta)
 {
-  int count1 = ((struct ruu_occ_by_thread_t *)el1)->count;
-  int count2 = ((struct ruu_occ_by_thread_t *)el2)->count;
+  int pos, other;
 
-  if (count1 > count2)
-    return 1;
-  else if (count2 > count1)
-    return -1;
+  if (!fetch_ruu_pri)
+    return;
 
-  return 0;
+  ruu_occ_count[thread] += delta;
+  dassert(ruu_occ_count[thread] >= 0);
+
+  pos = ruu_occ_pos[thread];
+  if (delta > 0)
+  {
+    while (pos + 1 < N_THREAD_RECS
+           && RUU_OCC_BEFORE(ruu_occ_order[pos + 1], thread))
+    {
+      other = ruu_occ_order[pos + 1];
+      ruu_occ_order[pos] = other;
+      ruu_occ_pos[other] = pos;
+      pos++;
+    }
+  }
+  else
+  {
+    while (pos > 0 && RUU_OCC_BEFORE(thread, ruu_occ_order[pos - 1]))
+    {
+      other = ruu_occ_order[pos - 1];
+      ruu_occ_order[pos] = other;
+      ruu_occ_pos[other] = pos;
+      pos--;
+    }
+  }
+  ruu_occ_order[pos] = thread;
+  ruu_occ_pos[thread] = pos;
 }
 
 static int next_by_ruu_thread = 0;
@@ -3445,28 +4060,30 @@ reset_priorities_by_ruu()
 
   dassert(fetch_ruu_pri);
 
-  /* initialize ruu_occ_by_thread[] */
+  /* threads that can't fetch right now count as empty, and empty
+   * threads come first, by thread id */
+  n = 0;
   for (t = 0; t < N_THREAD_RECS; t++)
-  {
-    ruu_occ_by_thread[t].thread = t;
-    ruu_occ_by_thread[t].count = 0;
-  }
+    if (thread_info[t].valid != TRUE || thread_info[t].fetchable > sim_cycle || ruu_occ_count[t] == 0)
+    {
+      ruu_occ_by_thread[n].thread = t;
+      ruu_occ_by_thread[n].count = 0;
+      n++;
+    }
 
-  /* count per-thread RUU occs */
-  for (i = RUU_head, n = 0; n < RUU_num; i = (i + 1) % RUU_size, n++)
+  /* then everyone else, in ascending order of occupancy */
+  for (i = 0; i < N_THREAD_RECS; i++)
   {
-    t = RUU[i].thread_id;
-    if (thread_info[t].valid == TRUE && thread_info[t].fetchable <= sim_cycle && RUU[i].squashed != TRUE && !RUU[i].issued)
+    t = ruu_occ_order[i];
+    if (thread_info[t].valid == TRUE && thread_info[t].fetchable <= sim_cycle && ruu_occ_count[t] != 0)
     {
-      dassert(!RUU[i].completed);
-      dassert(ruu_occ_by_thread[t].thread == t);
-      ruu_occ_by_thread[t].count++;
+      ruu_occ_by_thread[n].thread = t;
+      ruu_occ_by_thread[n].count = ruu_occ_count[t];
+      n++;
     }
   }
+  dassert(n == N_THREAD_RECS);
 
-  /* sort in ascending order */
-  qsort(ruu_occ_by_thread, N_THREAD_RECS, sizeof(struct ruu_occ_by_thread_t),
-        ruu_occ_cmp);
   next_by_ruu_thread = 0;
   saw_first_ruu_thread = 0;
 }
@@ -3699,6 +4316,11 @@ static void
 retired_inst_list_init(void)
 {
   int i;
+  BITMAP_PTR_TYPE bmaps;
+
+  bmaps = fork_hist_bmap_alloc(KEEP_N_RETIRED_INSTS);
+  for (i = 0; i < KEEP_N_RETIRED_INSTS; i++)
+    retired_inst_list[i].ruu_entry.fork_hist_bmap = bmaps + i * THREADS_BMAP_SZ;
 
   retired_inst_list[0].ruu_entry.issued_at = 0;
   retired_inst_list[0].prev = NULL;
@@ -3725,7 +4347,12 @@ static void
 add_retired_insts(struct RUU_station *rs)
 {
   struct retired_inst *item = retired_insts_tail, *ptr;
+  BITMAP_PTR_TYPE bmap = item->ruu_entry.fork_hist_bmap;
+
+  /* the copy keeps its own fork history bitmap */
   item->ruu_entry = *rs;
+  item->ruu_entry.fork_hist_bmap = bmap;
+  BITMAP_COPY(bmap, rs->fork_hist_bmap, THREADS_BMAP_SZ);
 
   /* insert at tail? */
   if (rs->issued_at <= retired_insts_tail->prev->ruu_entry.issued_at)
@@ -3880,21 +4507,13 @@ rslink_init(int nlinks) /* total number of RS_LINK available */
 }
 
 /* service all functional unit release events, this function is called
-   once per cycle, and it used to step the BUSY timers attached to each
-   functional unit in the function unit resource pool, as long as a functional
-   unit's BUSY count is > 0, it cannot be issued an operation */
+   once per cycle, and it frees the functional units whose issue latency
+   ends this cycle; as long as a functional unit is BUSY, it cannot be issued
+   an operation */
 static void
 ruu_release_fu(void)
 {
-  int i;
-
-  /* walk all resource units, decrement busy counts by one */
-  for (i = 0; i < fu_pool->num_resources; i++)
-  {
-    /* resource is released when BUSY hits zero */
-    if (fu_pool->resources[i].busy > 0)
-      fu_pool->resources[i].busy--;
-  }
+  res_release(fu_pool, sim_cycle);
 }
 
 /*
@@ -3903,48 +4522,77 @@ ruu_release_fu(void)
  * drains this queue
  */
 
-/* pending event queue, sorted from soonest to latest event (in time), NOTE:
-   RS_LINK nodes are used for the event queue list so that it need not be
-   updated during squash events */
-static struct RS_link *event_queue;
+/* pending event queue, a timing wheel: events due within the next
+   EVENTQ_WHEEL_SIZE cycles live in the bucket for (when mod
+   EVENTQ_WHEEL_SIZE), later events wait on a sorted overflow list until
+   their cycle comes up; NOTE: RS_LINK nodes are used for the event queue
+   lists so that they need not be updated during squash events */
+#define EVENTQ_WHEEL_SIZE 1024 /* must be a power of two */
+#define EVENTQ_BUCKET(WHEN) \
+  (&eventq_wheel[(WHEN) & (EVENTQ_WHEEL_SIZE - 1)])
+
+static struct RS_link *eventq_wheel[EVENTQ_WHEEL_SIZE];
+static struct RS_link *eventq_overflow;
+
+/* cycle of the bucket being drained; the wheel holds events due in
+   [eventq_now, eventq_now + EVENTQ_WHEEL_SIZE) */
+static SS_TIME_TYPE eventq_now;
+
+/* number of events (valid or squashed) on the wheel and overflow list */
+static int eventq_num;
 
 /* initialize the event queue structures */
 static void
 eventq_init(void)
 {
-  event_queue = NULL;
+  int i;
+
+  for (i = 0; i < EVENTQ_WHEEL_SIZE; i++)
+    eventq_wheel[i] = NULL;
+  eventq_overflow = NULL;
+  eventq_now = 0;
+  eventq_num = 0;
 }
 
 /* dump the contents of the event queue */
 static void
 eventq_dump(FILE *stream) /* output stream */
 {
+  int i;
   struct RS_link *ev;
 
   fprintf(stream, "** event queue state **\n");
 
-  for (ev = event_queue; ev != NULL; ev = ev->next)
+  for (i = 0; i <= EVENTQ_WHEEL_SIZE; i++)
   {
-    /* is event still valid? */
-    if (RSLINK_VALID(ev))
+    /* walk the wheel in time order, then the overflow list */
+    ev = (i < EVENTQ_WHEEL_SIZE
+              ? *EVENTQ_BUCKET(eventq_now + i)
+              : eventq_overflow);
+    for (; ev != NULL; ev = ev->next)
     {
-      struct RUU_station *rs = RSLINK_RS(ev);
+      /* is event still valid? */
+      if (RSLINK_VALID(ev))
+      {
+        struct RUU_station *rs = RSLINK_RS(ev);
 
-      fprintf(stream, "idx: %2d: @ %.0f\n",
-              rs - (rs->in_LSQ ? LSQ : RUU), (double)ev->x.when);
-      ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
-                  stream, /* !header */ FALSE);
+        fprintf(stream, "idx: %2d: @ %.0f\n",
+                rs - (rs->in_LSQ ? LSQ : RUU), (double)ev->x.when);
+        ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
+                    stream, /* !header */ FALSE);
+      }
     }
   }
 }
 
-/* insert an event for RS into the event queue, event queue is sorted from
-   earliest to latest event, event and associated side-effects will be
-   apparent at the start of cycle WHEN */
+/* insert an event for RS into the event queue, events are delivered from
+   earliest to latest, and among events for the same cycle the most recently
+   queued first; event and associated side-effects will be apparent at the
+   start of cycle WHEN */
 static void
 eventq_queue_event(struct RUU_station *rs, SS_TIME_TYPE when)
 {
-  struct RS_link *prev, *ev, *new_ev;
+  struct RS_link *prev, *ev, *new_ev, **bucket;
 
   if (rs->completed)
     panic("event completed");
@@ -3952,12 +4600,27 @@ eventq_queue_event(struct RUU_station *rs, SS_TIME_TYPE when)
   if (when <= sim_cycle)
     panic("event occurred in the past");
 
+  /* the wheel is drained up to eventq_now, an earlier WHEN would index a
+     bucket that is not serviced again for a whole turn */
+  assert(when >= eventq_now);
+
   /* get a free event record */
   RSLINK_NEW(new_ev, rs);
   new_ev->x.when = when;
+  eventq_num++;
+
+  if (when - eventq_now < EVENTQ_WHEEL_SIZE)
+  {
+    /* within the wheel's horizon, every event in the bucket is due at
+       WHEN, insert at the head */
+    bucket = EVENTQ_BUCKET(when);
+    new_ev->next = *bucket;
+    *bucket = new_ev;
+    return;
+  }
 
-  /* locate insertion point */
-  for (prev = NULL, ev = event_queue;
+  /* far-future event, locate insertion point in the overflow list */
+  for (prev = NULL, ev = eventq_overflow;
        ev && ev->x.when < when;
        prev = ev, ev = ev->next)
     ;
@@ -3971,8 +4634,8 @@ eventq_queue_event(struct RUU_station *rs, SS_TIME_TYPE when)
   else
   {
     /* insert at beginning */
-    new_ev->next = event_queue;
-    event_queue = new_ev;
+    new_ev->next = eventq_overflow;
+    eventq_overflow = new_ev;
   }
 }
 
@@ -3981,13 +4644,45 @@ eventq_queue_event(struct RUU_station *rs, SS_TIME_TYPE when)
 static struct RUU_station *
 eventq_next_event(void)
 {
-  struct RS_link *ev;
+  struct RS_link *ev, **bucket, **tail;
+
+  if (!eventq_num)
+  {
+    /* nothing pending, skip the wheel ahead */
+    eventq_now = sim_cycle + 1;
+    return NULL;
+  }
 
-  if (event_queue && event_queue->x.when <= sim_cycle)
+  while (eventq_now <= sim_cycle)
   {
-    /* unlink and return first event on priority list */
-    ev = event_queue;
-    event_queue = event_queue->next;
+    bucket = EVENTQ_BUCKET(eventq_now);
+
+    /* overflow events due now go behind the bucket's events, which were
+       all queued after them */
+    if (eventq_overflow && eventq_overflow->x.when == eventq_now)
+    {
+      for (tail = bucket; *tail; tail = &(*tail)->next)
+        ;
+      *tail = eventq_overflow;
+      for (ev = eventq_overflow;
+           ev->next && ev->next->x.when == eventq_now;
+           ev = ev->next)
+        ;
+      eventq_overflow = ev->next;
+      ev->next = NULL;
+    }
+
+    if (!*bucket)
+    {
+      /* nothing (more) due this cycle, move on to the next bucket */
+      eventq_now++;
+      continue;
+    }
+
+    /* unlink first event in the bucket */
+    ev = *bucket;
+    *bucket = ev->next;
+    eventq_num--;
 
     /* event still valid? */
     if (RSLINK_VALID(ev))
@@ -4000,20 +4695,40 @@ eventq_next_event(void)
       /* event is valid, return resv station */
       return rs;
     }
-    else
-    {
-      /* reclaim event record */
-      RSLINK_FREE(ev);
 
-      /* receiving inst was squashed, return next event */
-      return eventq_next_event();
-    }
+    /* receiving inst was squashed, reclaim event record and try the next
+       event */
+    RSLINK_FREE(ev);
   }
-  else
+
+  /* no event or no event is ready */
+  return NULL;
+}
+
+/* cycle of the earliest pending event (valid or squashed) due before
+   cycle LIMIT, in *WHEN; returns FALSE if there is none */
+static int
+eventq_next_time(SS_TIME_TYPE limit, SS_TIME_TYPE *when)
+{
+  SS_TIME_TYPE t;
+
+  if (!eventq_num)
+    return FALSE;
+
+  /* the wheel's buckets in time order, up to its horizon, then the
+     overflow list, whose events are all due later */
+  for (t = eventq_now; t < limit && t < eventq_now + EVENTQ_WHEEL_SIZE; t++)
+    if (*EVENTQ_BUCKET(t))
+    {
+      *when = t;
+      return TRUE;
+    }
+  if (eventq_overflow && eventq_overflow->x.when < limit)
   {
-    /* no event or no event is ready */
-    return NULL;
+    *when = eventq_overflow->x.when;
+    return TRUE;
   }
+  return FALSE;
 }
 
 /*
@@ -4028,120 +4743,193 @@ eventq_next_event(void)
  * updated during squash events
  */
 
-/* the ready instruction queue */
-static struct RS_link *ready_queue;
+/* a ready queue class: a binary min-heap of RS_LINK records keyed on
+   instruction sequence number (x.seq), so the oldest ready instruction of
+   the class is always at ent[0]; the links are stored by value, their
+   'next' field is unused */
+struct readyq_heap
+{
+  struct RS_link *ent; /* heap storage */
+  int num;             /* entries in use */
+  int max;             /* entries allocated */
+};
 
-/* initialize the event queue structures */
+/* a ready queue: under aggressive issue, memory, branch, and long-latency
+   operations (the HI class) issue ahead of all other operations (the LO
+   class), oldest first within each class; otherwise everything is LO and
+   issue is strictly in program order */
+struct readyq
+{
+  struct readyq_heap hi, lo;
+};
+
+/* the ready instruction queue, plus a spare that ruu_issue() swaps in while
+   it drains the current contents */
+static struct readyq readyq_bufs[2];
+static struct readyq *ready_queue;
+
+/* non-zero if RS issues ahead of program order under aggressive issue */
+#define READYQ_HI_CLASS(RS) \
+  ((RS)->in_LSQ || (SS_OP_FLAGS((RS)->op) & (F_LONGLAT | F_CTRL)))
+
+/* initialize the ready queue structures */
 static void
 readyq_init(void)
 {
-  ready_queue = NULL;
+  int i;
+
+  /* records for squashed entries stay until they are popped, so a heap can
+     hold more than one per RUU and LSQ entry; it grows when it must */
+  for (i = 0; i < 2; i++)
+  {
+    readyq_bufs[i].hi.max = readyq_bufs[i].lo.max = RUU_size + LSQ_size;
+    readyq_bufs[i].hi.ent = calloc(readyq_bufs[i].hi.max, sizeof(struct RS_link));
+    readyq_bufs[i].lo.ent = calloc(readyq_bufs[i].lo.max, sizeof(struct RS_link));
+    if (!readyq_bufs[i].hi.ent || !readyq_bufs[i].lo.ent)
+      fatal("out of virtual memory");
+    readyq_bufs[i].hi.num = readyq_bufs[i].lo.num = 0;
+  }
+  ready_queue = &readyq_bufs[0];
 }
 
-/* dump the contents of the ready queue */
+/* add LINK to heap H */
 static void
-readyq_dump(FILE *stream) /* output stream */
+readyq_heap_push(struct readyq_heap *h, struct RS_link *link)
 {
-  struct RS_link *link;
-
-  fprintf(stream, "** ready queue state **\n");
+  int i, parent;
 
-  for (link = ready_queue; link != NULL; link = link->next)
+  if (h->num >= h->max)
   {
-    /* is entry still valid? */
-    if (RSLINK_VALID(link))
-    {
-      struct RUU_station *rs = RSLINK_RS(link);
+    h->max *= 2;
+    h->ent = realloc(h->ent, h->max * sizeof(struct RS_link));
+    if (!h->ent)
+      fatal("out of virtual memory");
+  }
 
-      ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
-                  stream, /* header */ TRUE);
-    }
+  /* sift the hole up from the bottom until LINK fits */
+  for (i = h->num++; i > 0; i = parent)
+  {
+    parent = (i - 1) / 2;
+    if (h->ent[parent].x.seq < link->x.seq)
+      break;
+    h->ent[i] = h->ent[parent];
   }
+  h->ent[i] = *link;
 }
 
-/* insert ready node into the ready list using ready instruction scheduling
-   policy; currently two policies are available:
-   Aggressive: 
-   	memory and long latency operands, and branch instructions first
-        then
-   	all other instructions, oldest instructions first
-   Non-aggressive:
-   	sorted strictly by program order
-
-  Aggressive works well because branches pass through the machine quicker
-  which works to reduce branch misprediction latencies, and very long latency
-  instructions (such loads and multiplies) get priority since they are very
-  likely on the program's critical path */
+/* remove the oldest entry of heap H into LINK; H must be non-empty */
 static void
-readyq_enqueue(struct RUU_station *rs) /* RS to enqueue */
+readyq_heap_pop(struct readyq_heap *h, struct RS_link *link)
 {
-  struct RS_link *prev, *node, *new_node;
+  int i, child;
+  struct RS_link *last;
 
-  /* node is now queued */
-  if (rs->queued)
-    panic("node is already queued");
-  assert(rs->ready_time);
-  rs->queued = TRUE;
-
-  /* get a free ready list node */
-  RSLINK_NEW(new_node, rs);
-  new_node->x.seq = rs->seq;
-
-  /* 
-   * locate insertion point 
-   */
+  *link = h->ent[0];
+  last = &h->ent[--h->num];
 
-  if (aggressive_issue && (rs->in_LSQ || (SS_OP_FLAGS(rs->op) & (F_LONGLAT | F_CTRL))))
+  /* sift the hole down from the top until the last entry fits */
+  for (i = 0; (child = 2 * i + 1) < h->num; i = child)
   {
-    /* insert mem ops, br's, and long latency ops at the head of the queue 
-       * (but in program order among themselves) */
-    for (prev = NULL, node = ready_queue;
-         node && node->x.seq < rs->seq && (node->rs->in_LSQ || (SS_OP_FLAGS(node->rs->op) & (F_LONGLAT | F_CTRL)));
-         prev = node, node = node->next)
-      ;
-  }
-  else if (aggressive_issue)
-  {
-    /* find the end of the high-priority insts */
-    for (prev = NULL, node = ready_queue;
-         node && (node->rs->in_LSQ || (SS_OP_FLAGS(node->rs->op) & (F_LONGLAT | F_CTRL)));
-         prev = node, node = node->next)
-      ;
+    if (child + 1 < h->num && h->ent[child + 1].x.seq < h->ent[child].x.seq)
+      child++;
+    if (last->x.seq < h->ent[child].x.seq)
+      break;
+    h->ent[i] = h->ent[child];
   }
+  h->ent[i] = *last;
+}
+
+/* remove the next record to consider for issue from Q into LINK, returns
+   LINK, or NULL if Q is empty */
+static struct RS_link *
+readyq_pop(struct readyq *q, struct RS_link *link)
+{
+  if (q->hi.num)
+    readyq_heap_pop(&q->hi, link);
+  else if (q->lo.num)
+    readyq_heap_pop(&q->lo, link);
   else
-  {
-    prev = NULL;
-    node = ready_queue;
-  }
+    return NULL;
 
-  /* now either (1) we've found the insertion point if this is a high-
-   * priority inst, or (2) we've found the end of the high-priority insts,
-   * or (3) we're doing straight in-order enqueuing.
-   *
-   * If (1), insert the inst.  If (2) or (3), look at seq numbers to
-   * find the in-order insertion point. */
+  return link;
+}
 
-  if (!aggressive_issue || (aggressive_issue && !(rs->in_LSQ || (SS_OP_FLAGS(rs->op) & (F_LONGLAT | F_CTRL)))))
-  {
-    /* FIXME: for multi-path; this means priority is by fetch order */
-    for (;
-         node && node->x.seq < rs->seq;
-         prev = node, node = node->next)
-      ;
-  }
+/* detach the current ready queue contents for issue, and start a new,
+   empty ready queue to receive (re)enqueued instructions; returns the
+   detached queue, which must be drained with readyq_pop() */
+static struct readyq *
+readyq_take(void)
+{
+  struct readyq *q = ready_queue;
 
-  if (prev)
+  ready_queue = (q == &readyq_bufs[0]) ? &readyq_bufs[1] : &readyq_bufs[0];
+  assert(!ready_queue->hi.num && !ready_queue->lo.num);
+
+  return q;
+}
+
+/* dump the contents of the ready queue */
+static void
+readyq_dump(FILE *stream) /* output stream */
+{
+  int i;
+  struct RS_link *link;
+
+  fprintf(stream, "** ready queue state **\n");
+
+  /* NOTE: within each class, entries are listed in heap order, not
+     issue order */
+  for (i = 0; i < ready_queue->hi.num + ready_queue->lo.num; i++)
   {
-    /* insert middle or end */
-    new_node->next = prev->next;
-    prev->next = new_node;
+    link = (i < ready_queue->hi.num
+                ? &ready_queue->hi.ent[i]
+                : &ready_queue->lo.ent[i - ready_queue->hi.num]);
+
+    /* is entry still valid? */
+    if (RSLINK_VALID(link))
+    {
+      struct RUU_station *rs = RSLINK_RS(link);
+
+      ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
+                  stream, /* header */ TRUE);
+    }
   }
+}
+
+/* insert ready node into the ready list using ready instruction scheduling
+   policy; currently two policies are available:
+   Aggressive: 
+   	memory and long latency operands, and branch instructions first
+        then
+   	all other instructions, oldest instructions first
+   Non-aggressive:
+   	sorted strictly by program order
+
+  Aggressive works well because branches pass through the machine quicker
+  which works to reduce branch misprediction latencies, and very long latency
+  instructions (such loads and multiplies) get priority since they are very
+  likely on the program's critical path */
+static void
+readyq_enqueue(struct RUU_station *rs) /* RS to enqueue */
+{
+  struct RS_link new_node;
+
+  /* node is now queued */
+  if (rs->queued)
+    panic("node is already queued");
+  pipe_activity++;
+  assert(rs->ready_time);
+  rs->queued = TRUE;
+
+  /* ready queue records are never linked, so build one in place */
+  RSLINK_INIT(new_node, rs);
+  new_node.x.seq = rs->seq;
+
+  /* FIXME: for multi-path; this means priority is by fetch order */
+  if (aggressive_issue && READYQ_HI_CLASS(rs))
+    readyq_heap_push(&ready_queue->hi, &new_node);
   else
-  {
-    /* insert at beginning */
-    new_node->next = ready_queue;
-    ready_queue = new_node;
-  }
+    readyq_heap_push(&ready_queue->lo, &new_node);
 }
 
 /*
@@ -4166,59 +4954,239 @@ static struct CV_link CVLINK_NULL = {NULL, 0};
 /* size of the create vector (one entry per architected register) */
 #define CV_BMAP_SZ (BITMAP_SIZE(SS_TOTAL_REGS))
 
+/* the create vector is stored in chunks of CV_CHUNK_REGS registers, shared
+   copy-on-write between the threads and spec levels that hold the same
+   mappings, so creating a spec level or forking a thread copies only chunk
+   pointers, and memory use follows the live paths rather than the number of
+   threads times the number of spec levels */
+#define CV_CHUNK_SHIFT 3
+#define CV_CHUNK_REGS (1 << CV_CHUNK_SHIFT)
+#define CV_NUM_CHUNKS ((SS_TOTAL_REGS + CV_CHUNK_REGS - 1) / CV_CHUNK_REGS)
+
+/* a create vector chunk */
+struct cv_chunk
+{
+  struct cv_chunk *next;             /* next chunk on the free list */
+  int refs;                          /* create vectors sharing this chunk */
+  struct CV_link ent[CV_CHUNK_REGS]; /* creators */
+  /* these shadow the creators and indicate when a register was last
+     created */
+  SS_TIME_TYPE rt[CV_CHUNK_REGS];
+};
+
+/* a create vector */
+struct cv_map
+{
+  struct cv_chunk *chunk[CV_NUM_CHUNKS];
+};
+
+/* the chunk every empty create vector shares; its reference count never
+   drops to one, so it is never written */
+static struct cv_chunk cv_null_chunk;
+
+/* free create vector chunks */
+static struct cv_chunk *cv_chunk_free_list = NULL;
+
+/* a reverse create vector link: each output of an RUU station keeps a list
+   of the chunks an entry naming it was written or copied into, so that
+   writeback finds the entries to clear without looking at the create
+   vectors of every thread and spec level; the list may also hold chunks
+   whose entry was overwritten since, or that were freed, writeback checks
+   each entry still names the output */
+struct cv_ref
+{
+  struct cv_ref *next;    /* next chunk of the output, or on the free list */
+  struct cv_chunk *chunk; /* chunk that may name the output */
+};
+
+/* free reverse create vector links */
+static struct cv_ref *cv_ref_free_list = NULL;
+
+/* record that create vector chunk CH holds entry L */
+static INLINE void
+cv_ref_add(struct CV_link *l, struct cv_chunk *ch)
+{
+  struct cv_ref *ref;
+
+  if (!cv_ref_free_list)
+  {
+    cv_ref_free_list = calloc(1, sizeof(struct cv_ref));
+    if (!cv_ref_free_list)
+      fatal("out of virtual memory");
+  }
+  ref = cv_ref_free_list;
+  cv_ref_free_list = ref->next;
+
+  ref->chunk = ch;
+  ref->next = l->rs->cv_refs[l->odep_num];
+  l->rs->cv_refs[l->odep_num] = ref;
+}
+
+/* release the reverse create vector links of list *REFS */
+static INLINE void
+cv_refs_free(struct cv_ref **refs)
+{
+  struct cv_ref *ref;
+
+  while ((ref = *refs) != NULL)
+  {
+    *refs = ref->next;
+    ref->next = cv_ref_free_list;
+    cv_ref_free_list = ref;
+  }
+}
+
 /* the create vector, NOTE: speculative copy on write storage provided
    for fast recovery during wrong path execute (see spec_mode_recover() for
    details on this process */
-static struct CV_link create_vector[SS_TOTAL_REGS];
-static struct CV_link spec_create_vector[N_THREAD_RECS][N_SPEC_LEVELS][SS_TOTAL_REGS];
+static struct cv_map create_vector;
+static struct cv_map **spec_create_vector; /* [thr][lev] */
+
+/* drop a reference to chunk CH */
+#define CV_CHUNK_RELEASE(CH)                       \
+  do                                               \
+  {                                                \
+    if (--(CH)->refs == 0)                         \
+    {                                              \
+      (CH)->next = cv_chunk_free_list;             \
+      cv_chunk_free_list = (CH);                   \
+    }                                              \
+  } while (0)
+
+/* make create vector MAP empty, all registers are read from the architected
+   register file */
+static void
+cv_map_clear(struct cv_map *map)
+{
+  int c;
 
-/* these arrays shadow the create vector and indicate when a register was
-   last created */
-static SS_TIME_TYPE create_vector_rt[SS_TOTAL_REGS];
-static SS_TIME_TYPE spec_create_vector_rt[N_THREAD_RECS][N_SPEC_LEVELS][SS_TOTAL_REGS];
+  for (c = 0; c < CV_NUM_CHUNKS; c++)
+  {
+    if (map->chunk[c] == &cv_null_chunk)
+      continue;
+    if (map->chunk[c])
+      CV_CHUNK_RELEASE(map->chunk[c]);
+    map->chunk[c] = &cv_null_chunk;
+    cv_null_chunk.refs++;
+  }
+}
+
+/* make create vector DST a copy of SRC, sharing its chunks */
+static void
+cv_map_copy(struct cv_map *dst, struct cv_map *src)
+{
+  int c;
+
+  for (c = 0; c < CV_NUM_CHUNKS; c++)
+  {
+    if (dst->chunk[c] == src->chunk[c])
+      continue;
+    src->chunk[c]->refs++;
+    CV_CHUNK_RELEASE(dst->chunk[c]);
+    dst->chunk[c] = src->chunk[c];
+  }
+}
+
+/* return the chunk of create vector MAP holding register N, copying it
+   first if it is shared */
+static INLINE struct cv_chunk *
+cv_map_own(struct cv_map *map, int n)
+{
+  struct cv_chunk *ch = map->chunk[n >> CV_CHUNK_SHIFT], *newch;
+  int i;
+
+  if (ch->refs == 1)
+    return ch;
+
+  /* shared, copy it; try to get a chunk from the free list, if avail */
+  if (!cv_chunk_free_list)
+  {
+    /* otherwise, call calloc() to get more storage */
+    cv_chunk_free_list = calloc(1, sizeof(struct cv_chunk));
+    if (!cv_chunk_free_list)
+      fatal("out of virtual memory");
+  }
+  newch = cv_chunk_free_list;
+  cv_chunk_free_list = newch->next;
+
+  memcpy(newch->ent, ch->ent, sizeof(newch->ent));
+  memcpy(newch->rt, ch->rt, sizeof(newch->rt));
+  for (i = 0; i < CV_CHUNK_REGS; i++)
+    if (newch->ent[i].rs)
+      cv_ref_add(&newch->ent[i], newch);
+  newch->refs = 1;
+  ch->refs--;
+  map->chunk[n >> CV_CHUNK_SHIFT] = newch;
+  return newch;
+}
+
+/* register N's entry in create vector MAP */
+#define CV_MAP_ENT(MAP, N) \
+  ((MAP)->chunk[(N) >> CV_CHUNK_SHIFT]->ent[(N) & (CV_CHUNK_REGS - 1)])
+
+/* register N's timestamp in create vector MAP */
+#define CV_MAP_RT(MAP, N) \
+  ((MAP)->chunk[(N) >> CV_CHUNK_SHIFT]->rt[(N) & (CV_CHUNK_REGS - 1)])
 
 /* read a create vector entry */
-#define CREATE_VECTOR(N, THREAD)                   \
-  (spec_level                                      \
-       ? spec_create_vector[THREAD][spec_level][N] \
-       : create_vector[N])
+#define CREATE_VECTOR(N, THREAD)                              \
+  (spec_level                                                 \
+       ? CV_MAP_ENT(&spec_create_vector[THREAD][spec_level], N) \
+       : CV_MAP_ENT(&create_vector, N))
 
 /* read a create vector timestamp entry */
-#define CREATE_VECTOR_RT(N, THREAD)                   \
-  (spec_level                                         \
-       ? spec_create_vector_rt[THREAD][spec_level][N] \
-       : create_vector_rt[N])
+#define CREATE_VECTOR_RT(N, THREAD)                          \
+  (spec_level                                                \
+       ? CV_MAP_RT(&spec_create_vector[THREAD][spec_level], N) \
+       : CV_MAP_RT(&create_vector, N))
+
+/* set register N's entry in create vector MAP to creator L */
+static INLINE void
+cv_map_set(struct cv_map *map, int n, struct CV_link l)
+{
+  struct cv_chunk *ch = cv_map_own(map, n);
+
+  ch->ent[n & (CV_CHUNK_REGS - 1)] = l;
+  if (l.rs)
+    cv_ref_add(&ch->ent[n & (CV_CHUNK_REGS - 1)], ch);
+}
 
 /* set a create vector entry */
-#define SET_CREATE_VECTOR(N, L, THREAD)                  \
-  ((thread_info[THREAD].spec_mode == TRUE)               \
-       ? spec_create_vector[THREAD][spec_level][N] = (L) \
-       : (create_vector[N] = (L)))
+#define SET_CREATE_VECTOR(N, L, THREAD)                     \
+  cv_map_set((thread_info[THREAD].spec_mode == TRUE)        \
+                 ? &spec_create_vector[THREAD][spec_level] \
+                 : &create_vector,                          \
+             (N), (L))
 
 /* initialize the create vector */
 static void
 cv_init(void)
 {
-  int i, t, s;
+  int t, s;
 
-  /* Note: static decl's should already initialize everything to 0... */
+  /* the shared empty chunk: initially all registers are valid in the
+     architected register file, i.e., the create vector entry is
+     CVLINK_NULL */
+  cv_null_chunk.refs = 1;
 
-  /* initially all registers are valid in the architected register file,
-     i.e., the create vector entry is CVLINK_NULL */
-  for (i = 0; i < SS_TOTAL_REGS; i++)
-  {
-    create_vector[i] = CVLINK_NULL;
-    dEval(create_vector_rt[i] = 0);
-  }
+  cv_map_clear(&create_vector);
 
-  /* initially all spec_create info is empty */
+  /* allocate the per-thread speculative create vectors; spec levels count
+   * from 1, so each thread gets N_SPEC_LEVELS + 1 of them */
+  spec_create_vector = calloc(N_THREAD_RECS, sizeof(*spec_create_vector));
+  if (!spec_create_vector)
+    fatal("out of virtual memory");
   for (t = 0; t < N_THREAD_RECS; t++)
-    for (s = 0; s < N_SPEC_LEVELS; s++)
-      for (i = 0; i < SS_TOTAL_REGS; i++)
-      {
-        spec_create_vector[t][s][i] = CVLINK_NULL;
-        dEval(spec_create_vector_rt[t][s][i] = 0);
-      }
+  {
+    spec_create_vector[t] = calloc(N_SPEC_LEVELS + 1,
+                                   sizeof(**spec_create_vector));
+    if (!spec_create_vector[t])
+      fatal("out of virtual memory");
+
+    /* initially all spec_create info is empty */
+    for (s = 0; s <= N_SPEC_LEVELS; s++)
+      cv_map_clear(&spec_create_vector[t][s]);
+  }
 }
 
 /* dependency index names */
@@ -4265,6 +5233,139 @@ cv_dump(FILE *stream) /* output stream; thread no. */
   }
 }
 
+/*
+ * LSQ memory disambiguation, incremental: lsq_refresh() keeps track of how
+ * far into the LSQ the store addresses are known (lsq_checked), hashes the
+ * stores up to there on their address, and parks each load whose address
+ * matches an earlier store with unknown data on that store; so a load is
+ * looked at when it is first checked, when its address becomes ready, and
+ * when the store it waits for gets its data or goes away, rather than on
+ * every cycle
+ */
+
+/* add checked store RS to the store address hash */
+static void
+lsq_hash_store(struct RUU_station *rs)
+{
+  struct RUU_station **bucket = LSQ_ADDR_HASH(rs->addr);
+
+  rs->addr_hashed = TRUE;
+  rs->addr_prev = NULL;
+  rs->addr_next = *bucket;
+  if (*bucket)
+    (*bucket)->addr_prev = rs;
+  *bucket = rs;
+}
+
+/* the youngest store to ADDR in the store address hash that is older than
+   the LSQ entry at position POS, NULL if none */
+static struct RUU_station *
+lsq_youngest_store(SS_ADDR_TYPE addr, int pos)
+{
+  struct RUU_station *st, *youngest = NULL;
+  int st_pos, youngest_pos = -1;
+
+  for (st = *LSQ_ADDR_HASH(addr); st; st = st->addr_next)
+  {
+    if (st->addr != addr)
+      continue;
+    st_pos = LSQ_POS(st);
+    if (st_pos < pos && st_pos > youngest_pos)
+    {
+      youngest = st;
+      youngest_pos = st_pos;
+    }
+  }
+  return youngest;
+}
+
+/* take LSQ entry RS off the list it is on, if any */
+static void
+lsq_list_remove(struct RUU_station *rs)
+{
+  if (!rs->lsq_list)
+    return;
+  if (rs->lsq_prev)
+    rs->lsq_prev->lsq_next = rs->lsq_next;
+  else
+    *rs->lsq_list = rs->lsq_next;
+  if (rs->lsq_next)
+    rs->lsq_next->lsq_prev = rs->lsq_prev;
+  rs->lsq_list = NULL;
+}
+
+/* move LSQ entry RS to the front of list HEAD */
+static void
+lsq_list_add(struct RUU_station *rs, struct RUU_station **head)
+{
+  lsq_list_remove(rs);
+  rs->lsq_prev = NULL;
+  rs->lsq_next = *head;
+  if (*head)
+    (*head)->lsq_prev = rs;
+  *head = rs;
+  rs->lsq_list = head;
+}
+
+/* have the loads waiting for store RS looked at again */
+static void
+lsq_wake_waiters(struct RUU_station *rs)
+{
+  while (rs->lsq_waiters)
+    lsq_list_add(rs->lsq_waiters, &lsq_touched);
+}
+
+/* LSQ entry RS leaves the LSQ, or is squashed: drop it from the store
+   address hash, and have the loads waiting for it looked at again */
+static void
+lsq_leave(struct RUU_station *rs)
+{
+  if (rs->addr_hashed)
+  {
+    if (rs->addr_prev)
+      rs->addr_prev->addr_next = rs->addr_next;
+    else
+      *LSQ_ADDR_HASH(rs->addr) = rs->addr_next;
+    if (rs->addr_next)
+      rs->addr_next->addr_prev = rs->addr_prev;
+    rs->addr_hashed = FALSE;
+  }
+  lsq_wake_waiters(rs);
+  lsq_list_remove(rs);
+}
+
+/* an operand of LSQ entry RS became ready, have lsq_refresh() look at it */
+static void
+lsq_touch(struct RUU_station *rs)
+{
+  if (rs->lsq_list != &lsq_touched)
+    lsq_list_add(rs, &lsq_touched);
+}
+
+/* queue checked load RS if its memory dependences are satisfied: no earlier
+   store to its address, or the youngest such store has its data; else
+   park it on that store */
+static void
+lsq_try_load(struct RUU_station *rs)
+{
+  struct RUU_station *st;
+
+  if (/* ignore squashed entries */ rs->squashed || /* !queued? */ rs->queued || /* !waiting? */ rs->issued || /* !completed? */ rs->completed || /* regs ready? */ !OPERANDS_READY(rs))
+    return;
+
+  st = lsq_youngest_store(rs->addr, LSQ_POS(rs));
+  if (st && !OPERANDS_READY(st))
+  {
+    /* STD unknown conflict, wait for the store data */
+    lsq_list_add(rs, &st->lsq_waiters);
+    return;
+  }
+
+  /* no STA or STD unknown conflicts, put load on ready queue */
+  rs->ready_time = sim_cycle;
+  readyq_enqueue(rs);
+}
+
 /*
  *  RUU_COMMIT() - instruction retirement pipeline stage
  */
@@ -4332,7 +5433,7 @@ ruu_commit(void)
 
           /* schedule functional unit release event */
           if (!infinite_fu)
-            fu->master->busy = fu->issuelat;
+            res_hold(fu_pool, fu->master, fu->issuelat);
 
           /* go to the data cache */
           if (cache_dl1)
@@ -4385,6 +5486,7 @@ ruu_commit(void)
       }
 
       /* invalidate load/store operation instance */
+      lsq_leave(&LSQ[LSQ_head]);
       LSQ[LSQ_head].tag++;
 
       /* indicate to pipeline trace that this instruction retired */
@@ -4402,6 +5504,8 @@ ruu_commit(void)
       /* commit head of LSQ as well */
       LSQ_head = (LSQ_head + 1) % LSQ_size;
       LSQ_num--;
+      if (lsq_checked > 0)
+        lsq_checked--;
     }
 
     /* if we non-speculatively update branch-predictor, do it here */
@@ -4481,6 +5585,7 @@ ruu_commit(void)
         panic("retired instruction has odeps\n");
     }
   }
+  pipe_activity += committed;
 
   if (report_commit && done_priming)
     stat_add_sample(commit_dist, committed - discarded);
@@ -4558,24 +5663,44 @@ hydra_bpred_recover(int curr_thread,                        /* thread-id of reco
 }
 
 /* recover processor microarchitecture state back to point of the
-   mis-predicted branch at RUU[BRANCH_INDEX] */
+   mis-predicted branch at RUU[BRANCH_INDEX]; the instructions squashed are
+   those younger than the branch of the threads thread_cleanup() squashed */
 static void
 ruu_recover(int branch_index) /* index of mis-pred branch */
 {
-  int i, RUU_index, LSQ_index;
+  int i, k, n, t, RUU_index, LSQ_index;
   int RUU_prev_tail = RUU_tail, LSQ_prev_tail = LSQ_tail;
+  INST_SEQ_TYPE branch_seq = RUU[branch_index].seq;
+  struct recover_cursor *c;
+
+  /* squash from the youngest instruction towards the branch, as they were
+     dispatched, so that side effects (pipetrace, FU release, ...) happen
+     in the same order as a walk of the RUU from its tail would; rather
+     than walk the RUU, and the instructions of threads squashed earlier
+     still in it, merge the chains of RUU entries of the squashed threads,
+     keeping a cursor for each at its youngest entry not yet squashed */
+  for (t = 0, n = 0; t < N_THREAD_RECS; t++)
+  {
+    if (thread_info[t].squash_epoch == squash_epoch
+        && thread_info[t].ruu_youngest_seq > branch_seq
+        && RUU[thread_info[t].ruu_youngest].seq == thread_info[t].ruu_youngest_seq)
+    {
+      recover_cursors[n].thread = t;
+      recover_cursors[n].index = thread_info[t].ruu_youngest;
+      recover_cursors[n].seq = thread_info[t].ruu_youngest_seq;
+      n++;
+    }
+  }
 
-  /* recover from the tail of the RUU towards the head until the branch index
-     is reached, this direction ensures that the LSQ can be synchronized with
-     the RUU */
-
-  /* go to first element to squash */
-  RUU_index = (RUU_tail + (RUU_size - 1)) % RUU_size;
-  LSQ_index = (LSQ_tail + (LSQ_size - 1)) % LSQ_size;
-
-  /* traverse to older insts until the mispredicted branch is encountered */
-  while (RUU_index != branch_index)
+  while (n > 0)
   {
+    /* the youngest instruction left to squash */
+    for (i = 1, k = 0; i < n; i++)
+      if (recover_cursors[i].seq > recover_cursors[k].seq)
+        k = i;
+    c = &recover_cursors[k];
+    RUU_index = c->index;
+
     /* the RUU should not drain since the mispredicted branch will remain */
     if (!RUU_num)
       panic("empty RUU");
@@ -4587,95 +5712,108 @@ ruu_recover(int branch_index) /* index of mis-pred branch */
     /* is this operation an effective addr calc for a load or store? */
     if (RUU[RUU_index].ea_comp)
     {
+      LSQ_index = RUU[RUU_index].lsq_index;
+
       /* should be at least one load or store in the LSQ */
-      if (!LSQ_num)
+      if (!LSQ_num || LSQ[LSQ_index].seq != RUU[RUU_index].seq + 1)
         panic("RUU and LSQ out of sync");
 
-      if (LSQ[LSQ_index].squashable)
-      {
-        /* Deallocate the space the might have been allocated for
-		 misspeculated memory accesses */
-        MEM_ACCESS_SQUASH(LSQ[LSQ_index].addr);
+      /* Deallocate the space the might have been allocated for
+         misspeculated memory accesses */
+      MEM_ACCESS_SQUASH(LSQ[LSQ_index].addr);
 
-        /* recover any resources consumed by the memory operation */
-        for (i = 0; i < MAX_ODEPS; i++)
-        {
-          RSLINK_FREE_LIST(LSQ[LSQ_index].odep_list[i]);
-          /* blow away the consuming op list */
-          LSQ[LSQ_index].odep_list[i] = NULL;
-        }
+      /* recover any resources consumed by the memory operation */
+      for (i = 0; i < MAX_ODEPS; i++)
+      {
+        RSLINK_FREE_LIST(LSQ[LSQ_index].odep_list[i]);
+        /* blow away the consuming op list */
+        LSQ[LSQ_index].odep_list[i] = NULL;
+      }
 
-        /* remove from IQ if appropriate */
-        if (LSQ[LSQ_index].decoded)
-          IIQ_occ--;
+      /* remove from IQ if appropriate */
+      if (LSQ[LSQ_index].decoded)
+        IIQ_occ--;
 
-        /* squash this LSQ entry */
-        LSQ[LSQ_index].tag++;
-        LSQ[LSQ_index].squashed = TRUE;
-        LSQ[LSQ_index].completed = TRUE;
+      /* squash this LSQ entry */
+      lsq_leave(&LSQ[LSQ_index]);
+      LSQ[LSQ_index].tag++;
+      LSQ[LSQ_index].squashed = TRUE;
+      LSQ[LSQ_index].completed = TRUE;
 
-        /* indicate in pipetrace that this instruction was squashed */
-        if (ptrace_level != PTRACE_FUNSIM)
-          ptrace_endinst(LSQ[LSQ_index].ptrace_seq,
-                         LSQ[LSQ_index].thread_id);
+      /* indicate in pipetrace that this instruction was squashed */
+      if (ptrace_level != PTRACE_FUNSIM)
+        ptrace_endinst(LSQ[LSQ_index].ptrace_seq,
+                       LSQ[LSQ_index].thread_id);
 
-        if (squash_remove)
-          LSQ_num--;
-      }
+      if (squash_remove)
+        LSQ_num--;
 
-      /* go to next earlier LSQ slot */
+      /* the earliest LSQ slot squashed so far */
       LSQ_prev_tail = LSQ_index;
-      LSQ_index = (LSQ_index + (LSQ_size - 1)) % LSQ_size;
     }
 
-    if (RUU[RUU_index].squashable)
+    /* recover any resources used by this RUU operation */
+    if (pred->retstack.patch_level == RETSTACK_PATCH_WHOLE && RUU[RUU_index].bpred_recover_rec.contents.stack_copy)
     {
-      /* recover any resources used by this RUU operation */
-      if (pred->retstack.patch_level == RETSTACK_PATCH_WHOLE && RUU[RUU_index].bpred_recover_rec.contents.stack_copy)
-      {
-        free(RUU[RUU_index].bpred_recover_rec.contents.stack_copy);
-        RUU[RUU_index].bpred_recover_rec.contents.stack_copy = NULL;
-      }
-      for (i = 0; i < MAX_ODEPS; i++)
-      {
-        RSLINK_FREE_LIST(RUU[RUU_index].odep_list[i]);
-        /* blow away the consuming op list */
-        RUU[RUU_index].odep_list[i] = NULL;
-      }
+      free(RUU[RUU_index].bpred_recover_rec.contents.stack_copy);
+      RUU[RUU_index].bpred_recover_rec.contents.stack_copy = NULL;
+    }
+    for (i = 0; i < MAX_ODEPS; i++)
+    {
+      RSLINK_FREE_LIST(RUU[RUU_index].odep_list[i]);
+      /* blow away the consuming op list */
+      RUU[RUU_index].odep_list[i] = NULL;
+    }
 
-      /* remove from IQ if appropriate */
-      if (RUU[RUU_index].decoded)
-      {
-        if (SS_OP_FLAGS(RUU[RUU_index].op) & F_FCOMP)
-          FIQ_occ--;
-        else
-          IIQ_occ--;
-      }
+    /* remove from IQ if appropriate */
+    if (RUU[RUU_index].decoded)
+    {
+      if (SS_OP_FLAGS(RUU[RUU_index].op) & F_FCOMP)
+        FIQ_occ--;
+      else
+        IIQ_occ--;
+    }
 
-      /* reset the func. unit used by this instr -- if fu is occupied,
-	   * it will be free for the NEXT cycle.  This simple mechanism
-	   * works because we know all later insts that might use this
-	   * fu get squashed, too. */
-      if (RUU[RUU_index].fu && (RUU[RUU_index].fu->master->busy != 0))
-        RUU[RUU_index].fu->master->busy = 1;
+    /* reset the func. unit used by this instr -- if fu is occupied,
+     * it will be free for the NEXT cycle.  This simple mechanism
+     * works because we know all later insts that might use this
+     * fu get squashed, too. */
+    if (RUU[RUU_index].fu && (RUU[RUU_index].fu->master->busy != 0))
+      res_hold(fu_pool, RUU[RUU_index].fu->master, 1);
+
+    /* squash this RUU entry */
+    if (RUU_OCC_COUNTED(&RUU[RUU_index]))
+      ruu_occ_adjust(RUU[RUU_index].thread_id, -1);
+    RUU[RUU_index].tag++;
+    RUU[RUU_index].squashed = TRUE;
+    RUU[RUU_index].completed = TRUE;
+
+    /* indicate in pipetrace that this instruction was squashed */
+    if (ptrace_level != PTRACE_FUNSIM)
+      ptrace_endinst(RUU[RUU_index].ptrace_seq,
+                     RUU[RUU_index].thread_id);
 
-      /* squash this RUU entry */
-      RUU[RUU_index].tag++;
-      RUU[RUU_index].squashed = TRUE;
-      RUU[RUU_index].completed = TRUE;
+    if (squash_remove)
+      RUU_num--;
 
-      /* indicate in pipetrace that this instruction was squashed */
-      if (ptrace_level != PTRACE_FUNSIM)
-        ptrace_endinst(RUU[RUU_index].ptrace_seq,
-                       RUU[RUU_index].thread_id);
+    /* the earliest RUU slot squashed so far */
+    RUU_prev_tail = RUU_index;
 
+    /* go to the next older instruction of the thread, if it is still in
+     * the RUU and younger than the branch */
+    c->index = RUU[RUU_index].thread_prev;
+    c->seq = RUU[RUU_index].thread_prev_seq;
+    if (c->seq <= branch_seq || RUU[c->index].seq != c->seq)
+    {
+      /* squashed instructions stay in the RUU, and on their thread's
+       * chain, unless they are removed */
       if (squash_remove)
-        RUU_num--;
+      {
+        thread_info[c->thread].ruu_youngest = c->index;
+        thread_info[c->thread].ruu_youngest_seq = c->seq;
+      }
+      recover_cursors[k] = recover_cursors[--n];
     }
-
-    /* go to next earlier slot in the RUU */
-    RUU_prev_tail = RUU_index;
-    RUU_index = (RUU_index + (RUU_size - 1)) % RUU_size;
   }
 
   /* if we removed RUU/LSQ entries, reset head/tail pointers to point to 
@@ -4684,6 +5822,7 @@ ruu_recover(int branch_index) /* index of mis-pred branch */
   {
     RUU_tail = RUU_prev_tail;
     LSQ_tail = LSQ_prev_tail;
+    lsq_checked = MIN(lsq_checked, LSQ_num);
   }
 }
 
@@ -4732,7 +5871,7 @@ static void post_thread_cleanup(struct RUU_station *rs_branch);
 static void
 ruu_writeback(void)
 {
-  int i, s, t, n, curr, num_pending_branches = 0;
+  int i, n, curr, num_pending_branches = 0;
   struct RUU_station *rs;
   int new_token_holder = -1;
 #ifdef DEBUG_PRED_PRI
@@ -4757,6 +5896,8 @@ ruu_writeback(void)
   /* service all completed events */
   while ((rs = eventq_next_event()))
   {
+    pipe_activity++;
+
     /* RS has completed execution and (possibly) produced a result */
     if (!OPERANDS_READY(rs) || rs->queued || !rs->issued || rs->completed)
       panic("inst completed and !ready, !issued, or completed");
@@ -4964,53 +6105,30 @@ ruu_writeback(void)
     {
       if (rs->onames[i] != NA && !rs->squashed)
       {
-        struct CV_link link;
+        struct cv_chunk *ch;
+        struct cv_ref *ref;
+        int n = rs->onames[i] & (CV_CHUNK_REGS - 1);
         struct RS_link *olink, *olink_next;
 
-        /* update all threads' spec-create-vectors if they still see 
-	       * this inst as last writer; future operations get value from 
-	       * architected reg file or later creator */
-        for (t = 0; t < N_THREAD_RECS; t++)
-        {
-          /* FIXME: I think this loop is a big efficiency problem */
-
-          int thread_max_spec_level;
-
-          if (thread_info[t].valid == FALSE)
-            continue;
-
-          thread_max_spec_level = thread_info[t].spec_level;
-          for (s = 0; s <= thread_max_spec_level; s++)
-          {
-            link = spec_create_vector[t][s][rs->onames[i]];
-
-            if (/* !NULL */ link.rs && /* refs RS */ (link.rs == rs && link.odep_num == i))
-            {
-              assert(s >= rs->spec_level);
-              /* the result can now be read from a physical 
-			 * register; indicate this as so */
-              spec_create_vector[t][s][rs->onames[i]] = CVLINK_NULL;
-              spec_create_vector_rt[t][s][rs->onames[i]] = sim_cycle;
-            }
-            /* else, creator invalidated or there's another creator*/
-          }
-        }
-        if (rs->spec_mode == FALSE)
+        /* update all create vectors that still see this inst as last
+	       * writer; future operations get value from architected reg
+	       * file or later creator; create vectors that share a chunk
+	       * hold the same entry, so it is updated for all of them in
+	       * place, and the chunks holding one are those on the output's
+	       * reverse links */
+        for (ref = rs->cv_refs[i]; ref; ref = ref->next)
         {
-          /* also update the non-speculative create vector; future
-		     operations get value from later creator or architected
-		     reg file */
-          dassert(rs->spec_level == 0);
-          link = create_vector[rs->onames[i]];
-          if (/* !NULL */ link.rs && /* refs RS */ (link.rs == rs && link.odep_num == i))
+          ch = ref->chunk;
+          if (/* refs RS */ ch->ent[n].rs == rs && ch->ent[n].odep_num == i)
           {
             /* the result can now be read from a physical register,
-			 indicate this as so */
-            create_vector[rs->onames[i]] = CVLINK_NULL;
-            create_vector_rt[rs->onames[i]] = sim_cycle;
+		     * indicate this as so */
+            ch->ent[n] = CVLINK_NULL;
+            ch->rt[n] = sim_cycle;
           }
-          /* else, creator invalidated or there is another creator */
+          /* else, creator invalidated or there's another creator */
         }
+        cv_refs_free(&rs->cv_refs[i]);
 
         /* walk output list, queue up ready operations */
         for (olink = rs->odep_list[i]; olink; olink = olink_next)
@@ -5022,6 +6140,8 @@ ruu_writeback(void)
 
             /* input is now ready */
             olink->rs->idep_ready[olink->x.opnum] = TRUE;
+            if (olink->rs->in_LSQ)
+              lsq_touch(olink->rs);
 
             /* are all the register operands of target ready? */
             if (OPERANDS_READY(olink->rs))
@@ -5055,83 +6175,63 @@ ruu_writeback(void)
  */
 
 /* this function locates ready instructions whose memory dependencies have
-   been satisfied, this is accomplished by walking the LSQ for loads, looking
-   for blocking memory dependency condition (e.g., earlier store with an
-   unknown address) */
-#ifdef HUGE_CFG
-#define MAX_STD_UNKNOWNS 16384
-#elif PLUS_CFG
-#define MAX_STD_UNKNOWNS 8192
-#elif INF_RUU
-#define MAX_STD_UNKNOWNS 32768
-#else
-#define MAX_STD_UNKNOWNS 8192
-#endif
+   been satisfied: a load may go once no earlier store has an unknown
+   address (STA unknown), and the youngest earlier store to its address,
+   if any, has its data (STD unknown); a later STD known hides an earlier
+   STD unknown.  Only what changed since the last call is looked at: the
+   loads and stores whose operands became ready, the loads waiting on a
+   store that got its data or went away, and the LSQ entries after the
+   last store with an unknown address, up to the next one */
 static void
 lsq_refresh(void)
 {
-  int i, j, index, n_std_unknowns;
-  SS_ADDR_TYPE std_unknowns[MAX_STD_UNKNOWNS];
+  struct RUU_station *rs;
+
+  /* loads and stores with new operands, and loads whose stores changed;
+     a store that just got its data wakes its waiting loads onto this
+     list as well */
+  while ((rs = lsq_touched))
+  {
+    lsq_list_remove(rs);
+    if (!rs->squashed && LSQ_POS(rs) < lsq_checked)
+    {
+      if ((SS_OP_FLAGS(rs->op) & (F_MEM | F_STORE)) == (F_MEM | F_STORE))
+      {
+        if (OPERANDS_READY(rs))
+          lsq_wake_waiters(rs);
+      }
+      else if (SS_OP_FLAGS(rs->op) & F_LOAD)
+        lsq_try_load(rs);
+    }
+  }
 
-  /* scan entire queue for ready loads: scan from oldest instruction
-     (head) until we reach the tail or an unresolved store, after which no
-     other instruction will become ready */
-  for (i = 0, index = LSQ_head, n_std_unknowns = 0;
-       i < LSQ_num;
-       i++, index = (index + 1) % LSQ_size)
+  /* check the entries after the last known store address, until the next
+     unknown one */
+  while (lsq_checked < LSQ_num)
   {
+    rs = &LSQ[(LSQ_head + lsq_checked) % LSQ_size];
+
     /* ignore squashed entries */
-    if (LSQ[index].squashed)
+    if (rs->squashed)
+    {
+      lsq_checked++;
       continue;
+    }
 
-    /* terminate search for ready loads after first unresolved store,
-	 as no later load could be resolved in its presence */
     if (/* store? */
-        (SS_OP_FLAGS(LSQ[index].op) & (F_MEM | F_STORE)) == (F_MEM | F_STORE))
+        (SS_OP_FLAGS(rs->op) & (F_MEM | F_STORE)) == (F_MEM | F_STORE))
     {
-      if (!STORE_ADDR_READY(&LSQ[index]))
-      {
-        /* FIXME: a later STD + STD known could hide the STA unknown */
-        /* sta unknown, blocks all later loads, stop search */
+      /* sta unknown, blocks all later loads, stop search */
+      if (!STORE_ADDR_READY(rs))
         break;
-      }
-      else if (!OPERANDS_READY(&LSQ[index]))
-      {
-        /* sta known, but std unknown, may block a later store, record
-		 this address for later referral, we use an array here because
-		 for most simulations the number of entries to search will be
-		 very small */
-        if (n_std_unknowns == MAX_STD_UNKNOWNS)
-          fatal("STD unknown array overflow, increase MAX_STD_UNKNOWNS");
-        std_unknowns[n_std_unknowns++] = LSQ[index].addr;
-      }
-      else /* STORE_ADDR_READY() && OPERANDS_READY() */
-      {
-        /* a later STD known hides an earlier STD unknown */
-        for (j = 0; j < n_std_unknowns; j++)
-        {
-          if (std_unknowns[j] == /* STA/STD known */ LSQ[index].addr)
-            std_unknowns[j] = /* bogus addr */ 0;
-        }
-      }
+      lsq_hash_store(rs);
+      lsq_checked++;
     }
-
-    if (/* load? */ (SS_OP_FLAGS(LSQ[index].op) & F_LOAD) && /* !queued? */ !LSQ[index].queued && /* !waiting? */ !LSQ[index].issued && /* !completed? */ !LSQ[index].completed && /* regs ready? */ OPERANDS_READY(&LSQ[index]))
+    else
     {
-      /* no STA unknown conflict (because we got to this check), check for
-	     a STD unknown conflict */
-      for (j = 0; j < n_std_unknowns; j++)
-      {
-        /* found a relevant STD unknown? */
-        if (std_unknowns[j] == LSQ[index].addr)
-          break;
-      }
-      if (j == n_std_unknowns)
-      {
-        /* no STA or STD unknown conflicts, put load on ready queue */
-        LSQ[index].ready_time = sim_cycle;
-        readyq_enqueue(&LSQ[index]);
-      }
+      lsq_checked++;
+      if (/* load? */ SS_OP_FLAGS(rs->op) & F_LOAD)
+        lsq_try_load(rs);
     }
   }
 }
@@ -5154,7 +6254,8 @@ ruu_issue(void)
 {
   int i, curr, load_lat, tlb_lat, oplat = -1;
   int n_issued, n_issued_useful, n_int_issued, n_fp_issued;
-  struct RS_link *node, *next_node;
+  struct readyq *issue_q;
+  struct RS_link link, *node;
   struct RUU_station *rs;
   struct res_template *fu;
   int num_post_issue = 0, num_post_issue_useful = 0,
@@ -5195,24 +6296,19 @@ ruu_issue(void)
   if (report_ruu_occ && done_priming)
     stat_add_sample(ruu_occ_dist, RUU_num);
 
-  /* FIXME: could be a little more efficient when scanning the ready queue */
-
-  /* copy and then blow away the ready list, NOTE: the ready list is
+  /* take and then blow away the ready queue, NOTE: the ready queue is
      always totally reclaimed each cycle, and instructions that are not
      issue are explicitly reinserted into the ready instruction queue,
-     this management strategy ensures that the ready instruction queue
-     is always properly sorted */
-  node = ready_queue;
-  ready_queue = NULL;
+     this management strategy ensures that an instruction is considered
+     at most once per cycle */
+  issue_q = readyq_take();
 
   /* visit all ready instructions (i.e., insts whose register input
      dependencies have been satisfied, stop issue when no more instructions
      are available or issue bandwidth is exhausted */
   for (n_issued = 0, n_issued_useful = 0, n_int_issued = 0, n_fp_issued = 0;
-       node && n_issued < ruu_issue_width && n_int_issued < ruu_int_issue_width && n_fp_issued < ruu_fp_issue_width;
-       node = next_node)
+       n_issued < ruu_issue_width && n_int_issued < ruu_int_issue_width && n_fp_issued < ruu_fp_issue_width && (node = readyq_pop(issue_q, &link));)
   {
-    next_node = node->next;
     rs = RSLINK_RS(node);
 
     /* still valid? */
@@ -5286,6 +6382,8 @@ ruu_issue(void)
             /* got one! issue inst to functional unit */
             rs->decoded = FALSE;
             rs->issued = TRUE;
+            if (!rs->in_LSQ)
+              ruu_occ_adjust(rs->thread_id, -1);
             rs->issued_at = sim_cycle;
 
             /* reserve the functional unit */
@@ -5294,7 +6392,7 @@ ruu_issue(void)
 
             /* schedule functional unit release event */
             if (!infinite_fu)
-              fu->master->busy = fu->issuelat;
+              res_hold(fu_pool, fu->master, fu->issuelat);
 
             /* We issued an inst */
             n_issued++;
@@ -5320,26 +6418,14 @@ ruu_issue(void)
 			     first scan LSQ to see if a store forward is
 			     possible, if not, access the data cache */
               load_lat = 0;
-              i = (rs - LSQ);
-              if (i != LSQ_head)
-              {
-                for (;;)
-                {
-                  /* go to next earlier LSQ entry */
-                  i = (i + (LSQ_size - 1)) % LSQ_size;
-
-                  /* FIXME: not dealing with partials! */
-                  if ((SS_OP_FLAGS(LSQ[i].op) & F_STORE) && (LSQ[i].addr == rs->addr) && !LSQ[i].squashed)
-                  {
-                    /* hit in the LSQ */
-                    load_lat = 1;
-                    break;
-                  }
 
-                  /* scan finished? */
-                  if (i == LSQ_head)
-                    break;
-                }
+              /* all earlier stores are in the store address hash, the
+                 load was checked against them */
+              /* FIXME: not dealing with partials! */
+              if (lsq_youngest_store(rs->addr, LSQ_POS(rs)))
+              {
+                /* hit in the LSQ */
+                load_lat = 1;
               }
 
               /* was the value store forwared from the LSQ? */
@@ -5394,9 +6480,11 @@ ruu_issue(void)
                   /* yuck -- can't do the load this cycle.
 				   * This load will have to wait */
                   rs->issued = FALSE;
+                  if (!rs->in_LSQ)
+                    ruu_occ_adjust(rs->thread_id, 1);
                   rs->decoded = TRUE;
                   if (!infinite_fu)
-                    fu->master->busy = 0;
+                    res_free(fu_pool, fu->master);
                   n_issued--;
                   n_int_issued--;
                   IIQ_occ++;
@@ -5482,6 +6570,8 @@ ruu_issue(void)
           /* the instruction does not need a functional unit */
           rs->decoded = FALSE;
           rs->issued = TRUE;
+          if (!rs->in_LSQ)
+            ruu_occ_adjust(rs->thread_id, -1);
           rs->issued_at = sim_cycle;
 
           /* schedule a result event */
@@ -5531,19 +6621,17 @@ ruu_issue(void)
     /* else, RUU entry was squashed */
 
   inst_requeued:
-    /* reclaim ready list entry, NOTE: this is done whether or not the
-         instruction issued, since the instruction was once again reinserted
-         into the ready queue if it did not issue, this ensures that the ready
-         queue is always properly sorted */
-    RSLINK_FREE(node);
+    /* nothing to reclaim, NOTE: the popped entry is dropped whether or not
+         the instruction issued, since the instruction was once again
+         reinserted into the ready queue if it did not issue */
+    ;
   }
 
   /* Clean up insts we didn't get to process because we fulfilled the
    * issue width. */
-  for (; node; node = next_node)
+  while ((node = readyq_pop(issue_q, &link)))
   {
     struct RUU_station *rs = RSLINK_RS(node);
-    next_node = node->next;
 
     if (RSLINK_VALID(node) && !rs->squashed)
     {
@@ -5558,12 +6646,6 @@ ruu_issue(void)
       readyq_enqueue(rs);
     }
     /* else RUU entry was squashed */
-
-    /* reclaim ready list entry, NOTE: this is done whether or not the
-         instruction issued, since the instruction was once again reinserted
-         into the ready queue if it did not issue, this ensures that the ready
-         queue is always properly sorted */
-    RSLINK_FREE(node);
   }
 
   if (report_issue && done_priming)
@@ -5580,16 +6662,16 @@ ruu_issue(void)
 
 /* integer register file */
 #define R_BMAP_SZ (BITMAP_SIZE(SS_NUM_REGS))
-static SS_WORD_TYPE spec_regs_R[N_THREAD_RECS][N_SPEC_LEVELS][SS_NUM_REGS];
+static SS_WORD_TYPE (**spec_regs_R)[SS_NUM_REGS]; /* [thr][lev] */
 
 /* floating point register file */
 #define F_BMAP_SZ (BITMAP_SIZE(SS_NUM_REGS))
-static union regs_FP spec_regs_F[N_THREAD_RECS][N_SPEC_LEVELS];
+static union regs_FP **spec_regs_F;
 
 /* miscellaneous registers */
-static SS_WORD_TYPE spec_regs_HI[N_THREAD_RECS][N_SPEC_LEVELS];
-static SS_WORD_TYPE spec_regs_LO[N_THREAD_RECS][N_SPEC_LEVELS];
-static int spec_regs_FCC[N_THREAD_RECS][N_SPEC_LEVELS];
+static SS_WORD_TYPE **spec_regs_HI;
+static SS_WORD_TYPE **spec_regs_LO;
+static int **spec_regs_FCC;
 
 /* dump speculative register state */
 static void
@@ -5645,26 +6727,155 @@ rspec_dump(FILE *stream) /* output stream, thread no. */
   }
 }
 
-/* speculative memory hash table size, NOTE: this must be a power-of-two */
-#define STORE_HASH_SIZE 32
-
-/* speculative memory hash table definition, accesses go through this hash
-   table when accessing memory in speculative mode, the hash table flush the
-   table when recovering from mispredicted branches */
+/* speculative memory state, accesses go through these tables when accessing
+   memory in speculative mode; each thread has one table per spec level, and
+   recovering from a mispredicted branch resets the squashed levels' tables */
 struct spec_mem_ent
 {
-  struct spec_mem_ent *next; /* ptr to next hash table bucket */
   SS_ADDR_TYPE addr;         /* virtual address of spec state */
-  int spec_level;            /* passed this many br mispreds */
-  int thread;                /* thread that created this addr */
   unsigned int data[2];      /* spec buffer, up to 8 bytes */
 };
 
-/* speculative memory hash table */
-static struct spec_mem_ent *store_htable[STORE_HASH_SIZE];
+/* a slot in a spec store's hash table, in use if its generation is the
+   store's */
+struct spec_store_slot
+{
+  unsigned int gen;          /* generation the slot was filled in */
+  int ent;                   /* index of its entry in the store's arena */
+};
+
+/* one thread's speculative memory state at one spec level: entries live in
+   an arena, indexed by an open-addressed (linear probing) hash table; the
+   storage is kept across resets, so the table only allocates while it grows
+   past its largest size so far */
+struct spec_store
+{
+  struct spec_mem_ent *ents; /* arena of entries, NUM used */
+  int num, size;             /* entries used, allocated */
+  struct spec_store_slot *slots; /* hash table, HSIZE slots */
+  int hsize;                 /* power of two, at least twice NUM */
+  int hshift;                /* 32 - log2(HSIZE) */
+  unsigned int gen;          /* current generation, bumped on reset */
+};
+
+/* speculative memory state, [thread][spec level] */
+static struct spec_store **spec_store;
+
+/* per thread, the highest spec level whose store may be non-empty, so
+   recovery need not visit every level */
+static int *spec_store_top;
+
+/* return thread T's spec store for level S, about to be written */
+#define SPEC_STORE_WR(T, S) \
+  (spec_store_top[T] < (S) ? (spec_store_top[T] = (S)) : 0, \
+   &spec_store[T][S])
 
-/* speculative memory hash table bucket free list */
-static struct spec_mem_ent *bucket_free_list = NULL;
+/* spec store hash function: the top bits of a multiplicative hash */
+#define SPEC_STORE_HASH(ST, ADDR) \
+  ((unsigned int)((ADDR) * 2654435761u) >> (ST)->hshift)
+
+/* smallest spec store hash table */
+#define SPEC_STORE_MIN_HSIZE 16
+
+/* rebuild spec store ST's hash table with HSIZE slots */
+static void
+spec_store_rehash(struct spec_store *st, int hsize)
+{
+  int i, h, bits;
+
+  free(st->slots);
+  st->slots = calloc(hsize, sizeof(struct spec_store_slot));
+  if (!st->slots)
+    fatal("out of virtual memory");
+  st->hsize = hsize;
+  for (bits = 0; (1 << bits) < hsize; bits++)
+    ;
+  st->hshift = 32 - bits;
+  st->gen = 1;
+
+  for (i = 0; i < st->num; i++)
+  {
+    for (h = SPEC_STORE_HASH(st, st->ents[i].addr);
+         st->slots[h].gen == st->gen;
+         h = (h + 1) & (st->hsize - 1))
+      ;
+    st->slots[h].gen = st->gen;
+    st->slots[h].ent = i;
+  }
+}
+
+/* find the entry for ADDR in spec store ST; if there is none, return NULL,
+   or if ALLOC, a new zeroed entry */
+static struct spec_mem_ent *
+spec_store_find(struct spec_store *st, SS_ADDR_TYPE addr, int alloc)
+{
+  struct spec_mem_ent *ent;
+  int h;
+
+  if (st->num == 0 && !alloc)
+    return NULL;
+
+  if (st->hsize < 2 * (st->num + 1))
+    spec_store_rehash(st, st->hsize ? 2 * st->hsize : SPEC_STORE_MIN_HSIZE);
+
+  for (h = SPEC_STORE_HASH(st, addr);
+       st->slots[h].gen == st->gen;
+       h = (h + 1) & (st->hsize - 1))
+  {
+    ent = &st->ents[st->slots[h].ent];
+    if (ent->addr == addr)
+      return ent;
+  }
+  if (!alloc)
+    return NULL;
+
+  /* allocate from the arena */
+  if (st->num == st->size)
+  {
+    st->size = st->size ? 2 * st->size : SPEC_STORE_MIN_HSIZE / 2;
+    st->ents = realloc(st->ents, st->size * sizeof(struct spec_mem_ent));
+    if (!st->ents)
+      fatal("out of virtual memory");
+  }
+  st->slots[h].gen = st->gen;
+  st->slots[h].ent = st->num;
+  ent = &st->ents[st->num++];
+  ent->addr = addr;
+  ent->data[0] = 0;
+  ent->data[1] = 0;
+  return ent;
+}
+
+/* empty spec store ST, in O(1): stale slots are told apart by generation */
+static void
+spec_store_reset(struct spec_store *st)
+{
+  if (st->num == 0)
+    return;
+  st->num = 0;
+  if (++st->gen == 0)
+  {
+    /* generation wrapped, really clear the slots */
+    memset(st->slots, 0, st->hsize * sizeof(struct spec_store_slot));
+    st->gen = 1;
+  }
+}
+
+/* copy every entry of spec store SRC into spec store DST, replacing any
+   entry DST already has for the same address */
+static void
+spec_store_copy(struct spec_store *dst, struct spec_store *src)
+{
+  struct spec_mem_ent *ent;
+  int i;
+
+  for (i = 0; i < src->num; i++)
+  {
+    ent = spec_store_find(dst, src->ents[i].addr, TRUE);
+    ent->data[0] = src->ents[i].data[0];
+    ent->data[1] = src->ents[i].data[1];
+  }
+}
 
 /* 
  * THREAD_CLEANUP() - on a branch resolution, kill threads that have been 
@@ -5710,6 +6921,7 @@ kill_threads(void)
         thread_info[t].valid = FALSE;
         thread_info[t].squashed = UNKNOWN;
         num_zombie_forks--;
+        pipe_activity++;
         if (ptrace_level != PTRACE_FUNSIM)
           ptrace_killthread(t);
       }
@@ -5787,44 +6999,19 @@ static void
 spec_mode_recover(int spec_level, /* kill all successive levels */
                   int t)          /* thread to kill */
 {
-  struct spec_mem_ent *ent, *ent_next, *ent_prev;
-  int i, s, max_thread_spec_level = thread_info[t].spec_level;
+  int s, max_thread_spec_level = thread_info[t].spec_level;
 
   /* this thread has been squashed, and all pending instructions
    * have been squashed or have completed: revert create vector, and spec-mem
    * state for the thread we just squashed back to last precise state. */
   for (s = spec_level + 1; s <= max_thread_spec_level; s++)
-  {
-    for (i = 0; i < SS_TOTAL_REGS; i++)
-      spec_create_vector[t][s][i] = CVLINK_NULL;
-  }
-
-  /* FIXME: could version stamps be used here?!?!? */
-  for (i = 0; i < STORE_HASH_SIZE; i++)
-  {
-    ent_prev = NULL;
-
-    /* release all hash table buckets for squashed levels of this thread */
-    for (ent = store_htable[i]; ent; ent = ent_next)
-    {
-      ent_next = ent->next;
+    cv_map_clear(&spec_create_vector[t][s]);
 
-      if (ent->thread != t || ent->spec_level <= spec_level)
-      {
-        /* this is state that's not getting squashed */
-        ent_prev = ent;
-        continue;
-      }
-
-      ent->next = bucket_free_list;
-      bucket_free_list = ent;
-
-      if (ent_prev)
-        ent_prev->next = ent_next;
-      else
-        store_htable[i] = ent_next;
-    }
-  }
+  /* release the spec-mem state of all squashed levels of this thread */
+  for (s = spec_level + 1; s <= spec_store_top[t]; s++)
+    spec_store_reset(&spec_store[t][s]);
+  if (spec_store_top[t] > spec_level)
+    spec_store_top[t] = spec_level;
 }
 
 /* recover instruction trace generator state to precise state state immediately
@@ -5834,10 +7021,9 @@ spec_mode_recover(int spec_level, /* kill all successive levels */
 static void
 thread_cleanup(struct RUU_station *rs_branch)
 {
-  int i, t, n, did_squash, taken;
+  int t, did_squash, taken;
   int kill_bmap_ptr = rs_branch->fork_hist_bmap_ptr;
   BITMAP_TYPE(N_SPEC_LEVELS, kill_bmap);
-  BITMAP_TYPE(N_SPEC_LEVELS, tmp_bmap);
 
   dassert(thread_info[rs_branch->thread_id].valid);
   assert(!pred_perfect);
@@ -5845,6 +7031,10 @@ thread_cleanup(struct RUU_station *rs_branch)
   /* working copy of the fork-hist bmap corresponding to the killed path */
   BITMAP_COPY(kill_bmap, rs_branch->fork_hist_bmap, THREADS_BMAP_SZ);
 
+  /* a new recovery: the RUU and LSQ entries of the threads squashed below
+   * become squashable, without visiting them */
+  squash_epoch++;
+
   /* update the working copy with the result of this branch -- not applicable
    * for non-forked branches */
   if (rs_branch->forked)
@@ -5878,45 +7068,25 @@ thread_cleanup(struct RUU_station *rs_branch)
    * misspeculated paths */
   for (t = 0; t < N_THREAD_RECS; t++)
   {
-    did_squash = FALSE;
-
     if (!thread_info[t].valid)
       continue;
 
-    /* find bits where the candidate and squashed-thread bitmaps match */
-    BITMAP_XOR(tmp_bmap,                      /* answer stored here */
-               kill_bmap,                     /* input bitmap */
-               thread_info[t].fork_hist_bmap, /* "    "    */
-               THREADS_BMAP_SZ);              /* bitmap size */
-    BITMAP_NOT(tmp_bmap, tmp_bmap, THREADS_BMAP_SZ);
-
     /* if candidate thread's bmap doesn't match for all bits from the
-       * fork_hist_bmap_head through the bit corresponding to the branch 
-       * just resolved, then the candidate isn't a child and hasn't
-       * just been identified as misspeculated.  */
-    for (i = fork_hist_bmap_head; !did_squash; i = (i + 1) % N_SPEC_LEVELS)
-    {
-      /* if bit 'i' doesn't match, 't' isn't a child of the
-	   * thread being squashed */
-      if (!BITMAP_SET_P(tmp_bmap, THREADS_BMAP_SZ, i))
-      {
-        if (thread_info[t].squashed != TRUE)
-          thread_info[t].squashed = FALSE;
-
-        break;
-      }
-
-      /* if we just examined the squashed branch's "own" bit without 
-	   * a failed match, all relevant bits match, we should squash 
-	   * thread number 't', and we're done */
-      if (i == kill_bmap_ptr)
-        did_squash = TRUE;
-    }
+     * fork_hist_bmap_head through the bit corresponding to the branch
+     * just resolved, then the candidate isn't a child and hasn't
+     * just been identified as misspeculated.  */
+    did_squash = BITMAP_RING_MATCH_P(kill_bmap,
+                                     thread_info[t].fork_hist_bmap,
+                                     THREADS_BMAP_SZ, fork_hist_bmap_head,
+                                     kill_bmap_ptr, N_SPEC_LEVELS);
+    if (!did_squash && thread_info[t].squashed != TRUE)
+      thread_info[t].squashed = FALSE;
 
     /* if candidate matches all bits above, then squash it */
     if (did_squash)
     {
       thread_info[t].squashed = NOW;
+      thread_info[t].squash_epoch = squash_epoch;
 
 #ifndef NDEBUG
       if (thread_info[t].spec_mode == FALSE && rs_branch->thread_id != t)
@@ -5925,14 +7095,6 @@ thread_cleanup(struct RUU_station *rs_branch)
     }
   }
 
-  for (t = RUU_head, n = 0; n < RUU_num; t = (t + 1) % RUU_size, n++)
-    if (thread_info[RUU[t].thread_id].squashed == NOW)
-      RUU[t].squashable = TRUE;
-
-  for (t = LSQ_head, n = 0; n < LSQ_num; t = (t + 1) % LSQ_size, n++)
-    if (thread_info[LSQ[t].thread_id].squashed == NOW)
-      LSQ[t].squashable = TRUE;
-
   for (t = 0; t < N_THREAD_RECS; t++)
     if (thread_info[t].squashed == NOW)
     {
@@ -5952,21 +7114,19 @@ post_thread_cleanup(struct RUU_station *rs_branch)
 {
   int t, n;
   int branch_thread = rs_branch->thread_id;
-  int saw_valid = FALSE;
 
-  /* reset squashable flags in RUU and LSQ.  Also advance fork_hist_bmap_head
-   * as far as possible.  */
-  for (t = LSQ_head, n = 0; n < LSQ_num; t = (t + 1) % LSQ_size, n++)
-    LSQ[t].squashable = FALSE;
+  /* the recovery is over, nothing is squashable any more */
+  squash_epoch++;
+
+  /* advance fork_hist_bmap_head as far as possible, to the oldest live
+   * branch */
   for (t = RUU_head, n = 0; n < RUU_num; t = (t + 1) % RUU_size, n++)
   {
-    RUU[t].squashable = FALSE;
-
-    if ((SS_OP_FLAGS(RUU[t].op) & F_CTRL) && !RUU[t].squashed && !saw_valid)
+    if ((SS_OP_FLAGS(RUU[t].op) & F_CTRL) && !RUU[t].squashed)
     {
       /* found a live branch */
       fork_hist_bmap_head = RUU[t].fork_hist_bmap_ptr;
-      saw_valid = TRUE;
+      break;
     }
   }
 
@@ -6054,7 +7214,7 @@ struct fetch_rec
   int forked_thread;                           /* if this thread forked, the
 					 * id of the forked child */
   int thread;                                  /* this inst's thread id */
-  BITMAP_TYPE(N_SPEC_LEVELS, fork_hist_bmap);  /* fork history bitmap */
+  BITMAP_PTR_TYPE fork_hist_bmap;             /* fork history bitmap */
   BITMAP_ENT_TYPE fork_hist_bmap_ptr;          /* ptr to this inst's pos'n in bmap */
   SS_TIME_TYPE fetched_at;                     /* when this inst was fetched */
   int valid;
@@ -6147,7 +7307,40 @@ tracer_recover_wrapper(int curr_thread, SS_ADDR_TYPE regs_PC,
 static void
 tracer_init(void)
 {
-  ; /* store_htable should get initialized via static decls */
+  int t;
+
+  /* allocate the per-thread speculative register files; spec levels
+   * count from 1, so each thread gets N_SPEC_LEVELS + 1 of them */
+  spec_regs_R = calloc(N_THREAD_RECS, sizeof(*spec_regs_R));
+  spec_regs_F = calloc(N_THREAD_RECS, sizeof(*spec_regs_F));
+  spec_regs_HI = calloc(N_THREAD_RECS, sizeof(*spec_regs_HI));
+  spec_regs_LO = calloc(N_THREAD_RECS, sizeof(*spec_regs_LO));
+  spec_regs_FCC = calloc(N_THREAD_RECS, sizeof(*spec_regs_FCC));
+  if (!spec_regs_R || !spec_regs_F || !spec_regs_HI || !spec_regs_LO || !spec_regs_FCC)
+    fatal("out of virtual memory");
+
+  for (t = 0; t < N_THREAD_RECS; t++)
+  {
+    spec_regs_R[t] = calloc(N_SPEC_LEVELS + 1, sizeof(**spec_regs_R));
+    spec_regs_F[t] = calloc(N_SPEC_LEVELS + 1, sizeof(**spec_regs_F));
+    spec_regs_HI[t] = calloc(N_SPEC_LEVELS + 1, sizeof(**spec_regs_HI));
+    spec_regs_LO[t] = calloc(N_SPEC_LEVELS + 1, sizeof(**spec_regs_LO));
+    spec_regs_FCC[t] = calloc(N_SPEC_LEVELS + 1, sizeof(**spec_regs_FCC));
+    if (!spec_regs_R[t] || !spec_regs_F[t] || !spec_regs_HI[t] || !spec_regs_LO[t] || !spec_regs_FCC[t])
+      fatal("out of virtual memory");
+  }
+
+  /* the spec stores allocate their storage on first use */
+  spec_store = calloc(N_THREAD_RECS, sizeof(*spec_store));
+  spec_store_top = calloc(N_THREAD_RECS, sizeof(*spec_store_top));
+  if (!spec_store || !spec_store_top)
+    fatal("out of virtual memory");
+  for (t = 0; t < N_THREAD_RECS; t++)
+  {
+    spec_store[t] = calloc(N_SPEC_LEVELS + 1, sizeof(**spec_store));
+    if (!spec_store[t])
+      fatal("out of virtual memory");
+  }
 }
 
 /* 
@@ -6163,8 +7356,7 @@ fork_thread(SS_ADDR_TYPE newPC, int forking_thread)
   int t, n;
   int new_thread = -1;
 #ifdef DEBUG_SPEC_MEM
-  int i;
-  struct spec_mem_ent *ent;
+  int s;
 #endif
   BITMAP_ENT_TYPE old_bmap_ptr = thread_info[forking_thread].fork_hist_bmap_ptr;
   dassert(thread_info[forking_thread].valid == TRUE);
@@ -6223,17 +7415,10 @@ fork_thread(SS_ADDR_TYPE newPC, int forking_thread)
   assert(thread_info[new_thread].fork_hist_bmap_ptr != fork_hist_bmap_head);
 
 #ifdef DEBUG_SPEC_MEM
-  /* check spec-mem-state */
-  for (i = 0; i < STORE_HASH_SIZE; i++)
-  {
-    /* should be no entries for this thread */
-    for (ent = store_htable[i]; ent; ent = ent->next)
-    {
-      if (ent->thread != t)
-        continue;
-      panic("spec-mem-state leak, thread %t", new_thread);
-    }
-  }
+  /* check spec-mem-state: should be no entries for this thread */
+  for (s = 0; s <= N_SPEC_LEVELS; s++)
+    if (spec_store[new_thread][s].num)
+      panic("spec-mem-state leak, thread %d", new_thread);
 #endif
 
   /*
@@ -6261,6 +7446,7 @@ void thread_refork(int forked_thread,
                    int ruu_refork_penalty)
 {
   struct RUU_station dummy_rs;
+  BITMAP_TYPE(N_SPEC_LEVELS, dummy_bmap);     /* dummy_rs's own fork history */
   int junk;
 
   /* only proceed if this thread hasn't already been killed */
@@ -6278,6 +7464,7 @@ void thread_refork(int forked_thread,
   dummy_rs.thread_id = forking_thread;
   dummy_rs.forked = TRUE;
   dummy_rs.fork_hist_bmap_ptr = forking_branch_bmap_ptr;
+  dummy_rs.fork_hist_bmap = dummy_bmap;
   BITMAP_COPY(dummy_rs.fork_hist_bmap, forking_branch_bmap, THREADS_BMAP_SZ);
   ifq_num--; /* don't nuke forking branch from IFQ*/
 
@@ -6336,19 +7523,15 @@ void thread_refork(int forked_thread,
                    thread_info[forked_thread].fork_hist_bmap_ptr);
 }
 
-/* speculative memory hash table address hash function */
-#define HASH_ADDR(ADDR) \
-  ((((ADDR) >> 24) ^ ((ADDR) >> 16) ^ ((ADDR) >> 8) ^ (ADDR)) & (STORE_HASH_SIZE - 1))
-
 /* this functional provides a layer of mis-speculated state over the
    non-speculative memory state, when in mis-speculation trace generation mode,
    the simulator will call this function to access memory, instead of the
    non-speculative memory access interfaces defined in memory.h; when storage
-   is written, an entry is allocated in the speculative memory hash table,
+   is written, an entry is allocated in the thread's spec store for its level,
    future reads and writes while in mis-speculative trace generation mode will
    access this buffer instead of non-speculative memory state; when the trace
    generator transitions back to non-speculative trace generation mode,
-   spec_mode_recover() clears this table */
+   spec_mode_recover() clears the squashed levels' stores */
 static void
 spec_mem_access(enum mem_cmd cmd,  /* Read or Write access cmd */
                 SS_ADDR_TYPE addr, /* virtual address of access */
@@ -6357,10 +7540,9 @@ spec_mem_access(enum mem_cmd cmd,  /* Read or Write access cmd */
                 void *p,           /* input/output buffer */
                 int nbytes)        /* number of bytes to access */
 {
-  int index;
-  struct spec_mem_ent *ent, *prev;
+  struct spec_mem_ent *ent;
 #ifdef DEBUG_SPEC_MEM
-  int better_find_it = FALSE;
+  int s;
 #endif
 
   /* FIXME: partially overlapping writes are not combined... */
@@ -6381,57 +7563,23 @@ spec_mem_access(enum mem_cmd cmd,  /* Read or Write access cmd */
   }
 
   /* Make sure any pages we allocate are marked as speculative and marked with
-   * the writing thread, so we can recover the memory.  mem_access_mode_spec 
-   * is a global variable checked in memory.h */
-  mem_access_mode_spec = TRUE;
-
-  /* has this memory state been copied by this thread on mis-spec write? */
-  index = HASH_ADDR(addr);
-  for (prev = NULL, ent = store_htable[index]; ent; prev = ent, ent = ent->next)
-  {
-    if (ent->addr == addr && ent->thread == thread && ent->spec_level == spec_level)
-    {
-      /* reorder chains to speed access into hash table */
-      if (prev != NULL)
-      {
-        /* not at head of list, relink the hash table entry at front */
-        prev->next = ent->next;
-        ent->next = store_htable[index];
-        store_htable[index] = ent;
-      }
-      break;
-    }
-#ifdef DEBUG_SPEC_MEM
-    else if (ent->addr == addr && ent->thread == thread && ent->spec_level <= spec_level)
-      better_find_it = TRUE;
-#endif
-  }
-
-  dassert(!better_find_it);
+   * the writing thread, so we can recover the memory.  mem_access_mode_spec 
+   * is a global variable checked in memory.h */
+  mem_access_mode_spec = TRUE;
 
-  /* no, if it is a write, allocate a hash table entry to hold the data */
-  if (!ent && cmd == Write)
-  {
-    /* try to get an entry from the free list, if available */
-    if (!bucket_free_list)
-    {
-      /* otherwise, call calloc() to get the needed storage */
-      bucket_free_list = calloc(1, sizeof(struct spec_mem_ent));
-      if (!bucket_free_list)
-        fatal("out of virtual memory");
-    }
-    ent = bucket_free_list;
-    bucket_free_list = bucket_free_list->next;
+  /* has this memory state been copied by this thread on mis-spec write?
+   * if not, and it is a write, allocate an entry to hold the data */
+  ent = spec_store_find(cmd == Write
+                        ? SPEC_STORE_WR(thread, spec_level)
+                        : &spec_store[thread][spec_level],
+                        addr, cmd == Write);
 
-    /* insert into hash table */
-    ent->next = store_htable[index];
-    store_htable[index] = ent;
-    ent->addr = addr;
-    ent->spec_level = spec_level;
-    ent->thread = thread;
-    ent->data[0] = 0;
-    ent->data[1] = 0;
-  }
+#ifdef DEBUG_SPEC_MEM
+  /* state written at an earlier level is copied to each later one */
+  if (!ent)
+    for (s = 0; s < spec_level; s++)
+      dassert(!spec_store_find(&spec_store[thread][s], addr, FALSE));
+#endif
 
   /* handle the read or write to speculative or non-speculative storage */
   switch (nbytes)
@@ -6534,27 +7682,29 @@ spec_mem_access(enum mem_cmd cmd,  /* Read or Write access cmd */
 static void
 mspec_dump(FILE *stream) /* output stream */
 {
-  int i;
+  int i, t, s;
   struct spec_mem_ent *ent;
 
   fprintf(stream, "** speculative memory contents **\n");
 
-  for (i = 0; i < STORE_HASH_SIZE; i++)
-  {
-    /* dump contents of all hash table buckets */
-    for (ent = store_htable[i]; ent; ent = ent->next)
+  for (t = 0; t < N_THREAD_RECS; t++)
+    for (s = 0; s <= N_SPEC_LEVELS; s++)
     {
-      fprintf(stream,
-              "[0x%08x, thread %2d]: %12.0f/0x%08x:%08x, "
-              "spec mode: %s, spec lev: %d\n",
-              ent->addr, ent->thread,
-              (double)(*((double *)ent->data)),
-              *((unsigned int *)&ent->data[0]),
-              *(((unsigned int *)&ent->data[0]) + 1),
-              (thread_info[ent->thread].spec_mode ? "t" : "f"),
-              thread_info[ent->thread].spec_level);
+      /* dump contents of all spec stores */
+      for (i = 0; i < spec_store[t][s].num; i++)
+      {
+        ent = &spec_store[t][s].ents[i];
+        fprintf(stream,
+                "[0x%08x, thread %2d]: %12.0f/0x%08x:%08x, "
+                "spec mode: %s, spec lev: %d\n",
+                ent->addr, t,
+                (double)(*((double *)ent->data)),
+                *((unsigned int *)&ent->data[0]),
+                *(((unsigned int *)&ent->data[0]) + 1),
+                (thread_info[t].spec_mode ? "t" : "f"),
+                s);
+      }
     }
-  }
 }
 
 #ifdef USE_DLITE /* Not updated to accommodate multi-path/multi-threading */
@@ -6649,6 +7799,10 @@ ruu_install_odep(struct RUU_station *rs, /* creating RUU station */
   struct CV_link cv;
   int spec_level;
 
+  /* create vector entries naming the last instruction in this RS are
+     of no interest any more */
+  cv_refs_free(&rs->cv_refs[odep_num]);
+
   /* any dependence? */
   if (odep_name == NA)
   {
@@ -7043,6 +8197,7 @@ ruu_dispatch(void)
          /* insts still available from fetch unit? */
          && ifq_num != 0)
   {
+    pipe_activity++;
     fetch_redirected = FALSE;
     patch_type = 0;
 
@@ -8004,10 +9159,7 @@ ruu_dispatch(void)
           spec_regs_FCC[curr_thread][1] = regs_FCC;
 
           /* ...and of the create vectors */
-          memcpy(spec_create_vector[curr_thread][1], create_vector,
-                 SS_TOTAL_REGS * sizeof(struct CV_link));
-          memcpy(spec_create_vector_rt[curr_thread][1],
-                 create_vector_rt, SS_TOTAL_REGS * sizeof(SS_TIME_TYPE));
+          cv_map_copy(&spec_create_vector[curr_thread][1], &create_vector);
 
           /* adjust priorities */
           if ((fetch_pri_pol == Omni_Pri || fetch_pri_pol == Two_Omni_Pri) && forked)
@@ -8067,12 +9219,8 @@ ruu_dispatch(void)
             spec_regs_FCC[forked_thread][1] = regs_FCC;
 
             /* ...and of the create vectors */
-            memcpy(spec_create_vector[forked_thread][1],
-                   create_vector,
-                   SS_TOTAL_REGS * sizeof(struct CV_link));
-            memcpy(spec_create_vector_rt[forked_thread][1],
-                   create_vector_rt,
-                   SS_TOTAL_REGS * sizeof(SS_TIME_TYPE));
+            cv_map_copy(&spec_create_vector[forked_thread][1],
+                        &create_vector);
           }
         }
       }
@@ -8114,12 +9262,8 @@ ruu_dispatch(void)
         spec_regs_FCC[forked_thread][spec_level] = spec_regs_FCC[curr_thread][spec_level];
 
         /* ... and of the create vectors */
-        memcpy(spec_create_vector[forked_thread][spec_level],
-               spec_create_vector[curr_thread][spec_level],
-               SS_TOTAL_REGS * sizeof(struct CV_link));
-        memcpy(spec_create_vector_rt[forked_thread][spec_level],
-               spec_create_vector_rt[curr_thread][spec_level],
-               SS_TOTAL_REGS * sizeof(SS_TIME_TYPE));
+        cv_map_copy(&spec_create_vector[forked_thread][spec_level],
+                    &spec_create_vector[curr_thread][spec_level]);
       }
 #ifndef BUG_COMPAT_RECOVER_INST
       else
@@ -8147,73 +9291,17 @@ ruu_dispatch(void)
       spec_regs_FCC[curr_thread][spec_level] = spec_regs_FCC[curr_thread][old_spec_level];
 
       /* ... and of the create vectors */
-      memcpy(spec_create_vector[curr_thread][spec_level],
-             spec_create_vector[curr_thread][old_spec_level],
-             SS_TOTAL_REGS * sizeof(struct CV_link));
-      memcpy(spec_create_vector_rt[curr_thread][spec_level],
-             spec_create_vector_rt[curr_thread][old_spec_level],
-             SS_TOTAL_REGS * sizeof(SS_TIME_TYPE));
-
-      /* ... and both threads need new spec-mem-state entries */
-      for (i = 0; i < STORE_HASH_SIZE; i++)
-      {
-        struct spec_mem_ent *ent, *newent;
-
-        for (ent = store_htable[i]; ent; ent = ent->next)
-        {
-          if (ent->thread != curr_thread || ent->spec_level != old_spec_level)
-            /* this entry belongs to some other thread/epoch */
-            continue;
-
-          /* 
-		   * the new spec level needs a copy of this entry,
-		   * and if forked, the forked thread also needs a copy 
-		   */
-
-          /* try to get an entry from the free list, if avail */
-          if (!bucket_free_list)
-          {
-            /* otherwise, call calloc() to get more storage */
-            bucket_free_list = calloc(1,
-                                      sizeof(struct spec_mem_ent));
-            if (!bucket_free_list)
-              fatal("out of virtual memory");
-          }
-          newent = bucket_free_list;
-          bucket_free_list = bucket_free_list->next;
-
-          newent->next = store_htable[i];
-          store_htable[i] = newent;
-          newent->addr = ent->addr;
-          newent->thread = curr_thread;
-          newent->spec_level = spec_level;
-          newent->data[0] = ent->data[0];
-          newent->data[1] = ent->data[1];
-
-          if (forked)
-          {
-            /* try to get an entry from the free list, if avail */
-            if (!bucket_free_list)
-            {
-              /* otherwise, call calloc() to get more storage */
-              bucket_free_list = calloc(1,
-                                        sizeof(struct spec_mem_ent));
-              if (!bucket_free_list)
-                fatal("out of virtual memory");
-            }
-            newent = bucket_free_list;
-            bucket_free_list = bucket_free_list->next;
-
-            newent->next = store_htable[i];
-            store_htable[i] = newent;
-            newent->addr = ent->addr;
-            newent->thread = forked_thread;
-            newent->spec_level = old_spec_level;
-            newent->data[0] = ent->data[0];
-            newent->data[1] = ent->data[1];
-          }
-        }
-      }
+      cv_map_copy(&spec_create_vector[curr_thread][spec_level],
+                  &spec_create_vector[curr_thread][old_spec_level]);
+
+      /* ... and both threads need new spec-mem-state entries: the new
+       * spec level needs a copy of the old level's, and if forked, the
+       * forked thread also needs a copy */
+      spec_store_copy(SPEC_STORE_WR(curr_thread, spec_level),
+                      &spec_store[curr_thread][old_spec_level]);
+      if (forked)
+        spec_store_copy(SPEC_STORE_WR(forked_thread, old_spec_level),
+                        &spec_store[curr_thread][old_spec_level]);
     }
     else
     {
@@ -8254,49 +9342,12 @@ ruu_dispatch(void)
         spec_regs_FCC[forked_thread][new_spec_level] = spec_regs_FCC[curr_thread][spec_level];
 
         /* ... and of the create vectors */
-        memcpy(spec_create_vector[forked_thread][new_spec_level],
-               spec_create_vector[curr_thread][spec_level],
-               SS_TOTAL_REGS * sizeof(struct CV_link));
-        memcpy(spec_create_vector_rt[forked_thread][new_spec_level],
-               spec_create_vector_rt[curr_thread][spec_level],
-               SS_TOTAL_REGS * sizeof(SS_TIME_TYPE));
+        cv_map_copy(&spec_create_vector[forked_thread][new_spec_level],
+                    &spec_create_vector[curr_thread][spec_level]);
 
         /* ... and of spec mem state */
-        for (i = 0; i < STORE_HASH_SIZE; i++)
-        {
-          struct spec_mem_ent *ent, *newent;
-
-          for (ent = store_htable[i]; ent; ent = ent->next)
-          {
-            if (ent->thread != curr_thread || ent->spec_level != spec_level)
-              /* this entry belongs to some other thread/epoch */
-              continue;
-
-            /* 
-		       * the forked thread needs a copy of this entry 
-		       */
-
-            /* try to get an entry from the free list, if avail */
-            if (!bucket_free_list)
-            {
-              /* otherwise, call calloc() to get more storage */
-              bucket_free_list = calloc(1,
-                                        sizeof(struct spec_mem_ent));
-              if (!bucket_free_list)
-                fatal("out of virtual memory");
-            }
-            newent = bucket_free_list;
-            bucket_free_list = bucket_free_list->next;
-
-            newent->next = store_htable[i];
-            store_htable[i] = newent;
-            newent->addr = ent->addr;
-            newent->thread = forked_thread;
-            newent->spec_level = new_spec_level;
-            newent->data[0] = ent->data[0];
-            newent->data[1] = ent->data[1];
-          }
-        }
+        spec_store_copy(SPEC_STORE_WR(forked_thread, new_spec_level),
+                        &spec_store[curr_thread][spec_level]);
       }
     }
 
@@ -8379,6 +9430,13 @@ ruu_dispatch(void)
       rs->conf = conf;
       rs->squashed = FALSE;
       rs->thread_id = curr_thread;
+      ruu_occ_adjust(curr_thread, 1);
+
+      /* chain onto the thread's RUU entries, for ruu_recover() */
+      rs->thread_prev = thread_info[curr_thread].ruu_youngest;
+      rs->thread_prev_seq = thread_info[curr_thread].ruu_youngest_seq;
+      thread_info[curr_thread].ruu_youngest = rs - RUU;
+      thread_info[curr_thread].ruu_youngest_seq = rs->seq;
 
       /* split ld/st's into two operations: eff addr comp + mem access */
       if (SS_OP_FLAGS(op) & F_MEM)
@@ -8392,6 +9450,7 @@ ruu_dispatch(void)
 
         /* fill in LSQ reservation station */
         lsq = &LSQ[LSQ_tail];
+        rs->lsq_index = LSQ_tail;
 
         lsq->IR = inst;
         lsq->op = op;
@@ -8603,12 +9662,19 @@ ruu_dispatch(void)
 static void
 fetch_init(void)
 {
+  int i;
+  BITMAP_PTR_TYPE bmaps;
+
   /* allocate the IFETCH -> DISPATCH instruction queue */
   ifq =
       (struct fetch_rec *)calloc(ruu_ifq_size, sizeof(struct fetch_rec));
   if (!ifq)
     fatal("out of virtual memory");
 
+  bmaps = fork_hist_bmap_alloc(ruu_ifq_size);
+  for (i = 0; i < ruu_ifq_size; i++)
+    ifq[i].fork_hist_bmap = bmaps + i * THREADS_BMAP_SZ;
+
   ifq_num = 0;
   ifq_tail = ifq_head = 0;
 }
@@ -8830,6 +9896,7 @@ ruu_fetch(int thread,         /* thread from which to fetch a line */
   /* Sanity checks */
   assert(thread_info[thread].valid == TRUE && thread_info[thread].squashed == UNKNOWN);
   assert(thread_info[thread].fetchable <= sim_cycle);
+  pipe_activity++;
   assert(ifq_num < ruu_ifq_size); /* can't fetch if ifq is full */
 
   /* If il1 and dl1 are unified, we can only fetch if ports are available */
@@ -9216,6 +10283,10 @@ failed_fetch:
   return done;
 }
 
+/* direction in which ruu_fetch_wrapper() walks the threads, flips every
+ * cycle */
+static int go_backwards;
+
 /* ruu_fetch_wrapper:
  * controls how many times each thread may call ruu_fetch(), which in
  * turn does the actual fetching and enqueueing in the IFQ
@@ -9226,7 +10297,6 @@ ruu_fetch_wrapper(void)
   int num_fetched = 0;
   int done, i;
   int cache_lines_left, lines_per_thread, pred_thread_fetchable, pri, thread;
-  static int go_backwards;
 
   if (fetch_pri_pol == Pred_RR || fetch_pri_pol == Pred_Pri2)
   {
@@ -9240,7 +10310,7 @@ ruu_fetch_wrapper(void)
   /* call instruction fetch unit -- for time being, can only
    * fetch once per thread per cycle */
   for (cache_lines_left = fetch_cache_lines;
-       cache_lines_left > 0 && ifq_num < ruu_ifq_size;)
+       cache_lines_left > 0 && ifq_num < ruu_ifq_size && !fetch_stopped;)
   {
     /* choose a thread to fetch from; if get_next returns -1,
        * no threads are ready and we end fetching for this cycle */
@@ -9327,6 +10397,128 @@ ruu_fetch_wrapper(void)
   sim_total_fetched += num_fetched;
 }
 
+/*
+ * IDLE CYCLE SKIPPING
+ *
+ * When every thread waits on a cache miss (or the RUU is full behind
+ * one), cycle after cycle goes by in which nothing but the per-cycle stats
+ * change.  A cycle that changes no machine state (see pipe_activity)
+ * repeats identically until the next thing that is due by the clock alone:
+ * an event, a thread becoming fetchable, a function unit release, or a
+ * DEAD_TIME watchdog in kill_threads() going off.  So after two such
+ * cycles in a row, the second having been "probed" (its stat changes
+ * measured), we jump straight to that cycle and credit the skipped ones
+ * with the probe's stat changes; the results do not change.
+ */
+
+/* only probe a cycle if at least this many could be skipped after it */
+#define IDLE_MIN_SKIP 16
+
+/* most cycles skipped at once */
+#define IDLE_MAX_SKIP (1 << 20)
+
+/* the scalar stats before and after the probed cycle */
+static int idle_nstats = 0;
+static double *idle_before = NULL, *idle_after = NULL;
+
+/* is the current cycle probed?  pipe_activity before it, and at the end of
+   the last cycle */
+static int idle_probing = FALSE;
+static unsigned long idle_probe_activity, idle_last_activity;
+
+/* first cycle from the current one on in which something may happen on its
+   own, at most IDLE_MAX_SKIP cycles ahead */
+static SS_TIME_TYPE
+idle_wake_time(void)
+{
+  SS_TIME_TYPE wake = sim_cycle + IDLE_MAX_SKIP, when;
+  int i;
+
+  /* the next writeback event */
+  if (eventq_next_time(wake, &when))
+    wake = when;
+
+  /* the next thread to become fetchable, maybe in the current cycle */
+  for (i = 0; i < N_THREAD_RECS; i++)
+    if (thread_info[i].valid == TRUE && thread_info[i].fetchable >= sim_cycle && thread_info[i].fetchable < wake)
+      wake = thread_info[i].fetchable;
+
+  /* the next function unit release, a unit released by ruu_release_fu()
+     in a cycle can be used in that cycle */
+  if (!infinite_fu && res_next_release(fu_pool, &when) && when < wake)
+    wake = when;
+
+  /* the next stats time series sample */
+  if (stats_series && !stats_by_insts && stats_next_sample < wake)
+    wake = stats_next_sample;
+
+#ifndef NDEBUG
+  /* the first cycle in which kill_threads() would find a thread orphaned
+     or the prune token lost; that cycle must run, so that it panics */
+  if (max_threads > 1)
+  {
+    for (i = 0; i < N_THREAD_RECS; i++)
+      if (thread_info[i].valid && thread_info[i].fetchable + DEAD_TIME + 1 < wake)
+        wake = thread_info[i].fetchable + DEAD_TIME + 1;
+    if ((fork_prune || fetch_pred_pri) && last_true_token_seen + DEAD_TIME + 1 < wake)
+      wake = last_true_token_seen + DEAD_TIME + 1;
+  }
+#endif
+
+  return MAX(wake, sim_cycle);
+}
+
+/* called at the end of each cycle: probe the next cycle if the last two
+   were idle, or after a probed cycle that turned out idle, skip to the next
+   cycle in which something may happen */
+static void
+idle_skip(void)
+{
+  SS_TIME_TYPE wake;
+  int i, skip;
+
+  if (idle_probing)
+  {
+    idle_probing = FALSE;
+    stat_record_end();
+
+    if (pipe_activity == idle_probe_activity && !ready_queue->hi.num && !ready_queue->lo.num && !cache_dl1_ports_used && (wake = idle_wake_time()) > sim_cycle)
+    {
+      /* the cycles up to WAKE would repeat the probed one */
+      skip = (int)(wake - sim_cycle);
+
+      /* credit their stats, sim_cycle is one of them */
+      stat_get_scalars(sim_sdb, idle_after);
+      for (i = 0; i < idle_nstats; i++)
+        idle_after[i] += skip * (idle_after[i] - idle_before[i]);
+      stat_set_scalars(sim_sdb, idle_after);
+      stat_record_replay(skip);
+
+      /* and step the state that changes every cycle; no function unit is
+         released before WAKE, ruu_release_fu() catches up by itself */
+      if (skip & 1)
+        go_backwards = !go_backwards;
+    }
+  }
+  else if (pipe_activity == idle_last_activity && !ready_queue->hi.num && !ready_queue->lo.num && idle_wake_time() >= sim_cycle + IDLE_MIN_SKIP)
+  {
+    if (!idle_before)
+    {
+      idle_nstats = stat_num_scalars(sim_sdb);
+      idle_before = (double *)calloc(idle_nstats + 1, sizeof(double));
+      idle_after = (double *)calloc(idle_nstats + 1, sizeof(double));
+      if (!idle_before || !idle_after)
+        fatal("out of virtual memory");
+    }
+    stat_get_scalars(sim_sdb, idle_before);
+    stat_record_begin();
+    idle_probing = TRUE;
+    idle_probe_activity = pipe_activity;
+  }
+
+  idle_last_activity = pipe_activity;
+}
+
 /*
  * OTHER AUXILLIARY FUNCTIONS
  */
@@ -9476,6 +10668,7 @@ void sim_init(void)
   fu_oplat_arr[Branch] = fu_config[FU_IBRSH_INDEX].x[0].oplat;
 
   rslink_init(MAX_RS_LINKS);
+  thread_info_init();
   tracer_init();
   fetch_init();
   cv_init();
@@ -9522,10 +10715,21 @@ void sim_init(void)
 #endif
 }
 
+/* print the weighted SimPoint estimates, see below */
+static void
+simpoint_print_stats(FILE *stream);
+
+/* print the pipeline stage profile, see below */
+static void
+prof_print_stats(FILE *stream);
+
 /* dump simulator-specific auxiliary simulator statistics */
 void sim_aux_stats(FILE *stream) /* output stream */
 {
-  /* nada */
+  if (simpoint_num)
+    simpoint_print_stats(stream);
+  if (profile_stages)
+    prof_print_stats(stream);
 }
 
 /* un-initialize the simulator */
@@ -9533,6 +10737,14 @@ void sim_uninit(void)
 {
   if (ptrace_nelt > 0)
     ptrace_close();
+
+  /* the last, partial interval */
+  if (stats_series)
+  {
+    tseries_sample(stats_series, sim_cycle, sim_num_insn);
+    tseries_close(stats_series);
+    stats_series = NULL;
+  }
 }
 
 /* exit signal handler */
@@ -9573,8 +10785,483 @@ void after_warmup(void)
   cache_after_warmup(dtlb);
 }
 
+/* write a checkpoint of the program, and with -ckpt:uarch of the warmed
+ * caches, TLBs and predictors, to FNAME */
+static void
+sim_ckpt_save(char *fname)
+{
+  struct ckpt_header hdr;
+  FILE *fd;
+
+  hdr.has_uarch = ckpt_save_uarch;
+  hdr.num_insn = sim_num_insn;
+  hdr.num_refs = sim_num_refs;
+  hdr.num_loads = sim_num_loads;
+  hdr.warmup_insn = num_warmup_insn;
+  fd = ckpt_create(fname, &hdr);
+
+  ckpt_save_arch(fd);
+  if (ckpt_save_uarch)
+  {
+    if (cache_il1)
+      cache_ckpt_save(cache_il1, fd);
+    if (cache_il2)
+      cache_ckpt_save(cache_il2, fd);
+    if (cache_dl1)
+      cache_ckpt_save(cache_dl1, fd);
+    if (cache_dl2)
+      cache_ckpt_save(cache_dl2, fd);
+    if (itlb)
+      cache_ckpt_save(itlb, fd);
+    if (dtlb)
+      cache_ckpt_save(dtlb, fd);
+    if (pred)
+      bpred_ckpt_save(pred, fd);
+    if (bconf)
+      bconf_ckpt_save(bconf, fd);
+  }
+  ckpt_put_tag(fd, "end");
+  ckpt_close(fd);
+
+  fprintf(outfile, "sim: ** wrote checkpoint `%s' at instruction %.0f **\n",
+          fname, (double)sim_num_insn);
+}
+
+/* replace the freshly loaded program with checkpoint FNAME; the caches,
+ * TLBs and predictors must be configured as they were when it was written */
+static void
+sim_ckpt_restore(char *fname)
+{
+  struct ckpt_header hdr;
+  FILE *fd;
+
+  fd = ckpt_open(fname, &hdr);
+  if (ld_prog_fname && strcmp(hdr.prog_fname, ld_prog_fname) != 0)
+    warn("checkpoint `%s' was taken from `%s', not `%s'",
+         fname, hdr.prog_fname, ld_prog_fname);
+
+  ckpt_restore_arch(fd);
+  sim_num_insn = hdr.num_insn;
+  sim_num_refs = hdr.num_refs;
+  sim_num_loads = hdr.num_loads;
+  if (hdr.has_uarch)
+  {
+    if (cache_il1)
+      cache_ckpt_restore(cache_il1, fd);
+    if (cache_il2)
+      cache_ckpt_restore(cache_il2, fd);
+    if (cache_dl1)
+      cache_ckpt_restore(cache_dl1, fd);
+    if (cache_dl2)
+      cache_ckpt_restore(cache_dl2, fd);
+    if (itlb)
+      cache_ckpt_restore(itlb, fd);
+    if (dtlb)
+      cache_ckpt_restore(dtlb, fd);
+    if (pred)
+      bpred_ckpt_restore(pred, fd);
+    if (bconf)
+      bconf_ckpt_restore(bconf, fd);
+  }
+  ckpt_get_tag(fd, "end");
+  ckpt_close(fd);
+  after_warmup();
+
+  fprintf(outfile, "sim: ** restored checkpoint `%s' at instruction %.0f%s **\n",
+          fname, (double)sim_num_insn,
+          hdr.has_uarch ? ", with warm caches and predictors" : "");
+  fprintf(outfile,
+          "sim: will prime microarchitectural state for further %.0f cycles\n",
+          (double)num_prime_insn - (double)hdr.warmup_insn);
+}
+
 int sim_warmup = FALSE;
 extern void warmup_main(SS_COUNTER_TYPE num_warmup_insn);
+extern void warmup_insts(SS_COUNTER_TYPE num_insn);
+
+/*
+ * Sampled simulation.  Both sampling modes simulate a series of detailed
+ * windows: fast-forward functionally, warming the caches, TLBs and
+ * predictors, to the window's start; simulate in detail, first to warm the
+ * pipeline and then measuring; then stop fetching and let the pipeline
+ * drain before fast-forwarding to the next window.
+ *
+ * SimPoint (-simpoint:file) measures one interval per simulation point.
+ * Each point's change in every scalar stat is scaled to a whole interval
+ * and weighted, and simpoint_print_stats() reports the weighted estimates.
+ *
+ * SMARTS (-smarts:period, Wunderlich et al., ISCA 2003) measures a short
+ * unit at the end of every period, the sampling units being systematic
+ * samples of the whole run.  Each unit's CPI (and any -smarts:stats) goes
+ * into a sampled metric, which reports its mean, variance and confidence
+ * interval; simulation stops once the interval on CPI is narrow enough.
+ * The units measured by then sample only the run so far, so choose a
+ * period that spreads -smarts:min_units units over the whole program.
+ */
+
+/* fast-forward functionally until DEST instructions have committed */
+static void
+sample_fast_forward(SS_COUNTER_TYPE dest)
+{
+  if (sim_num_insn >= dest)
+    return;
+
+  /* functional warming runs on its own clock, see after_warmup() */
+  after_warmup();
+  sim_warmup = TRUE;
+  warmup_insts(dest - sim_num_insn);
+  sim_warmup = FALSE;
+  after_warmup();
+  assert(pred->retstack.caller_supplies_tos ==
+         !!(per_thread_retstack == PerThreadTOSP));
+}
+
+/* allocate the stats snapshot, and fast-forward to the first window */
+static void
+sample_init(void)
+{
+  sample_nstats = stat_num_scalars(sim_sdb);
+  if (!(sample_before = calloc(sample_nstats, sizeof(double))))
+    fatal("out of virtual memory");
+
+  sample_phase = SP_Warm;
+  sample_fast_forward(sample_warm_start);
+}
+
+/* simulation point I's window */
+static void
+simpoint_window(int i)
+{
+  sample_start = simpoints[i].index * simpoint_interval;
+  sample_end = sample_start + simpoint_interval;
+  sample_warm_start = sample_start > (SS_COUNTER_TYPE)simpoint_warm_insn
+                          ? sample_start - simpoint_warm_insn
+                          : 0;
+}
+
+/* add the change in every scalar stat since the current point's
+   measurement began, scaled to a whole interval and weighted by WEIGHT, to
+   EST */
+static void
+simpoint_accumulate(double *est, double weight)
+{
+  double *now, scale;
+  int i;
+
+  if (!(now = calloc(sample_nstats, sizeof(double))))
+    fatal("out of virtual memory");
+  stat_get_scalars(sim_sdb, now);
+
+  scale = weight * (double)simpoint_interval /
+          (double)(sim_num_insn - sample_before_insn);
+  for (i = 0; i < sample_nstats; i++)
+    est[i] += scale * (now[i] - sample_before[i]);
+
+  free(now);
+}
+
+/* fast-forward to the first simulation point */
+static void
+simpoint_init(void)
+{
+  fprintf(outfile, "sim: ** sampling %d simulation points of %.0f "
+                   "instructions, each after %u detailed warmup insts **\n",
+          simpoint_num, (double)simpoint_interval, simpoint_warm_insn);
+
+  simpoint_cur = 0;
+  simpoint_window(0);
+  sample_init();
+  if (!(simpoint_est = calloc(sample_nstats, sizeof(double))))
+    fatal("out of virtual memory");
+}
+
+/* the current simulation point has been measured; returns FALSE if it was
+   the last */
+static int
+simpoint_done(void)
+{
+  simpoint_accumulate(simpoint_est, simpoints[simpoint_cur].weight);
+  simpoint_weight += simpoints[simpoint_cur].weight;
+  if (++simpoint_cur == simpoint_num)
+    return FALSE;
+
+  simpoint_window(simpoint_cur);
+  return TRUE;
+}
+
+/* sampling unit I's window, at the end of period I */
+static void
+smarts_window(SS_COUNTER_TYPE i)
+{
+  sample_end = (i + 1) * smarts_period;
+  sample_start = sample_end - smarts_unit;
+  sample_warm_start = sample_start - smarts_warm;
+}
+
+/* fast-forward to the first sampling unit */
+static void
+smarts_init(void)
+{
+  fprintf(outfile, "sim: ** sampling a unit of %u instructions every %u, "
+                   "each after %u detailed warmup insts **\n",
+          smarts_unit, smarts_period, smarts_warm);
+  if (smarts_ci > 0.0)
+    fprintf(outfile, "sim: will stop once CPI is within %g%% at %g%% "
+                     "confidence, after at least %u units\n",
+            smarts_ci, smarts_confidence, smarts_min_units);
+
+  smarts_cur = 0;
+  smarts_window(0);
+  sample_init();
+}
+
+/* the current sampling unit has been measured: sample each metric over the
+   unit; returns FALSE once CPI is known closely enough */
+static int
+smarts_done(void)
+{
+  double *now, *delta, val, cpi, ci;
+  int i;
+
+  if (!(now = calloc(sample_nstats, sizeof(double))) ||
+      !(delta = calloc(sample_nstats, sizeof(double))))
+    fatal("out of virtual memory");
+
+  /* evaluate the metrics, formulas included, on the unit's change in every
+   * scalar stat; metrics undefined for this unit (e.g., a miss rate with no
+   * accesses) get no sample */
+  stat_get_scalars(sim_sdb, now);
+  for (i = 0; i < sample_nstats; i++)
+    delta[i] = now[i] - sample_before[i];
+  stat_set_scalars(sim_sdb, delta);
+  for (i = 0; i < smarts_nmetrics; i++)
+    if (stat_value(sim_sdb, smarts_metric[i], &val))
+      stat_sample_add(smarts_sample[i], val);
+  stat_set_scalars(sim_sdb, now);
+
+  free(now);
+  free(delta);
+
+  smarts_window(++smarts_cur);
+
+  cpi = stat_sample_mean(smarts_sample[0]);
+  ci = stat_sample_ci(smarts_sample[0]);
+  if (smarts_ci > 0.0 && smarts_cur >= smarts_min_units && cpi > 0.0
+      && ci <= cpi * smarts_ci / 100.0)
+  {
+    fprintf(outfile, "sim: ** CPI %.4f +/- %.2f%% at %g%% confidence "
+                     "after %.0f sampling units, stopping **\n",
+            cpi, 100.0 * ci / cpi, smarts_confidence, (double)smarts_cur);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* the only thread left once the pipeline has drained */
+static int
+sample_live_thread(void)
+{
+  int t, live = -1;
+
+  for (t = 0; t < N_THREAD_RECS; t++)
+    if (thread_info[t].valid == TRUE && thread_info[t].squashed != TRUE)
+    {
+      if (live >= 0)
+        panic("threads %d and %d both live after draining", live, t);
+      live = t;
+    }
+  if (live < 0)
+    panic("no live thread after draining");
+
+  return live;
+}
+
+/* called every cycle: move the current window between phases, and on to
+   the next window */
+static void
+sample_step(void)
+{
+  int t;
+
+  switch (sample_phase)
+  {
+  case SP_Warm:
+    if (sim_num_insn >= sample_start)
+    {
+      stat_get_scalars(sim_sdb, sample_before);
+      sample_before_insn = sim_num_insn;
+      sample_phase = SP_Measure;
+    }
+    break;
+
+  case SP_Measure:
+    if (sim_num_insn < sample_end)
+      break;
+
+    if (!(simpoint_num ? simpoint_done() : smarts_done()))
+      exit_now(0);
+
+    /* windows close together are simulated in detail throughout */
+    if (sim_num_insn >= sample_warm_start)
+      sample_phase = SP_Warm;
+    else
+    {
+      fetch_stopped = TRUE;
+      sample_phase = SP_Drain;
+    }
+    break;
+
+  case SP_Drain:
+    if (RUU_num != 0 || LSQ_num != 0 || ifq_num != 0)
+      break;
+
+    /* correct-path insts execute at dispatch, so with the pipeline empty
+     * the architected state is complete up to the live thread's fetch PC */
+    t = sample_live_thread();
+    regs_PC = thread_info[t].fetch_pred_PC;
+    sample_fast_forward(sample_warm_start);
+    thread_info[t].fetch_regs_PC = regs_PC - sizeof(SS_INST_TYPE);
+    thread_info[t].fetch_pred_PC = regs_PC;
+
+    fetch_stopped = FALSE;
+    sample_phase = SP_Warm;
+    break;
+  }
+}
+
+/* host-dependent stats, meaningless when scaled */
+static char *simpoint_host_stats[] = {
+  "sim_elapsed_time", "sim_inst_rate", "sim_cycle_rate", "sim_host_maxrss",
+  NULL
+};
+
+/* print the weighted estimate of every stat, including the point still
+   being measured if the program ended within it */
+static void
+simpoint_print_stats(FILE *stream)
+{
+  struct stat_stat_t *stat;
+  double *est, *now, weight = simpoint_weight;
+  int i, measured = simpoint_cur;
+
+  if (!(est = calloc(sample_nstats, sizeof(double))) ||
+      !(now = calloc(sample_nstats, sizeof(double))))
+    fatal("out of virtual memory");
+  memcpy(est, simpoint_est, sample_nstats * sizeof(double));
+  if (sample_phase == SP_Measure && sim_num_insn > sample_before_insn)
+  {
+    simpoint_accumulate(est, simpoints[simpoint_cur].weight);
+    weight += simpoints[simpoint_cur].weight;
+    measured++;
+  }
+
+  fprintf(stream, "\nsim: ** SimPoint estimates: %d of %d simulation points, "
+                  "weighted and scaled to one %.0f-instruction interval **\n",
+          measured, simpoint_num, (double)simpoint_interval);
+  if (weight <= 0.0)
+  {
+    fprintf(stream, "no simulation points measured\n");
+    free(est);
+    free(now);
+    return;
+  }
+
+  /* print the estimates through the stats database, so formulas (IPC,
+   * miss rates, ...) are computed from them too */
+  for (i = 0; i < sample_nstats; i++)
+    est[i] /= weight;
+  stat_get_scalars(sim_sdb, now);
+  stat_set_scalars(sim_sdb, est);
+  for (stat = sim_sdb->stats; stat != NULL; stat = stat->next)
+  {
+    if (stat->sc == sc_dist || stat->sc == sc_sdist)
+      continue;
+    for (i = 0; simpoint_host_stats[i]; i++)
+      if (!strcmp(stat->name, simpoint_host_stats[i]))
+        break;
+    if (!simpoint_host_stats[i])
+      stat_print_stat(sim_sdb, stat, stream);
+  }
+  stat_set_scalars(sim_sdb, now);
+
+  free(est);
+  free(now);
+}
+
+/* host time stamp counter, for timing the pipeline stages; it only has to
+   be cheap and monotonic, prof_print_stats() converts it to time */
+static INLINE unsigned long long
+host_ticks(void)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+  return __rdtsc();
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/* host time, in ns */
+static double
+host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* start timing the pipeline stages */
+static void
+prof_start(void)
+{
+  prof_start_cycle = sim_cycle;
+  prof_start_insn = sim_num_insn;
+  prof_start_ns = host_ns();
+  prof_start_ticks = host_ticks();
+}
+
+/* print the host time spent per simulated cycle in each pipeline stage,
+   and in the rest of the main loop, since prof_start(); the ticks are
+   converted with the host time that passed over the same span */
+static void
+prof_print_stats(FILE *stream)
+{
+  unsigned long long ticks = host_ticks() - prof_start_ticks, staged = 0;
+  double ns = host_ns() - prof_start_ns, ns_per_tick, cycles, insts;
+  char name[64];
+  int i;
+
+  cycles = (double)(sim_cycle - prof_start_cycle);
+  insts = (double)(sim_num_insn - prof_start_insn);
+  if (cycles <= 0.0 || ticks == 0 || ns <= 0.0)
+    return;
+  ns_per_tick = ns / (double)ticks;
+
+  fprintf(stream, "\nsim: ** pipeline stage profile: %.0f cycles, "
+                  "%.3f host seconds **\n", cycles, ns / 1e9);
+  for (i = 0; i < PS_NUM; i++)
+  {
+    staged += prof_ticks[i];
+    sprintf(name, "prof.%s.ns", prof_stage_names[i]);
+    fprintf(stream, "%-30s %12.2f # host ns per simulated cycle\n", name,
+            (double)prof_ticks[i] * ns_per_tick / cycles);
+    sprintf(name, "prof.%s.calls", prof_stage_names[i]);
+    fprintf(stream, "%-30s %12.0f # number of calls\n", name,
+            (double)prof_calls[i]);
+  }
+  fprintf(stream, "%-30s %12.2f # host ns per simulated cycle outside the "
+                  "stages\n", "prof.other.ns",
+          (double)(ticks > staged ? ticks - staged : 0) * ns_per_tick / cycles);
+  fprintf(stream, "%-30s %12.2f # host ns per simulated cycle\n",
+          "prof.cycle.ns", ns / cycles);
+  fprintf(stream, "%-30s %12.0f # simulated insts per host second\n",
+          "prof.inst_rate", insts / (ns / 1e9));
+  fprintf(stream, "%-30s %12.0f # simulated cycles per host second\n",
+          "prof.cycle_rate", cycles / (ns / 1e9));
+}
 
 /* start simulation, program loaded, processor precise state initialized */
 void sim_main(void)
@@ -9604,7 +11291,13 @@ void sim_main(void)
    * then be primed for POST_WARMUP_PRIME insts, and then "real"
    * simulation will proceed for num_fullsim_insn.
    */
-  if (num_warmup_insn > 0)
+  if (ckpt_restore_fname)
+    sim_ckpt_restore(ckpt_restore_fname);
+  else if (simpoint_num)
+    simpoint_init();
+  else if (smarts_period)
+    smarts_init();
+  else if (num_warmup_insn > 0)
   {
     /* regs_PC should have been initialized in regs_init() */
 
@@ -9619,6 +11312,8 @@ void sim_main(void)
     after_warmup();
     assert(pred->retstack.caller_supplies_tos ==
            !!(per_thread_retstack == PerThreadTOSP));
+    if (ckpt_save_fname)
+      sim_ckpt_save(ckpt_save_fname);
     fprintf(outfile,
             "sim: will prime microarchitectural state for further %d cycles\n",
             num_prime_insn - num_warmup_insn);
@@ -9637,6 +11332,15 @@ void sim_main(void)
   thread_info[INIT_THREAD].fetch_regs_PC = regs_PC - sizeof(SS_INST_TYPE);
   thread_info[INIT_THREAD].fetch_pred_PC = regs_PC;
 
+  if (stats_series_fname)
+  {
+    stats_series = tseries_open(stats_series_fname, sim_sdb, stats_interval,
+                                stats_by_insts);
+    stats_next_sample =
+      ((stats_by_insts ? sim_num_insn : sim_cycle) / stats_interval + 1)
+      * stats_interval;
+  }
+
   /* we no longer use regs_PC except for pipetracing, instead using the 
    * thread_info records. Instructions will still set regs_PC, since 
    * instructions are defined in ss.def, common to all the simulators.
@@ -9644,6 +11348,9 @@ void sim_main(void)
    * chooses which thread(s) to fetch from; after that all insts are tagged
    * with thread id as they flow through the machine. */
 
+  if (profile_stages)
+    prof_start();
+
   /*
    * main simulator loop, NOTE: the pipe stages are traversed in reverse order
    * to eliminate this/next state synchronization and relaxation problems 
@@ -9664,11 +11371,25 @@ void sim_main(void)
       after_priming();
     }
 
+    /* Decide whether to move on in sampling */
+    if (simpoint_num || smarts_period)
+      sample_step();
+
     /* Decide whether we've finished executing */
     if (num_fullsim_insn != 0)
       if ((sim_num_insn >= (num_prime_insn + num_fullsim_insn)) || sim_exit_now)
         exit_now(0);
 
+    /* Decide whether to sample the stats time series */
+    if (stats_series
+        && (stats_by_insts ? sim_num_insn : sim_cycle) >= stats_next_sample)
+    {
+      tseries_sample(stats_series, sim_cycle, sim_num_insn);
+      stats_next_sample =
+        ((stats_by_insts ? sim_num_insn : sim_cycle) / stats_interval + 1)
+        * stats_interval;
+    }
+
     /* Decide whether to dump intermediate stats */
     if (sim_dump_stats)
     {
@@ -9704,37 +11425,50 @@ void sim_main(void)
        */
 
     /* commit entries from RUU/LSQ to architected register file */
+    PROF_BEGIN();
     ruu_commit();
+    PROF_END(PS_Commit);
 
     /* service function unit release events */
     if (!infinite_fu)
+    {
       ruu_release_fu();
+      PROF_END(PS_ReleaseFU);
+    }
 
     /* ==> may have ready queue entries carried over from previous cycles */
 
     /* service result completions, also readies dependent operations */
     /* ==> inserts operations into ready queue --> register deps resolved */
     ruu_writeback();
+    PROF_END(PS_Writeback);
 
     /* try to locate memory operations that are ready to execute */
     /* ==> inserts operations into ready queue --> mem deps resolved */
     lsq_refresh();
+    PROF_END(PS_LSQRefresh);
 
     /* issue operations ready to execute from a previous cycle */
     /* <== drains ready queue <-- ready operations commence execution */
     ruu_issue();
+    PROF_END(PS_Issue);
 
     /* decode and dispatch new operations */
     /* ==> insert ops w/ no deps or all regs ready --> reg deps resolved */
     ruu_dispatch();
+    PROF_END(PS_Dispatch);
 
     /* fetch new instructions
        * ==> insert ops into IFQ */
     ruu_fetch_wrapper();
+    PROF_END(PS_Fetch);
 
     /* kill squashed threads that no longer have any active instructions */
     if (max_threads > 1)
+    {
       kill_threads();
+      PROF_END(PS_KillThreads);
+    }
     else
       assert(thread_info[INIT_THREAD].valid == TRUE);
 
@@ -9744,5 +11478,9 @@ void sim_main(void)
     /* cache_dl1 port bookkeeping */
     assert(cache_dl1_ports_reserved <= cache_dl1_ports && cache_dl1_ports_used <= cache_dl1_ports);
     cache_dl1_ports_used = cache_dl1_ports_reserved;
+
+    /* skip ahead if the pipeline is stalled */
+    if (skip_idle)
+      idle_skip();
   }
 }
@@ -110,6 +110,7 @@
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #ifdef BFD_LOADER
 #include <bfd.h>
 #endif /* BFD_LOADER */
@@ -151,6 +152,9 @@ time_t sim_start_time;
 time_t sim_end_time;
 time_t sim_elapsed_time;
 
+/* peak host memory (resident set) used, in kilobytes */
+int sim_host_maxrss;
+
 /* byte/word swapping required to execute target executable on this host */
 int sim_swap_bytes;
 int sim_swap_words;
@@ -202,6 +206,7 @@ static int running = FALSE;
 void
 sim_print_stats(FILE *fd)		/* output stream */
 {
+  struct rusage ru;
 
   if (!running)
     return;
@@ -209,6 +214,8 @@ sim_print_stats(FILE *fd)		/* output stream */
   /* get stats time */
   sim_end_time = time((time_t *)NULL);
   sim_elapsed_time = MAX(sim_end_time - sim_start_time, 1);
+  if (!getrusage(RUSAGE_SELF, &ru))
+    sim_host_maxrss = ru.ru_maxrss;
 
   /* print simulation stats */
   fprintf(fd, "\nsim: ** simulation statistics **\n");
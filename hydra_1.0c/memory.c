@@ -87,6 +87,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include "misc.h"
 #include "ss.h"
 #include "loader.h"
@@ -302,6 +305,121 @@ mem_bzero(mem_access_fn mem_fn,		/* user-specified memory accessor */
     mem_fn(Write, addr++, &c, 1);
 }
 
+/* pieces of the last mem_iovec(Write, ...) range whose pages were not
+   allocated yet: they are read into IOV_SCRATCH, and only the bytes that
+   arrive are copied into simulated memory by mem_iovec_done(), so a short
+   read() allocates no more pages than mem_access() would have */
+static struct iov_pending
+{
+  SS_ADDR_TYPE addr;		/* target address of the piece */
+  char *buf;			/* where in IOV_SCRATCH it was read to */
+  int len;
+} *iov_pending = NULL;
+static int iov_npending = 0, iov_max_pending = 0;
+static char *iov_scratch = NULL;
+static int iov_scratch_sz = 0;
+
+/* map the NBYTES of simulated memory at ADDR onto host memory, so that
+   I/O can go directly to or from it: fills in IOV with one piece per page
+   the range spans, allocating pages on first touch as mem_access() does,
+   except that for a Write the pages not yet allocated are only allocated
+   by mem_iovec_done() for the bytes actually written; returns the number
+   of pieces, or -1 if any of the range is not accessible to CMD or it
+   spans more than MAXIOV pages */
+int
+mem_iovec(enum mem_cmd cmd,		/* Read (from sim mem) or Write */
+	  SS_ADDR_TYPE addr,		/* target address to access */
+	  int nbytes,			/* number of bytes to access */
+	  struct iovec *iov,		/* host memory pieces, output */
+	  int maxiov)			/* most pieces IOV can hold */
+{
+  SS_ADDR_TYPE end = addr + nbytes;
+  int n, len, scratch_used = 0;
+
+  iov_npending = 0;
+
+  if (nbytes <= 0)
+    return nbytes == 0 ? 0 : -1;
+
+  /* same permission checks as mem_access(), over the whole range */
+  if (end < addr
+      || !((addr >= ld_text_base && end <= (ld_text_base+ld_text_size)
+	    && cmd == Read)
+	   || (addr >= ld_data_base && end <= ld_stack_base)))
+    return -1;
+
+  if (MEM_BLOCK(end - 1) - MEM_BLOCK(addr) + 1 > maxiov)
+    return -1;
+
+  if (cmd == Write)
+    {
+      if (maxiov > iov_max_pending)
+	{
+	  iov_pending = (struct iov_pending *)
+	    realloc(iov_pending, maxiov * sizeof(struct iov_pending));
+	  if (!iov_pending)
+	    fatal("out of virtual memory");
+	  iov_max_pending = maxiov;
+	}
+      if (nbytes > iov_scratch_sz)
+	{
+	  free(iov_scratch);
+	  iov_scratch = (char *)malloc(nbytes);
+	  if (!iov_scratch)
+	    fatal("out of virtual memory");
+	  iov_scratch_sz = nbytes;
+	}
+    }
+
+  for (n = 0; addr != end; n++)
+    {
+      len = MIN(end - addr, MEM_BLOCK_SIZE - MEM_OFFSET(addr));
+      if (cmd == Write && !mem_table[MEM_BLOCK(addr)])
+	{
+	  iov[n].iov_base = iov_scratch + scratch_used;
+	  iov_pending[iov_npending].addr = addr;
+	  iov_pending[iov_npending].buf = iov_scratch + scratch_used;
+	  iov_pending[iov_npending].len = len;
+	  iov_npending++;
+	  scratch_used += len;
+	}
+      else
+	{
+	  __MEM_TICKLE(addr);
+	  iov[n].iov_base = mem_table[MEM_BLOCK(addr)] + MEM_OFFSET(addr);
+	}
+      iov[n].iov_len = len;
+      addr += len;
+    }
+  return n;
+}
+
+/* account for an access of the NBYTES at ADDR made through mem_iovec(), as
+   mem_access() would have for each byte; for a Write, this stores the bytes
+   that went to pages not allocated yet */
+void
+mem_iovec_done(SS_ADDR_TYPE addr,	/* target address accessed */
+	       int nbytes)		/* number of bytes accessed */
+{
+  SS_ADDR_TYPE lo = (addr > mem_brk_point) ? addr : mem_brk_point + 1;
+  struct iov_pending *p;
+  int i, len;
+
+  /* track the minimum SP for memory access stats */
+  if (nbytes > 0 && lo < addr + nbytes && lo < mem_stack_min)
+    mem_stack_min = lo;
+
+  for (i = 0, p = iov_pending; i < iov_npending; i++, p++)
+    {
+      len = MIN(p->len, (int)(addr + nbytes - p->addr));
+      if (len <= 0)
+	break;
+      __MEM_TICKLE(p->addr);
+      memcpy(mem_table[MEM_BLOCK(p->addr)] + MEM_OFFSET(p->addr), p->buf, len);
+    }
+  iov_npending = 0;
+}
+
 /* register memory system-specific options */
 void
 mem_reg_options(struct opt_odb_t *odb)	/* option data base */
@@ -349,6 +349,28 @@ mem_bzero(mem_access_fn mem_fn,		/* user-specified memory accessor */
 	  SS_ADDR_TYPE addr,		/* target address to access */
 	  int nbytes);			/* number of bytes to clear */
 
+/* map the NBYTES of simulated memory at ADDR onto host memory, so that
+   I/O can go directly to or from it (e.g. with readv()/writev()): fills in
+   IOV with one piece per page the range spans, allocating pages on first
+   touch as mem_access() does, except that for a Write the pages not yet
+   allocated are only allocated by mem_iovec_done() for the bytes actually
+   written; returns the number of pieces, or -1 if any of the range is not
+   accessible to CMD or it spans more than MAXIOV pages */
+struct iovec;
+int
+mem_iovec(enum mem_cmd cmd,		/* Read (from sim mem) or Write */
+	  SS_ADDR_TYPE addr,		/* target address to access */
+	  int nbytes,			/* number of bytes to access */
+	  struct iovec *iov,		/* host memory pieces, output */
+	  int maxiov);			/* most pieces IOV can hold */
+
+/* account for an access of the NBYTES at ADDR made through mem_iovec(), as
+   mem_access() would have for each byte; for a Write, this stores the bytes
+   that went to pages not allocated yet */
+void
+mem_iovec_done(SS_ADDR_TYPE addr,	/* target address accessed */
+	       int nbytes);		/* number of bytes accessed */
+
 /* register memory system-specific options */
 void
 mem_reg_options(struct opt_odb_t *odb);	/* options data base */
@@ -919,7 +919,9 @@ process_option(struct opt_odb_t *odb,	/* option database */
 	      fatal("could not parse argument `%s' of option `%s'",
 		    argv[index], opt->name);
 	    }
-	  if (tmp < FLT_MIN || tmp > FLT_MAX)
+	  if (tmp != 0.0
+	      && (tmp > FLT_MAX || tmp < -FLT_MAX
+		  || (tmp < FLT_MIN && tmp > -FLT_MIN)))
 	    {
 	      /* over/underflow */
 	      fatal("FP over/underflow for argument `%s' of option `%s'",
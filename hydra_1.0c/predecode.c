@@ -0,0 +1,133 @@
+/*
+ * predecode.c - pre-decoded instruction cache for the functional engines
+ *
+ * This file is a part of the SimpleScalar tool suite, and is distributed
+ * under the same terms as the rest of the tool suite; see the copyright
+ * notice in any of the original SimpleScalar sources.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "misc.h"
+#include "ss.h"
+#include "memory.h"
+#include "loader.h"
+#include "predecode.h"
+
+/* hash table buckets, a power of two */
+#define PD_HTAB_SZ		4096
+
+/* hash a block's starting PC */
+#define PD_HASH(PC)		((((PC) >> 3) * 2654435761u) & (PD_HTAB_SZ - 1))
+
+/* a pre-decode cache */
+struct pd_cache_t
+{
+  void **handlers;		/* per-opcode engine code, or NULL */
+  unsigned int version;		/* pd_text_version the blocks were decoded in */
+  struct pd_block_t *htab[PD_HTAB_SZ];
+};
+
+/* bumped whenever the text segment is replaced */
+static unsigned int pd_text_version = 0;
+
+/* create a pre-decode cache; if HANDLERS is non-NULL, each instruction's
+   handler is HANDLERS[<its opcode>] */
+struct pd_cache_t *
+pd_create(void **handlers)
+{
+  struct pd_cache_t *pd;
+
+  if (!(pd = calloc(1, sizeof(struct pd_cache_t))))
+    fatal("out of virtual memory");
+  pd->handlers = handlers;
+  pd->version = pd_text_version;
+
+  return pd;
+}
+
+/* decode the block starting at PC */
+static struct pd_block_t *
+pd_decode(struct pd_cache_t *pd, SS_ADDR_TYPE pc)
+{
+  struct pd_inst_t insts[PD_BLOCK_INSTS], *di;
+  struct pd_block_t *blk;
+  int n = 0;
+
+  do
+    {
+      di = &insts[n++];
+      mem_access(Read, pc, &di->inst, SS_INST_SIZE);
+      di->pc = pc;
+      di->op = SS_OPCODE(di->inst);
+      if (di->op >= OP_MAX)
+	di->op = OP_NA;
+      di->flags = SS_OP_FLAGS(di->op);
+      di->handler = pd->handlers ? pd->handlers[di->op] : NULL;
+      pc += SS_INST_SIZE;
+    }
+  while (!(di->flags & (F_CTRL|F_TRAP))
+	 && di->op != OP_NA
+	 && n < PD_BLOCK_INSTS
+	 && pc < ld_text_base + ld_text_size);
+
+  blk = malloc(sizeof(struct pd_block_t) + (n - 1) * sizeof(struct pd_inst_t));
+  if (!blk)
+    fatal("out of virtual memory");
+  blk->ninsts = n;
+  memcpy(blk->insts, insts, n * sizeof(struct pd_inst_t));
+
+  return blk;
+}
+
+/* return the decoded block starting at PC, decoding it on a miss */
+struct pd_block_t *
+pd_lookup(struct pd_cache_t *pd, SS_ADDR_TYPE pc)
+{
+  struct pd_block_t *blk, **bucket;
+
+  if (pd->version != pd_text_version)
+    {
+      pd_flush(pd);
+      pd->version = pd_text_version;
+    }
+
+  bucket = &pd->htab[PD_HASH(pc)];
+  for (blk = *bucket; blk; blk = blk->next)
+    if (blk->insts[0].pc == pc)
+      return blk;
+
+  blk = pd_decode(pd, pc);
+  blk->next = *bucket;
+  *bucket = blk;
+  return blk;
+}
+
+/* discard every decoded block in PD */
+void
+pd_flush(struct pd_cache_t *pd)
+{
+  struct pd_block_t *blk, *next;
+  int i;
+
+  for (i = 0; i < PD_HTAB_SZ; i++)
+    {
+      for (blk = pd->htab[i]; blk; blk = next)
+	{
+	  next = blk->next;
+	  free(blk);
+	}
+      pd->htab[i] = NULL;
+    }
+}
+
+/* note that the text segment has been replaced, so that every pre-decode
+   cache discards its blocks before the next lookup */
+void
+pd_text_changed(void)
+{
+  pd_text_version++;
+}
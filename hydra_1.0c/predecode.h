@@ -0,0 +1,73 @@
+/*
+ * predecode.h - pre-decoded instruction cache for the functional engines
+ *
+ * This file is a part of the SimpleScalar tool suite, and is distributed
+ * under the same terms as the rest of the tool suite; see the copyright
+ * notice in any of the original SimpleScalar sources.
+ *
+ */
+
+#ifndef PREDECODE_H
+#define PREDECODE_H
+
+#include "ss.h"
+
+/*
+ * A functional engine that executes the same code over and over (warmup
+ * and fast-forward in hydra) need not fetch each instruction from simulated
+ * memory and look up its opcode and flags every time.  The pre-decode cache
+ * holds basic blocks, keyed by the address of their first instruction, each
+ * instruction already decoded and paired with the engine's code for its
+ * opcode, so the engine can run a block by jumping from one handler to the
+ * next (threaded code).  A block runs up to and including a control
+ * transfer or trap, or PD_BLOCK_INSTS instructions.
+ *
+ * Decoded blocks are only valid while the text segment is unchanged.
+ * Simulated programs cannot write it (mem_access() and mem_valid() treat
+ * that as a segmentation violation), so anything else that replaces it,
+ * such as restoring a checkpoint, calls pd_text_changed().
+ */
+
+/* most instructions in a pre-decoded block */
+#define PD_BLOCK_INSTS		32
+
+/* a pre-decoded instruction */
+struct pd_inst_t
+{
+  SS_INST_TYPE inst;		/* the instruction, for its operand fields */
+  SS_ADDR_TYPE pc;		/* its address */
+  enum ss_opcode op;		/* its opcode */
+  unsigned int flags;		/* SS_OP_FLAGS(op) */
+  void *handler;		/* the engine's code for OP, see pd_create() */
+};
+
+/* a pre-decoded basic block */
+struct pd_block_t
+{
+  struct pd_block_t *next;	/* next block in hash chain */
+  int ninsts;			/* number of instructions */
+  struct pd_inst_t insts[1];	/* the instructions, NINSTS of them */
+};
+
+/* a pre-decode cache */
+struct pd_cache_t;
+
+/* create a pre-decode cache; if HANDLERS is non-NULL, each instruction's
+   handler is HANDLERS[<its opcode>] */
+struct pd_cache_t *
+pd_create(void **handlers);
+
+/* return the decoded block starting at PC, decoding it on a miss */
+struct pd_block_t *
+pd_lookup(struct pd_cache_t *pd, SS_ADDR_TYPE pc);
+
+/* discard every decoded block in PD */
+void
+pd_flush(struct pd_cache_t *pd);
+
+/* note that the text segment has been replaced, so that every pre-decode
+   cache discards its blocks before the next lookup */
+void
+pd_text_changed(void);
+
+#endif /* PREDECODE_H */
@@ -0,0 +1,173 @@
+/*
+ * ptrace-read.c - convert a binary pipetrace to the text format
+ *
+ * This file is a part of the SimpleScalar tool suite, and is distributed
+ * under the same terms as the rest of the tool suite; see the copyright
+ * notice in any of the original SimpleScalar sources.
+ *
+ * usage: ptrace-read [-t <thread>] [-pc <start>:<end>] [-cycle <start>:<end>]
+ *		      [-o <fname>] <trace>
+ *
+ * Reads a binary pipetrace (written with a `b' level, e.g. -ptrace 4b) and
+ * prints it in the text format pipeview.pl reads, optionally only the
+ * events of one thread, of instructions whose PC is in [start, end), or of
+ * cycles in [start, end).  Either end of a range may be omitted.  The trace
+ * is streamed, and reading stops at the end of the cycle window.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "misc.h"
+#include "ss.h"
+#include "sim.h"
+
+/* just the pipetrace printers and reader */
+#define PTRACE_READER_ONLY
+#include "ptrace.c"
+
+/* instructions remembered for PC filtering, a power of two; this only has
+   to exceed the number of instructions in flight */
+#define PC_MAP_SZ	65536
+
+/* the PC of an instruction in flight, by sequence number */
+static struct {
+  unsigned int iseq;
+  SS_ADDR_TYPE pc;
+  int valid;
+} pc_map[PC_MAP_SZ];
+
+static void
+usage(char *prog)
+{
+  fprintf(stderr,
+	  "usage: %s [-t <thread>] [-pc <start>:<end>] "
+	  "[-cycle <start>:<end>] [-o <fname>] <trace>\n", prog);
+  exit(1);
+}
+
+/* parse range STR, `{<start>}:{<end>}', into *START and *END */
+static void
+parse_range(char *prog, char *str, double *start, double *end)
+{
+  char *colon = strchr(str, ':'), *p;
+
+  if (!colon)
+    usage(prog);
+
+  *start = 0;
+  *end = 1e300;
+  if (colon != str)
+    {
+      *start = (double)strtoul(str, &p, 0);
+      if (p != colon)
+	usage(prog);
+    }
+  if (colon[1] != '\0')
+    {
+      *end = (double)strtoul(colon + 1, &p, 0);
+      if (*p != '\0')
+	usage(prog);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+  struct ptrace_reader *rd;
+  struct ptrace_event ev;
+  FILE *out = NULL;
+  char *fname = NULL;
+  int i, level, slot, thread = -1, by_pc = FALSE;
+  double pc_start = 0, pc_end = 0, cyc_start = 0, cyc_end = 1e300;
+
+  /* where fatal() reports */
+  outfile = stderr;
+
+  for (i = 1; i < argc; i++)
+    {
+      if (!strcmp(argv[i], "-t") && i + 1 < argc)
+	thread = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "-pc") && i + 1 < argc)
+	{
+	  parse_range(argv[0], argv[++i], &pc_start, &pc_end);
+	  by_pc = TRUE;
+	}
+      else if (!strcmp(argv[i], "-cycle") && i + 1 < argc)
+	parse_range(argv[0], argv[++i], &cyc_start, &cyc_end);
+      else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+	{
+	  out = fopen(argv[++i], "w");
+	  if (!out)
+	    fatal("cannot open output file `%s'", argv[i]);
+	}
+      else if (argv[i][0] != '-' && !fname)
+	fname = argv[i];
+      else
+	usage(argv[0]);
+    }
+  if (!fname)
+    usage(argv[0]);
+
+  /* the trace printers flush stdout after each line, so print through a
+     separate stream */
+  if (!out && !(out = fdopen(dup(fileno(stdout)), "w")))
+    fatal("cannot open standard output");
+
+  rd = ptrace_reader_open(fname);
+  if (!rd)
+    fatal("cannot open pipetrace `%s'", fname);
+  level = ptrace_reader_level(rd);
+
+  while (ptrace_reader_next(rd, &ev))
+    {
+      if ((double)ev.cycle >= cyc_end)
+	break;
+
+      slot = ev.iseq & (PC_MAP_SZ - 1);
+      if (ev.type == PTR_NEWINST || ev.type == PTR_NEWUOP)
+	{
+	  pc_map[slot].iseq = ev.iseq;
+	  pc_map[slot].pc = ev.w[0];
+	  pc_map[slot].valid = TRUE;
+	}
+
+      if ((double)ev.cycle < cyc_start)
+	continue;
+
+      switch (ev.type)
+	{
+	case PTR_NEWCYCLE:
+	case PTR_OVERFLOW:
+	  /* not specific to a thread or instruction */
+	  break;
+
+	case PTR_NEWTHREAD:
+	case PTR_SQUASHTHREAD:
+	case PTR_KILLTHREAD:
+	  if (thread >= 0 && ev.thread != thread)
+	    continue;
+	  break;
+
+	default:
+	  if (thread >= 0 && ev.thread != thread)
+	    continue;
+	  if (by_pc
+	      && (!pc_map[slot].valid || pc_map[slot].iseq != ev.iseq
+		  || (double)pc_map[slot].pc < pc_start
+		  || (double)pc_map[slot].pc >= pc_end))
+	    continue;
+	  break;
+	}
+
+      ptrace_print_event(out, level, &ev);
+    }
+
+  ptrace_reader_close(rd);
+  fclose(out);
+
+  return 0;
+}
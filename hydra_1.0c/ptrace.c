@@ -114,6 +114,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/* PTRACE_READER_ONLY builds just the event printers and the binary trace
+   reader, without ptrace_open() and the binary writer, for tools such as
+   ptrace-read that include this file */
+#ifdef PTRACE_READER_ONLY
+#ifndef PTRACE_NO_THREADS
+#define PTRACE_NO_THREADS
+#endif
+#endif
+
+#ifndef PTRACE_NO_THREADS
+#include <pthread.h>
+#endif
 #include "misc.h"
 #include "ss.h"
 #include "range.h"
@@ -144,6 +158,206 @@ struct range_range_t ptrace_range;
 /* one-shot switch for pipetracing */
 int ptrace_oneshot = FALSE;
 
+/* is the pipetrace binary? */
+int ptrace_binary = FALSE;
+
+/* pipeline stage names, as stored in binary pipetraces */
+char *ptrace_stages[] = {
+  PST_IFETCH, PST_DISPATCH, PST_EXECUTE, PST_WRITEBACK, PST_COMMIT, NULL
+};
+
+/* binary pipetrace records are written and read in blocks of this many */
+#define PTRACE_BLOCK_RECS	32768
+
+#ifndef PTRACE_READER_ONLY
+/*
+ * binary pipetrace writer: records are collected in blocks of
+ * PTRACE_BLOCK_RECS, full blocks are queued (up to PTRACE_NUM_BLOCKS of
+ * them) for the writer thread, which writes them out in order; build with
+ * -DPTRACE_NO_THREADS to write each block as it fills instead
+ */
+#define PTRACE_NUM_BLOCKS	4
+
+/* output file, and its ZFILE if it is not stdout/stderr */
+static FILE *ptb_fd = NULL;
+static ZFILE *ptb_zfd = NULL;
+
+/* record blocks; the length of a block queued for writing, 0 if free */
+static struct ptrace_rec *ptb_blocks[PTRACE_NUM_BLOCKS];
+static int ptb_len[PTRACE_NUM_BLOCKS];
+
+/* block being filled, and the number of records in it */
+static int ptb_cur = 0;
+static int ptb_num = 0;
+
+/* last instruction sequence number and cycle recorded, for deltas */
+static unsigned int ptb_last_seq = 0;
+static SS_TIME_TYPE ptb_last_cycle = 0;
+
+#ifndef PTRACE_NO_THREADS
+/* writer thread, and its hand-off with the simulator */
+static pthread_t ptb_writer;
+static pthread_mutex_t ptb_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ptb_full = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ptb_free = PTHREAD_COND_INITIALIZER;
+static int ptb_done = FALSE;
+
+/* writer thread: write out queued blocks, in order, until told to stop */
+static void *
+ptb_write_blocks(void *arg)
+{
+  int i = 0, len;
+
+  pthread_mutex_lock(&ptb_lock);
+  for (;;)
+    {
+      while (!ptb_len[i] && !ptb_done)
+	pthread_cond_wait(&ptb_full, &ptb_lock);
+      if (!ptb_len[i])
+	break;
+      len = ptb_len[i];
+      pthread_mutex_unlock(&ptb_lock);
+
+      if (fwrite(ptb_blocks[i], sizeof(struct ptrace_rec), len, ptb_fd) != len)
+	fatal("cannot write pipetrace");
+
+      pthread_mutex_lock(&ptb_lock);
+      ptb_len[i] = 0;
+      pthread_cond_signal(&ptb_free);
+      i = (i + 1) % PTRACE_NUM_BLOCKS;
+    }
+  pthread_mutex_unlock(&ptb_lock);
+
+  return NULL;
+}
+#endif /* !PTRACE_NO_THREADS */
+
+/* hand the block being filled to the writer, and start on the next one */
+static void
+ptb_flush(void)
+{
+#ifndef PTRACE_NO_THREADS
+  int next = (ptb_cur + 1) % PTRACE_NUM_BLOCKS;
+
+  pthread_mutex_lock(&ptb_lock);
+  ptb_len[ptb_cur] = ptb_num;
+  pthread_cond_signal(&ptb_full);
+  while (ptb_len[next])
+    pthread_cond_wait(&ptb_free, &ptb_lock);
+  pthread_mutex_unlock(&ptb_lock);
+  ptb_cur = next;
+#else /* PTRACE_NO_THREADS */
+  if (fwrite(ptb_blocks[ptb_cur], sizeof(struct ptrace_rec), ptb_num, ptb_fd)
+      != ptb_num)
+    fatal("cannot write pipetrace");
+#endif
+  ptb_num = 0;
+}
+
+/* start a new binary pipetrace record of type TYPE */
+static struct ptrace_rec *
+ptb_new(enum ptrace_rec_type type,	/* record type */
+	int thread,			/* thread id */
+	unsigned int iseq)		/* instruction sequence number */
+{
+  struct ptrace_rec *rec;
+
+  if (ptb_num == PTRACE_BLOCK_RECS)
+    ptb_flush();
+  rec = &ptb_blocks[ptb_cur][ptb_num++];
+
+  rec->type = type;
+  rec->thread = thread;
+  rec->arg = 0;
+  rec->dseq = (int)(iseq - ptb_last_seq);
+  ptb_last_seq = iseq;
+  rec->w[0] = rec->w[1] = rec->w[2] = rec->w[3] = 0;
+
+  return rec;
+}
+
+/* record string STR, in PTR_STRING records; the last one is shorter than
+   a full record */
+static void
+ptb_string(char *str)
+{
+  struct ptrace_rec *rec;
+  int len = strlen(str), n;
+
+  if (len > PTRACE_MAX_STR - 1)
+    len = PTRACE_MAX_STR - 1;
+  do
+    {
+      n = MIN(len, sizeof(rec->w));
+      rec = ptb_new(PTR_STRING, 0, ptb_last_seq);
+      rec->arg = n;
+      memcpy(rec->w, str, n);
+      str += n;
+      len -= n;
+    }
+  while (n == sizeof(rec->w));
+}
+
+/* open binary pipetrace FNAME, and start its writer */
+static void
+ptb_open(char *fname)
+{
+  struct ptrace_hdr hdr;
+  int i;
+
+  if (!fname || !strcmp(fname, "-") || !strcmp(fname, "stderr"))
+    ptb_fd = stderr;
+  else if (!strcmp(fname, "stdout"))
+    ptb_fd = stdout;
+  else
+    {
+      ptb_zfd = zfopen(fname, "w");
+      if (!ptb_zfd)
+	fatal("cannot open pipetrace output file `%s'", fname);
+      ptb_fd = ptb_zfd->fd;
+    }
+
+  for (i = 0; i < PTRACE_NUM_BLOCKS; i++)
+    {
+      ptb_blocks[i] = calloc(PTRACE_BLOCK_RECS, sizeof(struct ptrace_rec));
+      if (!ptb_blocks[i])
+	fatal("out of virtual memory");
+    }
+
+  memcpy(hdr.magic, PTRACE_MAGIC, sizeof(hdr.magic));
+  hdr.byte_order = 0x01020304;
+  hdr.level = ptrace_level;
+  hdr.rec_size = sizeof(struct ptrace_rec);
+  if (fwrite(&hdr, sizeof(hdr), 1, ptb_fd) != 1)
+    fatal("cannot write pipetrace");
+
+#ifndef PTRACE_NO_THREADS
+  if (pthread_create(&ptb_writer, NULL, ptb_write_blocks, NULL))
+    fatal("cannot start pipetrace writer thread");
+#endif
+}
+
+/* write out the rest of the binary pipetrace, and close it */
+static void
+ptb_close(void)
+{
+  if (ptb_num)
+    ptb_flush();
+
+#ifndef PTRACE_NO_THREADS
+  pthread_mutex_lock(&ptb_lock);
+  ptb_done = TRUE;
+  pthread_cond_signal(&ptb_full);
+  pthread_mutex_unlock(&ptb_lock);
+  pthread_join(ptb_writer, NULL);
+#endif
+
+  if (ptb_zfd)
+    zfclose(ptb_zfd);
+  else
+    fflush(ptb_fd);
+}
+
 /* open pipeline trace */
 void
 ptrace_open(char *level,		/* pipetracing level */
@@ -161,6 +375,12 @@ ptrace_open(char *level,		/* pipetracing level */
   if (level[0] == '3')
     fatal("ptrace level 3 is currently unused");
 
+  /* a `b' suffix asks for a binary trace */
+  if (level[1] == 'b' && level[2] == '\0')
+    ptrace_binary = TRUE;
+  else if (level[1] != '\0')
+    fatal("ptrace level must be a digit, optionally followed by `b'");
+
   /* parse the output range */
   if (!range)
     {
@@ -182,7 +402,12 @@ ptrace_open(char *level,		/* pipetracing level */
     fatal("range endpoints are not of the same type");
 
   /* open output trace file */
-  if (!fname || !strcmp(fname, "-") || !strcmp(fname, "stderr"))
+  if (ptrace_binary)
+    {
+      ptb_open(fname);
+      ptrace_outfd = ptb_fd;
+    }
+  else if (!fname || !strcmp(fname, "-") || !strcmp(fname, "stderr"))
     ptrace_outfd = stderr;
   else if (!strcmp(fname, "stdout"))
     ptrace_outfd = stdout;
@@ -198,9 +423,46 @@ ptrace_open(char *level,		/* pipetracing level */
 void
 ptrace_close(void)
 {
-  if (ptrace_outfd != NULL && ptrace_outfd != stderr && ptrace_outfd != stdout)
+  if (ptrace_binary)
+    ptb_close();
+  else if (ptrace_outfd != NULL && ptrace_outfd != stderr && ptrace_outfd != stdout)
     fclose(ptrace_outfd);
 }
+#else /* PTRACE_READER_ONLY */
+
+/* a reader prints traces as text, with ptrace_binary FALSE, so the
+   recorders below never reach the binary writer */
+static unsigned int ptb_last_seq = 0;
+static SS_TIME_TYPE ptb_last_cycle = 0;
+
+static struct ptrace_rec *
+ptb_new(enum ptrace_rec_type type, int thread, unsigned int iseq)
+{
+  panic("no binary pipetrace writer in this build");
+  return NULL;
+}
+
+static void
+ptb_string(char *str)
+{
+  panic("no binary pipetrace writer in this build");
+}
+#endif /* PTRACE_READER_ONLY */
+
+/* the index of pipeline stage PSTAGE in ptrace_stages */
+static int
+ptb_stage(char *pstage)
+{
+  int i;
+
+  for (i = 0; ptrace_stages[i]; i++)
+    if (pstage[0] == ptrace_stages[i][0] && pstage[1] == ptrace_stages[i][1])
+      return i;
+
+  panic("bogus pipeline stage `%s'", pstage);
+  return -1;
+}
+
 
 /* declare a new instruction */
 void
@@ -215,6 +477,17 @@ __ptrace_newinst(unsigned int iseq,	/* instruction sequence number */
      * across different configs */
     iseq = ++consec_seq;
 
+  if (ptrace_binary)
+    {
+      struct ptrace_rec *rec = ptb_new(PTR_NEWINST, thread, iseq);
+
+      rec->w[0] = pc;
+      rec->w[1] = addr;
+      rec->w[2] = inst.a;
+      rec->w[3] = inst.b;
+      return;
+    }
+
   fprintf(ptrace_outfd, "+ %u 0x%08x t%02d 0x%08x ", iseq, pc, thread, addr);
   ss_print_insn(inst, addr, ptrace_outfd);
   fprintf(ptrace_outfd, "\n");
@@ -231,6 +504,16 @@ __ptrace_newuop(unsigned int iseq,	/* instruction sequence number */
 		int thread,		/* thread id */
 		SS_ADDR_TYPE addr)	/* address referenced, if load/store */
 {
+  if (ptrace_binary)
+    {
+      struct ptrace_rec *rec = ptb_new(PTR_NEWUOP, thread, iseq);
+
+      rec->w[0] = pc;
+      rec->w[1] = addr;
+      ptb_string(uop_desc);
+      return;
+    }
+
   fprintf(ptrace_outfd, "+ %u 0x%08x t%02d 0x%08x [%s]\n", 
 	  iseq, pc, thread, addr, uop_desc);
 
@@ -244,6 +527,15 @@ __ptrace_newthread(int thread, 		/* id of new thread */
 		   SS_ADDR_TYPE brpc,	/* program counter of forking branch */
 		   SS_ADDR_TYPE destpc) /* forked-to address */
 {
+  if (ptrace_binary)
+    {
+      struct ptrace_rec *rec = ptb_new(PTR_NEWTHREAD, thread, ptb_last_seq);
+
+      rec->w[0] = brpc;
+      rec->w[1] = destpc;
+      return;
+    }
+
   fprintf(ptrace_outfd, "f t%02d 0x%08x -> 0x%08x\n", thread, brpc, destpc);
 
   if (ptrace_outfd == stderr || ptrace_outfd == stdout)
@@ -255,6 +547,12 @@ __ptrace_newthread(int thread, 		/* id of new thread */
 void
 __ptrace_squashthread(int thread)	/* id of new thread */
 {
+  if (ptrace_binary)
+    {
+      ptb_new(PTR_SQUASHTHREAD, thread, ptb_last_seq);
+      return;
+    }
+
   fprintf(ptrace_outfd, "s t%02d\n", thread);
 
   if (ptrace_outfd == stderr || ptrace_outfd == stdout)
@@ -265,6 +563,12 @@ __ptrace_squashthread(int thread)	/* id of new thread */
 void
 __ptrace_killthread(int thread)		/* id of new thread */
 {
+  if (ptrace_binary)
+    {
+      ptb_new(PTR_KILLTHREAD, thread, ptb_last_seq);
+      return;
+    }
+
   fprintf(ptrace_outfd, "k t%02d\n", thread);
 
   if (ptrace_outfd == stderr || ptrace_outfd == stdout)
@@ -275,6 +579,13 @@ __ptrace_killthread(int thread)		/* id of new thread */
 void
 __ptrace_overflow(char *item)		/* name of overflowed resource */
 {
+  if (ptrace_binary)
+    {
+      ptb_new(PTR_OVERFLOW, 0, ptb_last_seq);
+      ptb_string(item);
+      return;
+    }
+
   fprintf(ptrace_outfd, "\\/ %s\n", item);
 
   if (ptrace_outfd == stderr || ptrace_outfd == stdout)
@@ -286,6 +597,12 @@ void
 __ptrace_endinst(unsigned int iseq,	/* instruction sequence number */
 		 int thread)		/* thread id */
 {
+  if (ptrace_binary)
+    {
+      ptb_new(PTR_ENDINST, thread, iseq);
+      return;
+    }
+
   fprintf(ptrace_outfd, "- %u t%02d\n", iseq, thread);
 
   if (ptrace_outfd == stderr || ptrace_outfd == stdout)
@@ -297,6 +614,22 @@ void
 __ptrace_newcycle(SS_TIME_TYPE cycle,	                 /* new cycle */
 		  int RUU_occ, int LSQ_occ, int IFQ_occ) /* queue occupancies*/
 {
+  if (ptrace_binary)
+    {
+      struct ptrace_rec *rec = ptb_new(PTR_NEWCYCLE, 0, ptb_last_seq);
+      SS_TIME_TYPE delta = cycle - ptb_last_cycle;
+
+      if (delta >> 48)
+	panic("pipetrace cycle delta too large");
+      rec->arg = (unsigned short)(delta >> 32);
+      rec->w[0] = (unsigned int)delta;
+      rec->w[1] = RUU_occ;
+      rec->w[2] = LSQ_occ;
+      rec->w[3] = IFQ_occ;
+      ptb_last_cycle = cycle;
+      return;
+    }
+
   fprintf(ptrace_outfd, "@ %.0f\t ruu: %d,  lsq: %d,  ifq: %d\n", 
 	  (double)cycle, RUU_occ, LSQ_occ, IFQ_occ);
 
@@ -311,6 +644,15 @@ __ptrace_newstage(unsigned int iseq,	/* instruction sequence number */
 		  char *pstage,		/* pipeline stage entered */
 		  unsigned int pevents) /* pipeline events while in stage */
 {
+  if (ptrace_binary)
+    {
+      struct ptrace_rec *rec = ptb_new(PTR_NEWSTAGE, thread, iseq);
+
+      rec->arg = ptb_stage(pstage);
+      rec->w[0] = pevents;
+      return;
+    }
+
   fprintf(ptrace_outfd, "* %u %s t%02d 0x%08x\n", iseq, pstage, thread,
 	  pevents);
 
@@ -337,6 +679,17 @@ __ptrace_newstage_mem(unsigned int iseq,/* instruction sequence number */
 
   /* otherwise, print mem address and that location's contents after a  
    * load or store has been functionally simulated */
+  if (ptrace_binary)
+    {
+      struct ptrace_rec *rec = ptb_new(PTR_NEWSTAGE_MEM, thread, iseq);
+
+      rec->arg = ptb_stage(pstage);
+      rec->w[0] = pevents;
+      rec->w[1] = addr;
+      rec->w[2] = data;
+      return;
+    }
+
   fprintf(ptrace_outfd, "* %u %s t%02d 0x%08x mem[0x%08x] = 0x%08x\n", 
 	  iseq, pstage, thread, pevents, addr, data);
   
@@ -418,6 +771,22 @@ __ptrace_newstage_verbose(unsigned int iseq, /* instruction sequence number */
       pevents = 0x0;
     }
 
+  if (ptrace_binary)
+    {
+      struct ptrace_rec *rec = ptb_new(PTR_NEWSTAGE_VERBOSE, thread, iseq);
+
+      rec->arg = ptb_stage(pstage);
+      rec->w[0] = pevents;
+      rec->w[1] = op;
+      rec->w[2] = in1 | (in2 << 8) | (in3 << 16);
+      rec->w[3] = out1 | (out2 << 8);
+      rec = ptb_new(PTR_VALUES, thread, iseq);
+      memcpy(rec->w, in_vals, 3 * sizeof(union dlite_reg_val_t));
+      rec = ptb_new(PTR_VALUES, thread, iseq);
+      memcpy(rec->w, out_vals, 2 * sizeof(union dlite_reg_val_t));
+      return;
+    }
+
   if (in1)
     {
       get_reg_name(reg_name, in1);
@@ -489,3 +858,239 @@ __ptrace_newstage_verbose(unsigned int iseq, /* instruction sequence number */
   if (ptrace_outfd == stderr || ptrace_outfd == stdout)
     fflush(ptrace_outfd);
 }
+
+/*
+ * binary pipetrace reader
+ */
+
+/* a binary pipetrace being read */
+struct ptrace_reader
+{
+  ZFILE *zfd;			/* trace file */
+  int level;			/* pipetracing level it was written at */
+  unsigned int iseq;		/* last instruction sequence number */
+  SS_TIME_TYPE cycle;		/* current cycle */
+  struct ptrace_rec *buf;	/* block of records read */
+  int num, pos;			/* records in BUF, next one to return */
+};
+
+/* open binary pipetrace FNAME for reading (".gz" files are decompressed on
+   the fly), returns NULL if it cannot be opened */
+struct ptrace_reader *
+ptrace_reader_open(char *fname)
+{
+  struct ptrace_reader *rd;
+  struct ptrace_hdr hdr;
+  ZFILE *zfd;
+
+  zfd = zfopen(fname, "r");
+  if (!zfd)
+    return NULL;
+
+  if (fread(&hdr, sizeof(hdr), 1, zfd->fd) != 1
+      || memcmp(hdr.magic, PTRACE_MAGIC, sizeof(hdr.magic)))
+    fatal("`%s' is not a binary pipetrace", fname);
+  if (hdr.byte_order != 0x01020304)
+    fatal("pipetrace `%s' was written on a host of different byte order",
+	  fname);
+  if (hdr.rec_size != sizeof(struct ptrace_rec))
+    fatal("pipetrace `%s' has records of an unknown size", fname);
+
+  rd = calloc(1, sizeof(struct ptrace_reader));
+  if (!rd)
+    fatal("out of virtual memory");
+  rd->buf = calloc(PTRACE_BLOCK_RECS, sizeof(struct ptrace_rec));
+  if (!rd->buf)
+    fatal("out of virtual memory");
+  rd->zfd = zfd;
+  rd->level = hdr.level;
+
+  return rd;
+}
+
+/* the pipetracing level binary pipetrace RD was written at */
+int
+ptrace_reader_level(struct ptrace_reader *rd)
+{
+  return rd->level;
+}
+
+/* return the next record of binary pipetrace RD, or NULL at its end; a
+   read error or a partial record at the end is fatal */
+static struct ptrace_rec *
+rd_next_rec(struct ptrace_reader *rd)
+{
+  struct ptrace_rec *rec;
+  size_t got;
+
+  if (rd->pos == rd->num)
+    {
+      got = fread(rd->buf, 1, PTRACE_BLOCK_RECS * sizeof(struct ptrace_rec),
+		  rd->zfd->fd);
+      if (ferror(rd->zfd->fd))
+	fatal("cannot read pipetrace");
+      if (got % sizeof(struct ptrace_rec))
+	fatal("truncated pipetrace");
+      rd->num = got / sizeof(struct ptrace_rec);
+      rd->pos = 0;
+      if (rd->num == 0)
+	return NULL;
+    }
+  rec = &rd->buf[rd->pos++];
+  rd->iseq += rec->dseq;
+  return rec;
+}
+
+/* return the next record of binary pipetrace RD, which must be of type
+   TYPE */
+static struct ptrace_rec *
+rd_next_part(struct ptrace_reader *rd, enum ptrace_rec_type type)
+{
+  struct ptrace_rec *rec = rd_next_rec(rd);
+
+  if (!rec || rec->type != type)
+    fatal("truncated or corrupt pipetrace");
+  return rec;
+}
+
+/* read the next event of binary pipetrace RD into EV, returns FALSE at the
+   end of the trace */
+int
+ptrace_reader_next(struct ptrace_reader *rd, struct ptrace_event *ev)
+{
+  struct ptrace_rec *rec;
+  int len = 0;
+
+  if (!(rec = rd_next_rec(rd)))
+    return FALSE;
+  if (rec->type == 0 || rec->type >= PTR_STRING)
+    fatal("truncated or corrupt pipetrace");
+
+  ev->type = rec->type;
+  ev->thread = rec->thread;
+  ev->iseq = rd->iseq;
+  ev->stage = rec->arg;
+  memcpy(ev->w, rec->w, sizeof(ev->w));
+  ev->str[0] = '\0';
+
+  switch (rec->type)
+    {
+    case PTR_NEWCYCLE:
+      rd->cycle += ((SS_TIME_TYPE)rec->arg << 32) | rec->w[0];
+      ev->stage = 0;
+      break;
+
+    case PTR_NEWSTAGE:
+    case PTR_NEWSTAGE_MEM:
+      if (ev->stage >= N_ELT(ptrace_stages) - 1)
+	fatal("truncated or corrupt pipetrace");
+      break;
+
+    case PTR_NEWSTAGE_VERBOSE:
+      if (ev->stage >= N_ELT(ptrace_stages) - 1)
+	fatal("truncated or corrupt pipetrace");
+      rec = rd_next_part(rd, PTR_VALUES);
+      memcpy(ev->in_vals, rec->w, sizeof(ev->in_vals));
+      rec = rd_next_part(rd, PTR_VALUES);
+      memcpy(ev->out_vals, rec->w, sizeof(ev->out_vals));
+      break;
+
+    case PTR_NEWUOP:
+    case PTR_OVERFLOW:
+      do
+	{
+	  rec = rd_next_part(rd, PTR_STRING);
+	  if (rec->arg > sizeof(rec->w) || len + rec->arg >= PTRACE_MAX_STR)
+	    fatal("truncated or corrupt pipetrace");
+	  memcpy(ev->str + len, rec->w, rec->arg);
+	  len += rec->arg;
+	}
+      while (rec->arg == sizeof(rec->w));
+      ev->str[len] = '\0';
+      break;
+
+    default:
+      break;
+    }
+  ev->cycle = rd->cycle;
+
+  return TRUE;
+}
+
+/* close binary pipetrace RD */
+void
+ptrace_reader_close(struct ptrace_reader *rd)
+{
+  zfclose(rd->zfd);
+  free(rd->buf);
+  free(rd);
+}
+
+/* print event EV of a trace written at pipetracing level LEVEL to STREAM,
+   in the text format */
+void
+ptrace_print_event(FILE *stream, int level, struct ptrace_event *ev)
+{
+  FILE *old_outfd = ptrace_outfd;
+  int old_level = ptrace_level, old_binary = ptrace_binary;
+  SS_INST_TYPE inst;
+
+  ptrace_outfd = stream;
+  ptrace_binary = FALSE;
+  /* the functional-simulation levels' renumbering was done as the trace
+     was written */
+  ptrace_level =
+    (level == PTRACE_FUNSIM || level == PTRACE_DECODE) ? PTRACE_VERBOSE : level;
+
+  switch (ev->type)
+    {
+    case PTR_NEWINST:
+      inst.a = ev->w[2];
+      inst.b = ev->w[3];
+      __ptrace_newinst(ev->iseq, inst, ev->w[0], ev->thread, ev->w[1]);
+      break;
+    case PTR_NEWUOP:
+      __ptrace_newuop(ev->iseq, ev->str, ev->w[0], ev->thread, ev->w[1]);
+      break;
+    case PTR_NEWTHREAD:
+      __ptrace_newthread(ev->thread, ev->w[0], ev->w[1]);
+      break;
+    case PTR_SQUASHTHREAD:
+      __ptrace_squashthread(ev->thread);
+      break;
+    case PTR_KILLTHREAD:
+      __ptrace_killthread(ev->thread);
+      break;
+    case PTR_OVERFLOW:
+      __ptrace_overflow(ev->str);
+      break;
+    case PTR_ENDINST:
+      __ptrace_endinst(ev->iseq, ev->thread);
+      break;
+    case PTR_NEWCYCLE:
+      __ptrace_newcycle(ev->cycle, ev->w[1], ev->w[2], ev->w[3]);
+      break;
+    case PTR_NEWSTAGE:
+      __ptrace_newstage(ev->iseq, ev->thread, ptrace_stages[ev->stage],
+			ev->w[0]);
+      break;
+    case PTR_NEWSTAGE_MEM:
+      __ptrace_newstage_mem(ev->iseq, ev->thread, ptrace_stages[ev->stage],
+			    ev->w[0], ev->w[1], ev->w[2]);
+      break;
+    case PTR_NEWSTAGE_VERBOSE:
+      __ptrace_newstage_verbose(ev->iseq, ev->thread,
+				ptrace_stages[ev->stage], ev->w[0],
+				(enum ss_opcode)ev->w[1], ev->w[2] & 0xff,
+				(ev->w[2] >> 8) & 0xff, (ev->w[2] >> 16) & 0xff,
+				ev->in_vals, ev->w[3] & 0xff,
+				(ev->w[3] >> 8) & 0xff, ev->out_vals);
+      break;
+    default:
+      panic("bogus pipetrace event type %d", ev->type);
+    }
+
+  ptrace_outfd = old_outfd;
+  ptrace_level = old_level;
+  ptrace_binary = old_binary;
+}
@@ -131,6 +131,18 @@
  *
  */
 
+/*
+ * A level given with a `b' suffix (e.g. `-ptrace 4b FOO.bpt :') writes the
+ * same events in binary instead: a struct ptrace_hdr, then fixed-size
+ * struct ptrace_rec records, each instruction sequence number stored as a
+ * delta from the previous record's and each cycle as a delta from the
+ * previous cycle's.  Records are collected in large blocks that a writer
+ * thread hands to the file, and a file name ending in `.gz' is compressed
+ * through gzip (see zfopen()).  The ptrace_reader interface below streams
+ * such a trace back as events; ptrace-read converts it to the text format,
+ * optionally filtered by thread, PC or cycle.
+ */
+
 /*
 	[IF]   [DA]   [EX]   [WB]   [CT]
          aa     dd     jj     ll     nn
@@ -162,6 +174,9 @@
 /* pipetrace file */
 extern FILE *ptrace_outfd;
 
+/* is the pipetrace binary? */
+extern int ptrace_binary;
+
 /* is pipetracing active? */
 extern int ptrace_active;
 
@@ -305,4 +320,95 @@ __ptrace_newstage_verbose(unsigned int iseq, /* instruction sequence number */
 		  int out1, int out2,        /* output dependency numbers */
 		  union dlite_reg_val_t *out_vals);/* output values */
 
+/*
+ * binary pipetraces
+ */
+
+/* binary pipetrace magic number and version */
+#define PTRACE_MAGIC		"HPT1"
+
+/* binary pipetrace file header */
+struct ptrace_hdr
+{
+  char magic[4];		/* PTRACE_MAGIC */
+  unsigned int byte_order;	/* 0x01020304, in the writer's byte order */
+  unsigned int level;		/* pipetracing level */
+  unsigned int rec_size;	/* sizeof(struct ptrace_rec) */
+};
+
+/* binary pipetrace record types, and what their fields hold */
+enum ptrace_rec_type
+{
+  PTR_NEWINST = 1,	/* w: pc, addr, inst.a, inst.b */
+  PTR_NEWUOP,		/* w: pc, addr; then PTR_STRING records */
+  PTR_NEWTHREAD,	/* w: branch pc, forked-to pc */
+  PTR_SQUASHTHREAD,	/* (none) */
+  PTR_KILLTHREAD,	/* (none) */
+  PTR_OVERFLOW,		/* then PTR_STRING records */
+  PTR_ENDINST,		/* (none) */
+  PTR_NEWCYCLE,		/* arg:w[0]: cycle delta, w: -, RUU, LSQ, IFQ occ */
+  PTR_NEWSTAGE,		/* arg: stage, w: pevents */
+  PTR_NEWSTAGE_MEM,	/* arg: stage, w: pevents, addr, data */
+  PTR_NEWSTAGE_VERBOSE,	/* arg: stage, w: pevents, op, in1..3, out1..2 (a
+			   byte each); then two PTR_VALUES records */
+  PTR_STRING,		/* arg: length, w: up to 16 characters */
+  PTR_VALUES,		/* w: operand values, in_vals[3] then out_vals[2] */
+  PTR_NUM_TYPES
+};
+
+/* a binary pipetrace record */
+struct ptrace_rec
+{
+  unsigned char type;		/* enum ptrace_rec_type */
+  unsigned char thread;		/* thread id */
+  unsigned short arg;		/* type-specific */
+  int dseq;			/* iseq less the previous record's iseq */
+  unsigned int w[4];		/* type-specific */
+};
+
+/* longest string a binary pipetrace event can carry */
+#define PTRACE_MAX_STR		256
+
+/* a decoded binary pipetrace event */
+struct ptrace_event
+{
+  enum ptrace_rec_type type;	/* event type, never PTR_STRING/PTR_VALUES */
+  int thread;			/* thread id */
+  unsigned int iseq;		/* instruction sequence number */
+  SS_TIME_TYPE cycle;		/* cycle the event occurred in */
+  int stage;			/* pipeline stage, index into ptrace_stages */
+  unsigned int w[4];		/* the record's type-specific fields */
+  char str[PTRACE_MAX_STR];	/* uop description or overflowed resource */
+  union dlite_reg_val_t in_vals[3], out_vals[2]; /* verbose values */
+};
+
+/* pipeline stage names, as stored in binary pipetraces */
+extern char *ptrace_stages[];
+
+/* a binary pipetrace being read */
+struct ptrace_reader;
+
+/* open binary pipetrace FNAME for reading (".gz" files are decompressed on
+   the fly), returns NULL if it cannot be opened */
+struct ptrace_reader *
+ptrace_reader_open(char *fname);
+
+/* the pipetracing level binary pipetrace RD was written at */
+int
+ptrace_reader_level(struct ptrace_reader *rd);
+
+/* read the next event of binary pipetrace RD into EV, returns FALSE at the
+   end of the trace */
+int
+ptrace_reader_next(struct ptrace_reader *rd, struct ptrace_event *ev);
+
+/* close binary pipetrace RD */
+void
+ptrace_reader_close(struct ptrace_reader *rd);
+
+/* print event EV of a trace written at pipetracing level LEVEL to STREAM,
+   in the text format */
+void
+ptrace_print_event(FILE *stream, int level, struct ptrace_event *ev);
+
 #endif /* PTRACE_H */
@@ -82,10 +82,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <strings.h>
 #include <assert.h>
 #include "misc.h"
 #include "resource.h"
 
+/* release wheel bucket of cycle WHEN */
+#define RES_BUCKET(POOL, WHEN)						\
+  (&(POOL)->wheel[(unsigned long)(WHEN) & (RES_WHEEL_SIZE - 1)])
+
 /* create a resource pool */
 struct res_pool *
 res_create_pool(char *name, struct res_desc *pool, int ndesc)
@@ -145,7 +150,9 @@ res_create_pool(char *name, struct res_desc *pool, int ndesc)
 	  if (plate->class)
 	    {
 	      assert(plate->class < MAX_RES_CLASSES);
+	      plate->slot = res->nents[plate->class];
 	      res->table[plate->class][res->nents[plate->class]++] = plate;
+	      res->free[plate->class] |= 1U << plate->slot;
 	    }
 	  else
 	    /* all done with this instance */
@@ -160,8 +167,7 @@ res_create_pool(char *name, struct res_desc *pool, int ndesc)
    operation of class CLASS, returns a pointer to the resource template,
    returns NULL, if there are currently no free resources available,
    follow the MASTER link to the master resource descriptor;
-   NOTE: caller is responsible for reseting the busy flag in the beginning
-   of the cycle when the resource can once again accept a new operation */
+   NOTE: caller is responsible for making the unit busy with res_hold() */
 struct res_template *
 res_get(struct res_pool *pool, int class)
 {
@@ -178,18 +184,132 @@ res_get(struct res_pool *pool, int class)
   /* must be at least one resource in this class */
   assert(pool->table[class][0]);
 
-  for (i=0; i<MAX_INSTS_PER_CLASS; i++)
+  /* the first free one */
+  if (!pool->free[class])
+    return NULL;
+  i = ffs(pool->free[class]) - 1;
+  assert(!pool->table[class][i]->master->busy);
+  return pool->table[class][i];
+}
+
+/* flip the free bits of unit UNIT in pool POOL, in each class it serves */
+static void
+res_flip_free(struct res_pool *pool, struct res_desc *unit)
+{
+  int k;
+
+  for (k=0; k<MAX_RES_CLASSES && unit->x[k].class; k++)
+    pool->free[unit->x[k].class] ^= 1U << unit->x[k].slot;
+}
+
+/* unlink busy unit UNIT from the release wheel of pool POOL */
+static void
+res_unlink(struct res_pool *pool, struct res_desc *unit)
+{
+  if (unit->prev)
+    unit->prev->next = unit->next;
+  else
+    *RES_BUCKET(pool, unit->release) = unit->next;
+  if (unit->next)
+    unit->next->prev = unit->prev;
+}
+
+/* make unit UNIT of pool POOL busy for the next CYCLES calls of
+   res_release(), i.e., until the cycle POOL->NOW + CYCLES; a busy unit's
+   release is moved, and CYCLES <= 0 frees it right away */
+void
+res_hold(struct res_pool *pool, struct res_desc *unit, int cycles)
+{
+  struct res_desc **bucket;
+
+  if (cycles <= 0)
+    {
+      res_free(pool, unit);
+      return;
+    }
+
+  if (unit->busy)
+    res_unlink(pool, unit);
+  else
+    {
+      unit->busy = TRUE;
+      pool->num_busy++;
+      res_flip_free(pool, unit);
+    }
+
+  unit->release = pool->now + cycles;
+  if (pool->num_busy == 1 || unit->release < pool->next_release)
+    pool->next_release = unit->release;
+  bucket = RES_BUCKET(pool, unit->release);
+  unit->prev = NULL;
+  unit->next = *bucket;
+  if (*bucket)
+    (*bucket)->prev = unit;
+  *bucket = unit;
+}
+
+/* free unit UNIT of pool POOL right away */
+void
+res_free(struct res_pool *pool, struct res_desc *unit)
+{
+  if (!unit->busy)
+    return;
+
+  res_unlink(pool, unit);
+  unit->busy = FALSE;
+  pool->num_busy--;
+  res_flip_free(pool, unit);
+}
+
+/* release the units of pool POOL that become free in cycle NOW, and in any
+   cycles since the last call; called once at the start of each cycle */
+void
+res_release(struct res_pool *pool, SS_TIME_TYPE now)
+{
+  struct res_desc *unit, *next;
+
+  while (pool->now < now)
     {
-      if (pool->table[class][i])
+      pool->now++;
+
+      /* nothing busy, nothing to step through */
+      if (!pool->num_busy)
 	{
-	  if (!pool->table[class][i]->master->busy)
-	    return pool->table[class][i];
+	  pool->now = now;
+	  break;
+	}
+
+      /* units in the bucket may be due a later turn of the wheel */
+      for (unit = *RES_BUCKET(pool, pool->now); unit != NULL; unit = next)
+	{
+	  next = unit->next;
+	  if (unit->release == pool->now)
+	    res_free(pool, unit);
 	}
-      else
-	break;
     }
-  /* none found */
-  return NULL;
+}
+
+/* cycle in which the next busy unit of pool POOL is released, in *WHEN;
+   returns FALSE if no unit is busy */
+int
+res_next_release(struct res_pool *pool, SS_TIME_TYPE *when)
+{
+  SS_TIME_TYPE t;
+  struct res_desc *unit;
+
+  if (!pool->num_busy)
+    return FALSE;
+
+  /* NEXT_RELEASE is left behind when the units due then are freed or
+     held longer, catch it up to the first bucket with a unit due in its
+     cycle; every busy unit is due after POOL->NOW */
+  for (t = MAX(pool->next_release, pool->now + 1); ; t++)
+    for (unit = *RES_BUCKET(pool, t); unit != NULL; unit = unit->next)
+      if (unit->release == t)
+	{
+	  pool->next_release = *when = t;
+	  return TRUE;
+	}
 }
 
 /* dump the resource pool POOL to stream STREAM */
@@ -212,9 +332,11 @@ res_dump(struct res_pool *pool, FILE *stream)
 	{
 	  if (!pool->table[i][j])
 	    break;
-	  fprintf(stream, "\t%s (busy for %d cycles) ",
+	  fprintf(stream, "\t%s (busy for %.0f cycles) ",
 		  pool->table[i][j]->master->name,
-		  pool->table[i][j]->master->busy);
+		  pool->table[i][j]->master->busy
+		  ? (double)(pool->table[i][j]->master->release - pool->now)
+		  : 0.0);
 	}
       assert(j == pool->nents[i]);
       fprintf(stream, "\n");
@@ -98,6 +98,7 @@
 #define RESOURCE_H
 
 #include <stdio.h>
+#include "ss.h"
 
 /* maximum number of resource classes supported */
 #define MAX_RES_CLASSES		16
@@ -113,6 +114,10 @@
 #define MAX_INSTS_PER_CLASS	8
 #endif
 
+/* release wheel size, must be a power of two; units busy for longer simply
+   stay in their bucket for more than one turn of the wheel */
+#define RES_WHEEL_SIZE		64
+
 /* resource descriptor */
 struct res_desc {
   char *name;				/* name of functional unit */
@@ -128,7 +133,10 @@ struct res_desc {
 					   before another operation can be
 					   issued on this resource */
     struct res_desc *master;		/* master resource record */
+    int slot;				/* index in the pool's TABLE[CLASS] */
   } x[MAX_RES_CLASSES];
+  SS_TIME_TYPE release;			/* if busy, the cycle it is released */
+  struct res_desc *next, *prev;		/* if busy, release wheel links */
 };
 
 /* resource pool: one entry per resource instance */
@@ -139,6 +147,15 @@ struct res_pool {
   /* res class -> res template mapping table, lists are NULL terminated */
   int nents[MAX_RES_CLASSES];
   struct res_template *table[MAX_RES_CLASSES][MAX_INSTS_PER_CLASS];
+  /* res class -> free units, bit I is set if TABLE[CLASS][I] is not busy */
+  unsigned int free[MAX_RES_CLASSES];
+  /* busy units, in the bucket for (release cycle mod RES_WHEEL_SIZE) */
+  struct res_desc *wheel[RES_WHEEL_SIZE];
+  int num_busy;				/* busy units */
+  SS_TIME_TYPE next_release;		/* if any unit is busy, no later
+					   than the first release */
+  SS_TIME_TYPE now;			/* last cycle released, see
+					   res_release() */
 };
 
 /* create a resource pool */
@@ -148,10 +165,25 @@ struct res_pool *res_create_pool(char *name, struct res_desc *pool, int ndesc);
    operation of class CLASS, returns a pointer to the resource template,
    returns NULL, if there are currently no free resources available,
    follow the MASTER link to the master resource descriptor;
-   NOTE: caller is responsible for reseting the busy flag in the beginning
-   of the cycle when the resource can once again accept a new operation */
+   NOTE: caller is responsible for making the unit busy with res_hold() */
 struct res_template *res_get(struct res_pool *pool, int class);
 
+/* make unit UNIT of pool POOL busy for the next CYCLES calls of
+   res_release(), i.e., until the cycle POOL->NOW + CYCLES; a busy unit's
+   release is moved, and CYCLES <= 0 frees it right away */
+void res_hold(struct res_pool *pool, struct res_desc *unit, int cycles);
+
+/* free unit UNIT of pool POOL right away */
+void res_free(struct res_pool *pool, struct res_desc *unit);
+
+/* release the units of pool POOL that become free in cycle NOW, and in any
+   cycles since the last call; called once at the start of each cycle */
+void res_release(struct res_pool *pool, SS_TIME_TYPE now);
+
+/* cycle in which the next busy unit of pool POOL is released, in *WHEN;
+   returns FALSE if no unit is busy */
+int res_next_release(struct res_pool *pool, SS_TIME_TYPE *when);
+
 /* dump the resource pool POOL to stream STREAM */
 void res_dump(struct res_pool *pool, FILE *stream);
 
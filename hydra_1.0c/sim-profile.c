@@ -90,6 +90,7 @@
 #include "symbol.h"
 #include "options.h"
 #include "stats.h"
+#include "simpoint.h"
 #include "sim.h"
 
 /*
@@ -118,6 +119,17 @@ static int prof_taddr /* = FALSE */;
 static int pcstat_nelt = 0;
 static char *pcstat_vars[MAX_PCSTAT_VARS];
 
+/* basic-block vector profile options, see simpoint.h */
+static unsigned int bbv_interval /* = 0 */;
+static char *bbv_fname /* = NULL */;
+static char *simpoint_fname /* = NULL */;
+static int simpoint_max_k;
+static int simpoint_seed;
+
+/* basic-block vector profile, NULL if not profiling */
+static struct bbv_t *bbv = NULL;
+static FILE *bbv_fd = NULL;
+
 /* register simulator-specific options */
 void
 sim_reg_options(struct opt_odb_t *odb)
@@ -163,6 +175,26 @@ sim_reg_options(struct opt_odb_t *odb)
 		      "profile stat(s) against text addr's (mult uses ok)",
 		      pcstat_vars, MAX_PCSTAT_VARS, &pcstat_nelt, NULL,
 		      /* !print */FALSE, /* format */NULL, /* accrue */TRUE);
+
+  opt_reg_uint(odb, "-bbv:interval",
+	       "profile basic-block vectors for intervals of this many insts",
+	       &bbv_interval, /* default */0, /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-bbv:file",
+		 "write raw basic-block vectors to this file (SimPoint .bb)",
+		 &bbv_fname, /* default */NULL, /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-simpoint:file",
+		 "cluster the vectors, write simulation points to this file",
+		 &simpoint_fname, /* default */NULL, /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-simpoint:maxk",
+	      "maximum number of simulation points (clusters)",
+	      &simpoint_max_k, /* default */10, /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-simpoint:seed",
+	      "random seed for projection and clustering",
+	      &simpoint_seed, /* default */1, /* print */TRUE, NULL);
 }
 
 /* check simulator-specific option values */
@@ -181,6 +213,18 @@ sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
       prof_dsyms = TRUE;
       prof_taddr = TRUE;
     }
+
+  if ((bbv_fname || simpoint_fname) && !bbv_interval)
+    fatal("-bbv:file and -simpoint:file need a -bbv:interval");
+  if (simpoint_max_k < 1)
+    fatal("-simpoint:maxk must be at least 1");
+  if (bbv_interval)
+    {
+      if (bbv_fname && !(bbv_fd = fopen(bbv_fname, "w")))
+	fatal("cannot create basic-block vector file `%s'", bbv_fname);
+      srandom(simpoint_seed);
+      bbv = bbv_create((SS_COUNTER_TYPE)bbv_interval, bbv_fd);
+    }
 }
 
 /* instruction classes */
@@ -582,7 +626,26 @@ sim_aux_stats(FILE *stream)		/* output stream */
 void
 sim_uninit(void)
 {
-  /* nada */
+  struct simpoint_t *points;
+  int nintervals, num;
+
+  if (bbv)
+    {
+      nintervals = bbv_finish(bbv);
+      if (bbv_fd)
+	fclose(bbv_fd);
+      if (simpoint_fname)
+	{
+	  /* five random k-means seedings per k, as SimPoint does */
+	  num = simpoint_cluster(bbv, simpoint_max_k, /* tries */5, &points);
+	  simpoint_write(simpoint_fname, (SS_COUNTER_TYPE)bbv_interval,
+			 points, num);
+	  fprintf(outfile,
+		  "sim: chose %d simulation points from %d intervals of %u "
+		  "instructions, written to `%s'\n",
+		  num, nintervals, bbv_interval, simpoint_fname);
+	}
+    }
 }
 
 
@@ -890,6 +953,10 @@ sim_main(void)
 	  stat_add_sample(taddr_prof, regs_PC);
 	}
 
+      /* add this instruction to the current basic-block vector */
+      if (bbv)
+	bbv_inst(bbv, regs_PC, flags & (F_CTRL|F_TRAP));
+
       /* update any stats tracked by PC */
       for (i=0; i<pcstat_nelt; i++)
 	{
@@ -134,6 +134,9 @@ extern time_t sim_start_time;
 extern time_t sim_end_time;
 extern time_t sim_elapsed_time;
 
+/* peak host memory (resident set) used, in kilobytes */
+extern int sim_host_maxrss;
+
 /* options database */
 struct opt_odb_t *sim_odb;
 
@@ -0,0 +1,585 @@
+/*
+ * simpoint.c - basic-block vector profiling and simulation point selection
+ *
+ * This file is a part of the SimpleScalar tool suite, and is distributed
+ * under the same terms as the rest of the tool suite; see the copyright
+ * notice in any of the original SimpleScalar sources.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "misc.h"
+#include "ss.h"
+#include "simpoint.h"
+
+/* dimensions the basic-block vectors are projected down to; SimPoint's
+   default, plenty to separate program phases */
+#define BBV_DIMS		15
+
+/* k-means iteration limit per seeding */
+#define KMEANS_MAX_ITERS	100
+
+/* pick the smallest k scoring at least this fraction of the way from the
+   worst to the best BIC */
+#define BIC_THRESHOLD		0.9
+
+/* basic-block table entry */
+struct bbv_block
+{
+  SS_ADDR_TYPE pc;		/* first instruction, 0 if the slot is free */
+  int id;			/* block id, indexes counts[] and proj[] */
+};
+
+/* a basic-block vector profile */
+struct bbv_t
+{
+  SS_COUNTER_TYPE interval;	/* instructions per interval */
+  FILE *fd;			/* raw vector output, or NULL */
+
+  /* basic blocks seen so far, open-addressed by starting PC */
+  struct bbv_block *htab;
+  int htab_size;		/* power of two */
+  int nblocks;
+  int blocks_size;		/* allocated rows of counts[] and proj[] */
+  double *proj;			/* [block][BBV_DIMS] random projection */
+
+  /* the interval being profiled */
+  unsigned int *counts;		/* [block] instructions executed */
+  int *touched;			/* blocks with non-zero counts */
+  int ntouched;
+  SS_COUNTER_TYPE ninsn;	/* instructions so far */
+  SS_ADDR_TYPE bb_pc;		/* block being executed */
+  int bb_open;			/* bb_pc valid? */
+  unsigned int bb_len;		/* its instructions not yet counted */
+
+  /* finished intervals */
+  double *vecs;			/* [interval][BBV_DIMS] projected vectors */
+  SS_COUNTER_TYPE *lens;	/* [interval] instructions */
+  int nintervals;
+  int intervals_size;
+};
+
+/* hash a block's starting PC */
+#define BBV_HASH(PC, SIZE)	((((PC) >> 3) * 2654435761u) & ((SIZE) - 1))
+
+/* uniform random value in [-1, 1] */
+#define RAND_UNIT()		(2.0 * (double)random() / 2147483647.0 - 1.0)
+
+/* create a basic-block vector profile with INTERVAL instructions per
+   interval; if FD is non-NULL the raw vectors are also written to it in
+   the SimPoint tool's `.bb' format */
+struct bbv_t *
+bbv_create(SS_COUNTER_TYPE interval, FILE *fd)
+{
+  struct bbv_t *bbv;
+
+  if (interval <= 0)
+    fatal("basic-block vector interval must be positive");
+
+  if (!(bbv = calloc(1, sizeof(struct bbv_t))))
+    fatal("out of virtual memory");
+  bbv->interval = interval;
+  bbv->fd = fd;
+
+  bbv->htab_size = 4096;
+  if (!(bbv->htab = calloc(bbv->htab_size, sizeof(struct bbv_block))))
+    fatal("out of virtual memory");
+
+  return bbv;
+}
+
+/* double the block hash table */
+static void
+bbv_grow_htab(struct bbv_t *bbv)
+{
+  struct bbv_block *old = bbv->htab;
+  int i, j, old_size = bbv->htab_size;
+
+  bbv->htab_size *= 2;
+  if (!(bbv->htab = calloc(bbv->htab_size, sizeof(struct bbv_block))))
+    fatal("out of virtual memory");
+
+  for (i = 0; i < old_size; i++)
+    if (old[i].pc)
+    {
+      for (j = BBV_HASH(old[i].pc, bbv->htab_size);
+           bbv->htab[j].pc;
+           j = (j + 1) & (bbv->htab_size - 1))
+        /* nada */;
+      bbv->htab[j] = old[i];
+    }
+  free(old);
+}
+
+/* the id of the block starting at PC, assigned on first sight along with
+   its row of the random projection */
+static int
+bbv_block_id(struct bbv_t *bbv, SS_ADDR_TYPE pc)
+{
+  int i, d;
+
+  for (i = BBV_HASH(pc, bbv->htab_size);
+       bbv->htab[i].pc;
+       i = (i + 1) & (bbv->htab_size - 1))
+    if (bbv->htab[i].pc == pc)
+      return bbv->htab[i].id;
+
+  /* new block */
+  if (bbv->nblocks == bbv->blocks_size)
+  {
+    bbv->blocks_size = bbv->blocks_size ? 2 * bbv->blocks_size : 1024;
+    bbv->counts = realloc(bbv->counts,
+                          bbv->blocks_size * sizeof(unsigned int));
+    bbv->touched = realloc(bbv->touched, bbv->blocks_size * sizeof(int));
+    bbv->proj = realloc(bbv->proj,
+                        bbv->blocks_size * BBV_DIMS * sizeof(double));
+    if (!bbv->counts || !bbv->touched || !bbv->proj)
+      fatal("out of virtual memory");
+  }
+  bbv->counts[bbv->nblocks] = 0;
+  for (d = 0; d < BBV_DIMS; d++)
+    bbv->proj[bbv->nblocks * BBV_DIMS + d] = RAND_UNIT();
+
+  bbv->htab[i].pc = pc;
+  bbv->htab[i].id = bbv->nblocks;
+  if (2 * ++bbv->nblocks > bbv->htab_size)
+    bbv_grow_htab(bbv);
+
+  return bbv->nblocks - 1;
+}
+
+/* count the instructions of the current block executed so far */
+static void
+bbv_count_block(struct bbv_t *bbv)
+{
+  int id;
+
+  if (bbv->bb_len == 0)
+    return;
+
+  id = bbv_block_id(bbv, bbv->bb_pc);
+  if (bbv->counts[id] == 0)
+    bbv->touched[bbv->ntouched++] = id;
+  bbv->counts[id] += bbv->bb_len;
+  bbv->bb_len = 0;
+}
+
+/* close the current interval: write its raw vector, keep its normalized
+   projection, and start a new one */
+static void
+bbv_end_interval(struct bbv_t *bbv)
+{
+  double *vec;
+  int i, d, id;
+
+  bbv_count_block(bbv);
+  if (bbv->ninsn == 0)
+    return;
+
+  if (bbv->nintervals == bbv->intervals_size)
+  {
+    bbv->intervals_size = bbv->intervals_size ? 2 * bbv->intervals_size : 256;
+    bbv->vecs = realloc(bbv->vecs,
+                        bbv->intervals_size * BBV_DIMS * sizeof(double));
+    bbv->lens = realloc(bbv->lens,
+                        bbv->intervals_size * sizeof(SS_COUNTER_TYPE));
+    if (!bbv->vecs || !bbv->lens)
+      fatal("out of virtual memory");
+  }
+  vec = &bbv->vecs[bbv->nintervals * BBV_DIMS];
+  bbv->lens[bbv->nintervals] = bbv->ninsn;
+  bbv->nintervals++;
+
+  if (bbv->fd)
+    fprintf(bbv->fd, "T");
+  for (d = 0; d < BBV_DIMS; d++)
+    vec[d] = 0.0;
+  for (i = 0; i < bbv->ntouched; i++)
+  {
+    double frac;
+
+    id = bbv->touched[i];
+    if (bbv->fd)
+      fprintf(bbv->fd, ":%d:%u ", id + 1, bbv->counts[id]);
+
+    /* normalize, so intervals of any length compare */
+    frac = (double)bbv->counts[id] / (double)bbv->ninsn;
+    for (d = 0; d < BBV_DIMS; d++)
+      vec[d] += frac * bbv->proj[id * BBV_DIMS + d];
+    bbv->counts[id] = 0;
+  }
+  if (bbv->fd)
+    fprintf(bbv->fd, "\n");
+
+  bbv->ntouched = 0;
+  bbv->ninsn = 0;
+}
+
+/* record the execution of the instruction at PC; ENDS_BLOCK is non-zero
+   for control transfers and traps, which end a basic block */
+void
+bbv_inst(struct bbv_t *bbv, SS_ADDR_TYPE pc, int ends_block)
+{
+  if (!bbv->bb_open)
+  {
+    bbv->bb_pc = pc;
+    bbv->bb_open = TRUE;
+  }
+  bbv->bb_len++;
+  bbv->ninsn++;
+
+  if (ends_block)
+  {
+    bbv_count_block(bbv);
+    bbv->bb_open = FALSE;
+  }
+
+  /* a block straddling an interval boundary is split between the two */
+  if (bbv->ninsn >= bbv->interval)
+    bbv_end_interval(bbv);
+}
+
+/* close the last (partial) interval; returns the number of intervals */
+int
+bbv_finish(struct bbv_t *bbv)
+{
+  bbv_end_interval(bbv);
+  if (bbv->fd)
+    fflush(bbv->fd);
+
+  return bbv->nintervals;
+}
+
+/* squared distance between two projected vectors */
+static double
+vec_dist2(double *a, double *b)
+{
+  double sum = 0.0, diff;
+  int d;
+
+  for (d = 0; d < BBV_DIMS; d++)
+  {
+    diff = a[d] - b[d];
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+/* cluster the N vectors VECS into K clusters, seeded with K distinct random
+   vectors; fills ASSIGN and CENTERS and returns the distortion (sum of
+   squared distances to the assigned centers) */
+static double
+kmeans(double *vecs, int n, int k, int *assign, double *centers)
+{
+  int i, j, c, d, best, iter, changed, *sizes;
+  double dist, best_dist, distortion;
+
+  if (!(sizes = calloc(k, sizeof(int))))
+    fatal("out of virtual memory");
+
+  /* seed: K distinct intervals, a partial Fisher-Yates shuffle */
+  for (i = 0; i < n; i++)
+    assign[i] = i;
+  for (c = 0; c < k; c++)
+  {
+    j = c + (int)(random() % (n - c));
+    i = assign[c];
+    assign[c] = assign[j];
+    assign[j] = i;
+    memcpy(&centers[c * BBV_DIMS], &vecs[assign[c] * BBV_DIMS],
+           BBV_DIMS * sizeof(double));
+  }
+  for (i = 0; i < n; i++)
+    assign[i] = -1;
+
+  for (iter = 0; iter < KMEANS_MAX_ITERS; iter++)
+  {
+    /* assign each vector to its nearest center */
+    changed = FALSE;
+    for (i = 0; i < n; i++)
+    {
+      best = 0;
+      best_dist = vec_dist2(&vecs[i * BBV_DIMS], &centers[0]);
+      for (c = 1; c < k; c++)
+      {
+        dist = vec_dist2(&vecs[i * BBV_DIMS], &centers[c * BBV_DIMS]);
+        if (dist < best_dist)
+        {
+          best = c;
+          best_dist = dist;
+        }
+      }
+      if (assign[i] != best)
+      {
+        assign[i] = best;
+        changed = TRUE;
+      }
+    }
+    if (!changed)
+      break;
+
+    /* move each center to the mean of its vectors; an emptied cluster
+       keeps its old center */
+    for (c = 0; c < k; c++)
+      sizes[c] = 0;
+    for (i = 0; i < n; i++)
+      sizes[assign[i]]++;
+    for (c = 0; c < k; c++)
+      if (sizes[c])
+        for (d = 0; d < BBV_DIMS; d++)
+          centers[c * BBV_DIMS + d] = 0.0;
+    for (i = 0; i < n; i++)
+      for (d = 0; d < BBV_DIMS; d++)
+        centers[assign[i] * BBV_DIMS + d] += vecs[i * BBV_DIMS + d];
+    for (c = 0; c < k; c++)
+      if (sizes[c])
+        for (d = 0; d < BBV_DIMS; d++)
+          centers[c * BBV_DIMS + d] /= (double)sizes[c];
+  }
+
+  distortion = 0.0;
+  for (i = 0; i < n; i++)
+    distortion += vec_dist2(&vecs[i * BBV_DIMS],
+                            &centers[assign[i] * BBV_DIMS]);
+
+  free(sizes);
+  return distortion;
+}
+
+/* Bayesian Information Criterion of a clustering of N vectors into K
+   clusters with distortion DISTORTION (Pelleg and Moore, ICML 2000, under
+   the identical spherical Gaussian assumption); higher is better */
+static double
+kmeans_bic(int *assign, int n, int k, double distortion)
+{
+  double variance, loglike, rn, params;
+  int c, i, *sizes;
+
+  if (!(sizes = calloc(k, sizeof(int))))
+    fatal("out of virtual memory");
+  for (i = 0; i < n; i++)
+    sizes[assign[i]]++;
+
+  variance = (n > k) ? distortion / (double)(n - k) : 0.0;
+  variance = MAX(variance, 1e-12);
+
+  loglike = 0.0;
+  for (c = 0; c < k; c++)
+  {
+    if (!sizes[c])
+      continue;
+    rn = (double)sizes[c];
+    loglike += rn * log(rn) - rn * log((double)n)
+      - rn / 2.0 * log(2.0 * M_PI)
+      - rn * BBV_DIMS / 2.0 * log(variance)
+      - (rn - k) / 2.0;
+  }
+  params = (k - 1) + BBV_DIMS * k + 1;
+
+  free(sizes);
+  return loglike - params / 2.0 * log((double)n);
+}
+
+/* order simulation points by interval */
+static int
+simpoint_cmp(const void *a, const void *b)
+{
+  SS_COUNTER_TYPE ia = ((struct simpoint_t *)a)->index;
+  SS_COUNTER_TYPE ib = ((struct simpoint_t *)b)->index;
+
+  return (ia < ib) ? -1 : (ia > ib);
+}
+
+/* choose at most MAX_K simulation points from the finished profile BBV,
+   trying NTRIES random k-means seedings per k; returns the number of points
+   and sets *POINTS to them, sorted by interval */
+int
+simpoint_cluster(struct bbv_t *bbv, int max_k, int ntries,
+                 struct simpoint_t **points)
+{
+  int n = bbv->nintervals;
+  int i, c, k, best_k, try, num, *assign, *best_assign, *all_assign, *sizes;
+  double *centers, *bic, distortion, best_distortion, bic_min, bic_max;
+  double total, dist, *best_dist;
+  struct simpoint_t *pts;
+
+  if (n == 0)
+    fatal("no intervals to choose simulation points from");
+  max_k = MIN(max_k, n);
+  ntries = MAX(ntries, 1);
+
+  assign = calloc(n, sizeof(int));
+  all_assign = calloc(n * max_k, sizeof(int));
+  centers = calloc(max_k * BBV_DIMS, sizeof(double));
+  bic = calloc(max_k + 1, sizeof(double));
+  if (!assign || !all_assign || !centers || !bic)
+    fatal("out of virtual memory");
+
+  /* best clustering for each k, and its score */
+  for (k = 1; k <= max_k; k++)
+  {
+    best_assign = &all_assign[(k - 1) * n];
+    best_distortion = -1.0;
+    for (try = 0; try < ntries; try++)
+    {
+      distortion = kmeans(bbv->vecs, n, k, assign, centers);
+      if (best_distortion < 0.0 || distortion < best_distortion)
+      {
+        best_distortion = distortion;
+        memcpy(best_assign, assign, n * sizeof(int));
+      }
+    }
+    bic[k] = kmeans_bic(best_assign, n, k, best_distortion);
+  }
+
+  /* smallest k that scores nearly as well as the best */
+  bic_min = bic_max = bic[1];
+  for (k = 2; k <= max_k; k++)
+  {
+    bic_min = MIN(bic_min, bic[k]);
+    bic_max = MAX(bic_max, bic[k]);
+  }
+  for (best_k = 1; best_k < max_k; best_k++)
+    if (bic[best_k] >= bic_min + BIC_THRESHOLD * (bic_max - bic_min))
+      break;
+  best_assign = &all_assign[(best_k - 1) * n];
+
+  /* recompute the chosen clusters' centroids */
+  memset(centers, 0, best_k * BBV_DIMS * sizeof(double));
+  if (!(best_dist = calloc(best_k, sizeof(double)))
+      || !(sizes = calloc(best_k, sizeof(int)))
+      || !(pts = calloc(best_k, sizeof(struct simpoint_t))))
+    fatal("out of virtual memory");
+  for (i = 0; i < n; i++)
+  {
+    sizes[best_assign[i]]++;
+    for (c = 0; c < BBV_DIMS; c++)
+      centers[best_assign[i] * BBV_DIMS + c] += bbv->vecs[i * BBV_DIMS + c];
+  }
+  for (k = 0; k < best_k; k++)
+    for (c = 0; c < BBV_DIMS; c++)
+      if (sizes[k])
+        centers[k * BBV_DIMS + c] /= (double)sizes[k];
+
+  /* each cluster is represented by its interval nearest the centroid and
+     weighted by its share of all instructions executed */
+  total = 0.0;
+  for (k = 0; k < best_k; k++)
+  {
+    pts[k].index = -1;
+    pts[k].weight = 0.0;
+  }
+  for (i = 0; i < n; i++)
+  {
+    k = best_assign[i];
+    dist = vec_dist2(&bbv->vecs[i * BBV_DIMS], &centers[k * BBV_DIMS]);
+    if (pts[k].index < 0 || dist < best_dist[k])
+    {
+      pts[k].index = i;
+      best_dist[k] = dist;
+    }
+    pts[k].weight += (double)bbv->lens[i];
+    total += (double)bbv->lens[i];
+  }
+
+  /* drop clusters k-means emptied */
+  for (num = 0, k = 0; k < best_k; k++)
+    if (pts[k].index >= 0)
+    {
+      pts[num].index = pts[k].index;
+      pts[num].weight = pts[k].weight / total;
+      num++;
+    }
+  qsort(pts, num, sizeof(struct simpoint_t), simpoint_cmp);
+
+  free(assign);
+  free(all_assign);
+  free(centers);
+  free(bic);
+  free(best_dist);
+  free(sizes);
+
+  *points = pts;
+  return num;
+}
+
+/* write NUM simulation points POINTS, of INTERVAL instructions each, to
+   FNAME */
+void
+simpoint_write(char *fname, SS_COUNTER_TYPE interval,
+               struct simpoint_t *points, int num)
+{
+  FILE *fd;
+  int i;
+
+  if (!(fd = fopen(fname, "w")))
+    fatal("cannot create simulation points file `%s'", fname);
+
+  fprintf(fd, "# simulation points: <interval index> <weight>\n");
+  fprintf(fd, "interval %.0f\n", (double)interval);
+  for (i = 0; i < num; i++)
+    fprintf(fd, "%.0f %.6f\n", (double)points[i].index, points[i].weight);
+
+  if (fclose(fd) != 0)
+    fatal("cannot write simulation points file `%s'", fname);
+}
+
+/* read simulation points from FNAME; returns the number of points, sorted
+   by interval, and sets *INTERVAL and *POINTS */
+int
+simpoint_read(char *fname, SS_COUNTER_TYPE *interval,
+              struct simpoint_t **points)
+{
+  FILE *fd;
+  char line[256], *p;
+  double index, weight, len = 0.0;
+  int num = 0, size = 0, lineno = 0;
+  struct simpoint_t *pts = NULL;
+
+  if (!(fd = fopen(fname, "r")))
+    fatal("cannot open simulation points file `%s'", fname);
+
+  while (fgets(line, sizeof(line), fd))
+  {
+    lineno++;
+    for (p = line; *p == ' ' || *p == '\t'; p++)
+      /* nada */;
+    if (*p == '#' || *p == '\n' || *p == '\0')
+      continue;
+
+    if (!strncmp(p, "interval", 8))
+    {
+      if (sscanf(p + 8, "%lf", &len) != 1 || len < 1.0)
+        fatal("%s:%d: bad interval length", fname, lineno);
+      continue;
+    }
+
+    if (sscanf(p, "%lf %lf", &index, &weight) != 2
+        || index < 0.0 || weight < 0.0)
+      fatal("%s:%d: expected `<interval index> <weight>'", fname, lineno);
+    if (num == size)
+    {
+      size = size ? 2 * size : 16;
+      if (!(pts = realloc(pts, size * sizeof(struct simpoint_t))))
+        fatal("out of virtual memory");
+    }
+    pts[num].index = (SS_COUNTER_TYPE)index;
+    pts[num].weight = weight;
+    num++;
+  }
+  fclose(fd);
+
+  if (len == 0.0)
+    fatal("simulation points file `%s' has no `interval' line", fname);
+  if (num == 0)
+    fatal("simulation points file `%s' has no points", fname);
+  qsort(pts, num, sizeof(struct simpoint_t), simpoint_cmp);
+
+  *interval = (SS_COUNTER_TYPE)len;
+  *points = pts;
+  return num;
+}
@@ -0,0 +1,82 @@
+/*
+ * simpoint.h - basic-block vector profiling and simulation point selection
+ *
+ * This file is a part of the SimpleScalar tool suite, and is distributed
+ * under the same terms as the rest of the tool suite; see the copyright
+ * notice in any of the original SimpleScalar sources.
+ *
+ */
+
+#ifndef SIMPOINT_H
+#define SIMPOINT_H
+
+#include <stdio.h>
+
+#include "ss.h"
+
+/*
+ * SimPoint-style sampled simulation (Sherwood et al., ASPLOS 2002).  A
+ * functional profiling run (sim-profile -bbv:interval) splits execution into
+ * fixed-size intervals and records, for each one, a basic-block vector: how
+ * many instructions it executed in each basic block.  Intervals with similar
+ * vectors execute similar code and behave alike, so the vectors are
+ * randomly projected down to a few dimensions and clustered with k-means;
+ * k is the smallest whose Bayesian Information Criterion score comes close
+ * to the best one tried.  The interval nearest each cluster's centroid
+ * becomes a simulation point, weighted by the share of execution its
+ * cluster covers.  Hydra (-simpoint:file) then simulates only those
+ * intervals in detail and fast-forwards functionally between them.
+ *
+ * The simulation points file is plain text: `#' comments, an
+ * `interval <insts>' line, then one `<interval index> <weight>' line per
+ * point.  Interval I covers instructions I * insts up to (I + 1) * insts.
+ * Profile with the same arguments and redirections as the sampled run:
+ * a program's libc may take different paths depending on, for example,
+ * whether stdout is a file or /dev/null.
+ */
+
+/* a basic-block vector profile under construction */
+struct bbv_t;
+
+/* a simulation point */
+struct simpoint_t
+{
+  SS_COUNTER_TYPE index;	/* interval index */
+  double weight;		/* share of execution it represents */
+};
+
+/* create a basic-block vector profile with INTERVAL instructions per
+   interval; if FD is non-NULL the raw vectors are also written to it in
+   the SimPoint tool's `.bb' format */
+struct bbv_t *
+bbv_create(SS_COUNTER_TYPE interval, FILE *fd);
+
+/* record the execution of the instruction at PC; ENDS_BLOCK is non-zero
+   for control transfers and traps, which end a basic block */
+void
+bbv_inst(struct bbv_t *bbv, SS_ADDR_TYPE pc, int ends_block);
+
+/* close the last (partial) interval; returns the number of intervals */
+int
+bbv_finish(struct bbv_t *bbv);
+
+/* choose at most MAX_K simulation points from the finished profile BBV,
+   trying NTRIES random k-means seedings per k; returns the number of points
+   and sets *POINTS to them, sorted by interval */
+int
+simpoint_cluster(struct bbv_t *bbv, int max_k, int ntries,
+		 struct simpoint_t **points);
+
+/* write NUM simulation points POINTS, of INTERVAL instructions each, to
+   FNAME */
+void
+simpoint_write(char *fname, SS_COUNTER_TYPE interval,
+	       struct simpoint_t *points, int num);
+
+/* read simulation points from FNAME; returns the number of points, sorted
+   by interval, and sets *INTERVAL and *POINTS */
+int
+simpoint_read(char *fname, SS_COUNTER_TYPE *interval,
+	      struct simpoint_t **points);
+
+#endif /* SIMPOINT_H */
@@ -87,31 +87,49 @@
 #include "eval.h"
 #include "stats.h"
 
-/* evaluate a stat as an expression */
-struct eval_value_t
-stat_eval_ident(struct eval_state_t *es)/* an expression evaluator */
+/* default expression error value, eval_err is also set */
+static struct eval_value_t err_value = { et_int, { 0 } };
+
+/* hash stat name NAME into the stat database hash table */
+static unsigned int
+stat_hash(char *name)			/* stat name */
 {
-  struct stat_sdb_t *sdb = es->user_ptr;
-  struct stat_stat_t *stat;
-  static struct eval_value_t err_value = { et_int, { 0 } };
-  struct eval_value_t val;
+  unsigned int h = 0;
 
-  /* locate the stat variable */
-  for (stat = sdb->stats; stat != NULL; stat = stat->next)
-    {
-      if (!strcmp(stat->name, es->tok_buf))
-	{
-	  /* found it! */
-	  break;
-	}
-    }
-  if (!stat)
+  while (*name)
+    h = h * 31 + (unsigned char)*name++;
+  return (h ^ (h >> 10)) & (STAT_HTAB_SZ - 1);
+}
+
+/* evaluate formula stat STAT into *VAL, returns FALSE if it has no value,
+   eval_error tells why */
+static int
+formula_value(struct stat_sdb_t *sdb,	/* stat database */
+	      struct stat_stat_t *stat,	/* formula stat */
+	      struct eval_value_t *val)	/* value */
+{
+  struct eval_state_t *es;
+  char *endp;
+
+  if (stat->variant.for_formula.expr)
     {
-      /* could not find stat variable */
-      eval_error = ERR_UNDEFVAR;
-      return err_value;
+      *val = eval_run(stat->variant.for_formula.expr, stat_eval_node, sdb);
+      return eval_error == ERR_NOERR;
     }
-  /* else, return the value of stat */
+
+  /* malformed, evaluate the text to get the same error as ever */
+  es = eval_new(stat_eval_ident, sdb);
+  *val = eval_expr(es, stat->variant.for_formula.formula, &endp);
+  eval_delete(es);
+  return eval_error == ERR_NOERR && *endp == '\0';
+}
+
+/* return the value of stat STAT as an expression value */
+static struct eval_value_t
+stat_eval_value(struct stat_sdb_t *sdb,	/* stat database */
+		struct stat_stat_t *stat)/* stat variable */
+{
+  struct eval_value_t val;
 
   /* convert the stat variable value to a typed expression value */
   switch (stat->sc)
@@ -144,20 +162,15 @@ stat_eval_ident(struct eval_state_t *es)/* an expression evaluator */
       fatal("stat distributions not allowed in formula expressions");
       break;
     case sc_formula:
-      {
-	/* instantiate a new evaluator to avoid recursion problems */
-	struct eval_state_t *es = eval_new(stat_eval_ident, sdb);
-	char *endp;
-
-	val = eval_expr(es, stat->variant.for_formula.formula, &endp);
-	if (eval_error != ERR_NOERR || *endp != '\0')
-	  {
-	    /* pass through eval_error */
-	    val = err_value;
-	  }
-	/* else, use value returned */
-	eval_delete(es);
-      }
+      if (!formula_value(sdb, stat, &val))
+	{
+	  /* pass through eval_error */
+	  val = err_value;
+	}
+      break;
+    case sc_sample:
+      val.type = et_double;
+      val.value.as_double = stat->variant.for_sample.mean;
       break;
     default:
       panic("bogus stat class");
@@ -166,6 +179,45 @@ stat_eval_ident(struct eval_state_t *es)/* an expression evaluator */
   return val;
 }
 
+/* evaluate a stat as an expression */
+struct eval_value_t
+stat_eval_ident(struct eval_state_t *es)/* an expression evaluator */
+{
+  struct stat_sdb_t *sdb = es->user_ptr;
+  struct stat_stat_t *stat;
+
+  /* locate the stat variable */
+  stat = stat_find_stat(sdb, es->tok_buf);
+  if (!stat)
+    {
+      /* could not find stat variable */
+      eval_error = ERR_UNDEFVAR;
+      return err_value;
+    }
+
+  return stat_eval_value(sdb, stat);
+}
+
+/* evaluate a stat named in a compiled formula, the node caches the stat */
+struct eval_value_t
+stat_eval_node(struct eval_node_t *node,/* identifier node */
+	       void *user_ptr)		/* stat database */
+{
+  struct stat_sdb_t *sdb = user_ptr;
+
+  /* locate the stat variable, once it exists */
+  if (!node->ident_data)
+    node->ident_data = stat_find_stat(sdb, node->ident);
+  if (!node->ident_data)
+    {
+      /* could not find stat variable */
+      eval_error = ERR_UNDEFVAR;
+      return err_value;
+    }
+
+  return stat_eval_value(sdb, node->ident_data);
+}
+
 /* create a new stats database */
 struct stat_sdb_t *
 stat_new(void)
@@ -206,9 +258,14 @@ stat_delete(struct stat_sdb_t *sdb)	/* stats database */
 #endif  /* __GNUC__ */
 	case sc_float:
 	case sc_double:
-	case sc_formula:
+	case sc_sample:
 	  /* no other storage to deallocate */
 	  break;
+	case sc_formula:
+	  /* free compiled formula */
+	  eval_free(stat->variant.for_formula.expr);
+	  stat->variant.for_formula.expr = NULL;
+	  break;
 	case sc_dist:
 	  /* free distribution array */
 	  free(stat->variant.for_dist.arr);
@@ -239,6 +296,9 @@ stat_delete(struct stat_sdb_t *sdb)	/* stats database */
       free(stat);
     }
   sdb->stats = NULL;
+  sdb->stats_tail = NULL;
+  for (i=0; i<STAT_HTAB_SZ; i++)
+    sdb->htab[i] = NULL;
   eval_delete(sdb->evaluator);
   sdb->evaluator = NULL;
   free(sdb);
@@ -249,18 +309,24 @@ static void
 add_stat(struct stat_sdb_t *sdb,	/* stat database */
 	 struct stat_stat_t *stat)	/* stat variable */
 {
-  struct stat_stat_t *elt, *prev;
-
-  /* append at end of stat database list */
-  for (prev=NULL, elt=sdb->stats; elt != NULL; prev=elt, elt=elt->next)
-    /* nada */;
+  struct stat_stat_t **bucket;
 
   /* append stat to stats chain */
-  if (prev != NULL)
-    prev->next = stat;
-  else /* prev == NULL */
+  if (sdb->stats_tail != NULL)
+    sdb->stats_tail->next = stat;
+  else /* empty database */
     sdb->stats = stat;
+  sdb->stats_tail = stat;
   stat->next = NULL;
+
+  /* append to its hash bucket, so the first stat registered under a name
+     is the one found */
+  for (bucket = &sdb->htab[stat_hash(stat->name)];
+       *bucket != NULL;
+       bucket = &(*bucket)->hash_next)
+    /* nada */;
+  *bucket = stat;
+  stat->hash_next = NULL;
 }
 
 /* register an integer statistical variable */
@@ -516,12 +582,39 @@ stat_reg_sdist(struct stat_sdb_t *sdb,	/* stat database */
   return stat;
 }
 
+/* distribution samples logged since stat_record_begin() */
+struct sample_rec
+{
+  struct stat_stat_t *stat;	/* distribution */
+  unsigned int index;		/* index of the samples */
+  int nsamples;			/* number of samples */
+};
+static struct sample_rec *rec_log = NULL;
+static int rec_num = 0, rec_size = 0;
+static int recording = FALSE;
+
 /* add NSAMPLES to array or sparse array distribution STAT */
 void
 stat_add_samples(struct stat_stat_t *stat,/* stat database */
 		 unsigned int index,	/* distribution index of samples */
 		 int nsamples)		/* number of samples to add to dist */
 {
+  if (recording)
+    {
+      if (rec_num == rec_size)
+	{
+	  rec_size = rec_size ? 2 * rec_size : 64;
+	  rec_log = (struct sample_rec *)
+	    realloc(rec_log, rec_size * sizeof(struct sample_rec));
+	  if (!rec_log)
+	    fatal("out of virtual memory");
+	}
+      rec_log[rec_num].stat = stat;
+      rec_log[rec_num].index = index;
+      rec_log[rec_num].nsamples = nsamples;
+      rec_num++;
+    }
+
   switch (stat->sc)
     {
     case sc_dist:
@@ -577,6 +670,36 @@ stat_add_sample(struct stat_stat_t *stat,/* stat variable */
   stat_add_samples(stat, index, 1);
 }
 
+/* log the samples added to distributions from now on, until
+   stat_record_end() */
+void
+stat_record_begin(void)
+{
+  rec_num = 0;
+  recording = TRUE;
+}
+
+/* stop logging distribution samples, returns the number of stat_add_sample()
+   and stat_add_samples() calls logged */
+int
+stat_record_end(void)
+{
+  recording = FALSE;
+  return rec_num;
+}
+
+/* add the samples logged between the last stat_record_begin() and
+   stat_record_end() TIMES more times */
+void
+stat_record_replay(int times)
+{
+  int i;
+
+  for (i = 0; i < rec_num; i++)
+    stat_add_samples(rec_log[i].stat, rec_log[i].index,
+		     rec_log[i].nsamples * times);
+}
+
 /* register a double statistical formula, the formula is evaluated when the
    statistic is printed, the formula expression may reference any registered
    statistical variable and, in addition, the standard operators '(', ')', '+',
@@ -592,6 +715,8 @@ stat_reg_formula(struct stat_sdb_t *sdb,/* stat database */
 		 char *format)		/* optional variable output format */
 {
   struct stat_stat_t *stat;
+  enum eval_err_t err = eval_error;
+  char *endp;
 
   stat = (struct stat_stat_t *)calloc(1, sizeof(struct stat_stat_t));
   if (!stat)
@@ -603,12 +728,119 @@ stat_reg_formula(struct stat_sdb_t *sdb,/* stat database */
   stat->sc = sc_formula;
   stat->variant.for_formula.formula = mystrdup(formula);
 
+  /* compile the formula once, a malformed one is left as text so that
+     printing it reports the error it always has */
+  stat->variant.for_formula.expr = eval_compile(formula, &endp);
+  if (stat->variant.for_formula.expr && *endp != '\0')
+    {
+      eval_free(stat->variant.for_formula.expr);
+      stat->variant.for_formula.expr = NULL;
+    }
+  eval_error = err;
+
+  /* link onto SDB chain */
+  add_stat(sdb, stat);
+
+  return stat;
+}
+
+/* standard normal quantile Z such that a normally distributed value lies
+   within Z standard deviations of its mean with probability CONFIDENCE
+   percent, found by bisection on the complementary error function */
+static double
+normal_quantile(double confidence)	/* confidence level, in percent */
+{
+  double lo = 0.0, hi = 10.0, mid, tail = (1.0 - confidence / 100.0) / 2.0;
+  int i;
+
+  for (i=0; i<64; i++)
+    {
+      mid = (lo + hi) / 2.0;
+      if (0.5 * erfc(mid / sqrt(2.0)) > tail)
+	lo = mid;
+      else
+	hi = mid;
+    }
+  return (lo + hi) / 2.0;
+}
+
+/* register a sampled metric, which collects one value per sample (e.g.,
+   per detailed simulation window) and prints their number, mean, sample
+   variance, and the half-width of the CONFIDENCE percent confidence
+   interval around the mean, assuming the mean is normally distributed */
+struct stat_stat_t *
+stat_reg_sample(struct stat_sdb_t *sdb,	/* stat database */
+		char *name,		/* stat variable name */
+		char *desc,		/* stat variable description */
+		double confidence,	/* confidence level, in percent */
+		char *format)		/* optional variable output format */
+{
+  struct stat_stat_t *stat;
+
+  if (confidence <= 0.0 || confidence >= 100.0)
+    fatal("confidence level of `%s' must be between 0%% and 100%%", name);
+
+  stat = (struct stat_stat_t *)calloc(1, sizeof(struct stat_stat_t));
+  if (!stat)
+    fatal("out of virtual memory");
+
+  stat->name = mystrdup(name);
+  stat->desc = mystrdup(desc);
+  stat->format = format ? format : "%12.6f";
+  stat->sc = sc_sample;
+  stat->variant.for_sample.confidence = confidence;
+  stat->variant.for_sample.z = normal_quantile(confidence);
+
   /* link onto SDB chain */
   add_stat(sdb, stat);
 
   return stat;
 }
 
+/* add sample VALUE to sampled metric STAT */
+void
+stat_sample_add(struct stat_stat_t *stat,/* stat variable */
+		double value)		/* sample value */
+{
+  struct stat_for_sample_t *s = &stat->variant.for_sample;
+  double delta;
+
+  if (stat->sc != sc_sample)
+    panic("stat `%s' is not a sampled metric", stat->name);
+
+  /* Welford's update, stable however many samples accumulate */
+  s->n++;
+  delta = value - s->mean;
+  s->mean += delta / s->n;
+  s->m2 += delta * (value - s->mean);
+}
+
+/* mean of the samples of sampled metric STAT */
+double
+stat_sample_mean(struct stat_stat_t *stat)/* stat variable */
+{
+  return stat->variant.for_sample.mean;
+}
+
+/* sample variance of the samples of sampled metric STAT */
+double
+stat_sample_var(struct stat_stat_t *stat)/* stat variable */
+{
+  struct stat_for_sample_t *s = &stat->variant.for_sample;
+
+  return s->n > 1 ? s->m2 / (s->n - 1) : 0.0;
+}
+
+/* half-width of the confidence interval around the mean of sampled metric
+   STAT, zero until it has two samples */
+double
+stat_sample_ci(struct stat_stat_t *stat)/* stat variable */
+{
+  struct stat_for_sample_t *s = &stat->variant.for_sample;
+
+  return s->n > 1 ? s->z * sqrt(stat_sample_var(stat) / s->n) : 0.0;
+}
+
 
 /* compare two indicies in a sparse array hash table, used by qsort() */
 static int
@@ -937,21 +1169,33 @@ stat_print_stat(struct stat_sdb_t *sdb,	/* stat database */
       print_sdist(stat, fd);
       break;
     case sc_formula:
+      fprintf(fd, "%-22s ", stat->name);
+      if (!formula_value(sdb, stat, &val))
+	fprintf(fd, "<error: %s>", eval_err_str[eval_error]);
+      else
+	fprintf(fd, stat->format, eval_as_double(val));
+      fprintf(fd, " # %s", stat->desc);
+      break;
+    case sc_sample:
       {
-	/* instantiate a new evaluator to avoid recursion problems */
-	struct eval_state_t *es = eval_new(stat_eval_ident, sdb);
-	char *endp;
-
-	fprintf(fd, "%-22s ", stat->name);
-	val = eval_expr(es, stat->variant.for_formula.formula, &endp);
-	if (eval_error != ERR_NOERR || *endp != '\0')
-	  fprintf(fd, "<error: %s>", eval_err_str[eval_error]);
-	else
-	  fprintf(fd, stat->format, eval_as_double(val));
-	fprintf(fd, " # %s", stat->desc);
-
-	/* done with the evaluator */
-	eval_delete(es);
+	char name[256];
+
+	sprintf(name, "%s.samples", stat->name);
+	fprintf(fd, "%-22s %12u # %s (samples)\n", name,
+		stat->variant.for_sample.n, stat->desc);
+	sprintf(name, "%s.mean", stat->name);
+	fprintf(fd, "%-22s ", name);
+	fprintf(fd, stat->format, stat_sample_mean(stat));
+	fprintf(fd, " # %s (mean)\n", stat->desc);
+	sprintf(name, "%s.var", stat->name);
+	fprintf(fd, "%-22s ", name);
+	fprintf(fd, stat->format, stat_sample_var(stat));
+	fprintf(fd, " # %s (sample variance)\n", stat->desc);
+	sprintf(name, "%s.ci", stat->name);
+	fprintf(fd, "%-22s ", name);
+	fprintf(fd, stat->format, stat_sample_ci(stat));
+	fprintf(fd, " # %s (+/- %g%% confidence interval)", stat->desc,
+		stat->variant.for_sample.confidence);
       }
       break;
     default:
@@ -984,7 +1228,9 @@ stat_find_stat(struct stat_sdb_t *sdb,	/* stat database */
 {
   struct stat_stat_t *stat;
 
-  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+  for (stat = sdb->htab[stat_hash(stat_name)];
+       stat != NULL;
+       stat = stat->hash_next)
     {
       if (!strcmp(stat->name, stat_name))
 	break;
@@ -992,6 +1238,135 @@ stat_find_stat(struct stat_sdb_t *sdb,	/* stat database */
   return stat;
 }
 
+/* set *VAL to the current value of scalar, formula or sampled (its mean)
+   stat STAT; returns FALSE if the value is undefined, e.g., a formula
+   divides by zero */
+int
+stat_value(struct stat_sdb_t *sdb,	/* stat database */
+	   struct stat_stat_t *stat,	/* stat variable */
+	   double *val)			/* value */
+{
+  struct eval_value_t v;
+
+  switch (stat->sc)
+    {
+    case sc_int:
+      *val = (double)*stat->variant.for_int.var;
+      break;
+    case sc_uint:
+      *val = (double)*stat->variant.for_uint.var;
+      break;
+#ifdef __GNUC__
+    case sc_llong:
+      *val = (double)*stat->variant.for_llong.var;
+      break;
+#endif /* __GNUC__ */
+    case sc_float:
+      *val = (double)*stat->variant.for_float.var;
+      break;
+    case sc_double:
+      *val = *stat->variant.for_double.var;
+      break;
+    case sc_formula:
+      if (!formula_value(sdb, stat, &v))
+	return FALSE;
+      *val = eval_as_double(v);
+      break;
+    case sc_sample:
+      *val = stat->variant.for_sample.mean;
+      break;
+    default:
+      fatal("stat distribution `%s' has no single value", stat->name);
+    }
+  return TRUE;
+}
+
+/* round V to the nearest integer, for storing into integer stats */
+#define ROUND(V)		((V) < 0.0 ? (V) - 0.5 : (V) + 0.5)
+
+/* number of scalar (integer and floating point) stats in SDB; a snapshot of
+   all of them, see stat_get_scalars(), needs this many doubles */
+int
+stat_num_scalars(struct stat_sdb_t *sdb)	/* stat database */
+{
+  struct stat_stat_t *stat;
+  int n = 0;
+
+  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+    if (stat->sc != sc_dist && stat->sc != sc_sdist && stat->sc != sc_formula
+	&& stat->sc != sc_sample)
+      n++;
+  return n;
+}
+
+/* copy the value of every scalar stat in SDB to VALS, in database order */
+void
+stat_get_scalars(struct stat_sdb_t *sdb,	/* stat database */
+		 double *vals)			/* stat_num_scalars() values */
+{
+  struct stat_stat_t *stat;
+
+  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+    switch (stat->sc)
+      {
+      case sc_int:
+	*vals++ = (double)*stat->variant.for_int.var;
+	break;
+      case sc_uint:
+	*vals++ = (double)*stat->variant.for_uint.var;
+	break;
+#ifdef __GNUC__
+      case sc_llong:
+	*vals++ = (double)*stat->variant.for_llong.var;
+	break;
+#endif /* __GNUC__ */
+      case sc_float:
+	*vals++ = (double)*stat->variant.for_float.var;
+	break;
+      case sc_double:
+	*vals++ = *stat->variant.for_double.var;
+	break;
+      default:
+	/* not a scalar */;
+      }
+}
+
+/* set every scalar stat in SDB from VALS, as filled by stat_get_scalars();
+   integer stats are rounded to the nearest value */
+void
+stat_set_scalars(struct stat_sdb_t *sdb,	/* stat database */
+		 double *vals)			/* stat_num_scalars() values */
+{
+  struct stat_stat_t *stat;
+
+  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+    switch (stat->sc)
+      {
+      case sc_int:
+	*stat->variant.for_int.var = (int)ROUND(*vals);
+	vals++;
+	break;
+      case sc_uint:
+	*stat->variant.for_uint.var = (unsigned int)ROUND(*vals);
+	vals++;
+	break;
+#ifdef __GNUC__
+      case sc_llong:
+	*stat->variant.for_llong.var = (long long)ROUND(*vals);
+	vals++;
+	break;
+#endif /* __GNUC__ */
+      case sc_float:
+	*stat->variant.for_float.var = (float)*vals++;
+	break;
+      case sc_double:
+	*stat->variant.for_double.var = *vals++;
+	break;
+      default:
+	/* not a scalar */;
+      }
+}
+
 #ifdef TESTIT
 
 void
@@ -102,6 +102,7 @@ enum stat_class_t {
   sc_dist,			/* array distribution stat */
   sc_sdist,			/* sparse array distribution stat */
   sc_formula,			/* stat expression formula */
+  sc_sample,			/* sampled metric: mean, variance, conf. int. */
   sc_NUM
 };
 
@@ -118,6 +119,9 @@ enum stat_class_t {
 #define HTAB_SZ			1024
 #define HTAB_HASH(I)		((((I) >> 8) ^ (I)) & (HTAB_SZ - 1))
 
+/* stat names are indexed with a hash table */
+#define STAT_HTAB_SZ		1024
+
 /* hash table bucket definition */
 struct bucket_t {
   struct bucket_t *next;	/* pointer to the next bucket */
@@ -147,6 +151,7 @@ typedef void
 /* statistical variable definition */
 struct stat_stat_t {
   struct stat_stat_t *next;	/* pointer to next stat in database list */
+  struct stat_stat_t *hash_next;/* next stat in the name hash bucket */
   char *name;			/* stat name */
   char *desc;			/* stat description */
   char *format;			/* stat output print format */
@@ -200,13 +205,26 @@ struct stat_stat_t {
     /* sc == sc_formula */
     struct stat_for_formula_t {
       char *formula;		/* stat formula, see eval.h for format */
+      struct eval_node_t *expr;	/* FORMULA compiled, NULL if it is
+				   malformed */
     } for_formula;
+    /* sc == sc_sample */
+    struct stat_for_sample_t {
+      double confidence;	/* confidence level of the interval, in % */
+      double z;			/* standard normal quantile for CONFIDENCE */
+      unsigned int n;		/* samples so far */
+      double mean;		/* running mean of the samples */
+      double m2;		/* running sum of squared deviations */
+    } for_sample;
   } variant;
 };
 
 /* statistical database */
 struct stat_sdb_t {
   struct stat_stat_t *stats;		/* list of stats in database */
+  struct stat_stat_t *stats_tail;	/* last stat in the list */
+  struct stat_stat_t *htab[STAT_HTAB_SZ];/* stats by name, in each bucket
+					   in registration order */
   struct eval_state_t *evaluator;	/* an expression evaluator */
 };
 
@@ -214,6 +232,11 @@ struct stat_sdb_t {
 struct eval_value_t
 stat_eval_ident(struct eval_state_t *es);/* expression stat to evaluate */
 
+/* evaluate a stat named in a compiled formula, see eval_compile() */
+struct eval_value_t
+stat_eval_node(struct eval_node_t *node,/* identifier node */
+	       void *user_ptr);		/* stat database */
+
 /* create a new stats database */
 struct stat_sdb_t *stat_new(void);
 
@@ -320,6 +343,22 @@ void
 stat_add_sample(struct stat_stat_t *stat,/* stat variable */
 		unsigned int index);	/* index of sample */
 
+/* log the samples added to distributions from now on, until
+   stat_record_end(); the simulator uses this to add the samples of a cycle
+   again for each cycle that would repeat it */
+void
+stat_record_begin(void);
+
+/* stop logging distribution samples, returns the number of stat_add_sample()
+   and stat_add_samples() calls logged */
+int
+stat_record_end(void);
+
+/* add the samples logged between the last stat_record_begin() and
+   stat_record_end() TIMES more times */
+void
+stat_record_replay(int times);
+
 /* register a double statistical formula, the formula is evaluated when the
    statistic is printed, the formula expression may reference any registered
    statistical variable and, in addition, the standard operators '(', ')', '+',
@@ -334,6 +373,35 @@ stat_reg_formula(struct stat_sdb_t *sdb,/* stat database */
 		 char *formula,		/* formula expression */
 		 char *format);		/* optional variable output format */
 
+/* register a sampled metric, which collects one value per sample (e.g.,
+   per detailed simulation window) and prints their number, mean, sample
+   variance, and the half-width of the CONFIDENCE percent confidence
+   interval around the mean, assuming the mean is normally distributed */
+struct stat_stat_t *
+stat_reg_sample(struct stat_sdb_t *sdb,	/* stat database */
+		char *name,		/* stat variable name */
+		char *desc,		/* stat variable description */
+		double confidence,	/* confidence level, in percent */
+		char *format);		/* optional variable output format */
+
+/* add sample VALUE to sampled metric STAT */
+void
+stat_sample_add(struct stat_stat_t *stat,/* stat variable */
+		double value);		/* sample value */
+
+/* mean of the samples of sampled metric STAT */
+double
+stat_sample_mean(struct stat_stat_t *stat);/* stat variable */
+
+/* sample variance of the samples of sampled metric STAT */
+double
+stat_sample_var(struct stat_stat_t *stat);/* stat variable */
+
+/* half-width of the confidence interval around the mean of sampled metric
+   STAT, zero until it has two samples */
+double
+stat_sample_ci(struct stat_stat_t *stat);/* stat variable */
+
 /* print the value of stat variable STAT */
 void
 stat_print_stat(struct stat_sdb_t *sdb,	/* stat database */
@@ -350,5 +418,29 @@ stat_print_stats(struct stat_sdb_t *sdb,/* stat database */
 struct stat_stat_t *
 stat_find_stat(struct stat_sdb_t *sdb,	/* stat database */
 	       char *stat_name);	/* stat name */
-	       
+
+/* set *VAL to the current value of scalar, formula or sampled (its mean)
+   stat STAT; returns FALSE if the value is undefined, e.g., a formula
+   divides by zero */
+int
+stat_value(struct stat_sdb_t *sdb,	/* stat database */
+	   struct stat_stat_t *stat,	/* stat variable */
+	   double *val);		/* value */
+
+/* number of scalar (integer and floating point) stats in SDB; a snapshot of
+   all of them, see stat_get_scalars(), needs this many doubles */
+int
+stat_num_scalars(struct stat_sdb_t *sdb);	/* stat database */
+
+/* copy the value of every scalar stat in SDB to VALS, in database order */
+void
+stat_get_scalars(struct stat_sdb_t *sdb,	/* stat database */
+		 double *vals);			/* stat_num_scalars() values */
+
+/* set every scalar stat in SDB from VALS, as filled by stat_get_scalars();
+   integer stats are rounded to the nearest value */
+void
+stat_set_scalars(struct stat_sdb_t *sdb,	/* stat database */
+		 double *vals);			/* stat_num_scalars() values */
+
 #endif /* STAT_H */
@@ -92,6 +92,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
@@ -208,6 +209,7 @@
 #include "sim.h"
 #include "endian.h"
 #include "syscall.h"
+#include "checkpoint.h"
 
 /* open(2) flags translation table for SimpleScalar target */
 struct
@@ -231,6 +233,56 @@ struct
 };
 #define SS_NFLAGS (sizeof(ss_flag_table) / sizeof(ss_flag_table[0]))
 
+/* read() and write() buffers in simulated memory that span at most this
+   many pages are transferred directly with readv()/writev(), when the
+   plain memory accessor is in use; other accessors (e.g., those that model
+   a cache) must see each byte, so they still go through a host buffer */
+#define SS_MAX_IOV_PAGES 64
+
+/* host files opened by the simulated program, indexed by descriptor, so
+   that checkpoints can record and later reopen them; stdin, stdout, and
+   stderr are the simulator's and are never in this table */
+#define SS_MAX_FILES 256
+static struct
+{
+  char *fname; /* file name as opened, NULL if not open */
+  int flags;   /* host open(2) flags, less create/truncate */
+} ss_files[SS_MAX_FILES];
+
+/* remember that descriptor FD now refers to FNAME, opened with FLAGS */
+static void
+ss_file_opened(int fd, char *fname, int flags)
+{
+  if (fd < 3 || fd >= SS_MAX_FILES)
+    return;
+
+  if (ss_files[fd].fname)
+    free(ss_files[fd].fname);
+  ss_files[fd].fname = mystrdup(fname);
+  ss_files[fd].flags = flags & ~(O_CREAT | O_TRUNC | O_EXCL);
+}
+
+/* forget descriptor FD */
+static void
+ss_file_closed(int fd)
+{
+  if (fd < 3 || fd >= SS_MAX_FILES || !ss_files[fd].fname)
+    return;
+
+  free(ss_files[fd].fname);
+  ss_files[fd].fname = NULL;
+}
+
+/* descriptor FD2 is now a copy of FD1 */
+static void
+ss_file_duped(int fd1, int fd2)
+{
+  if (fd1 < 3 || fd1 >= SS_MAX_FILES || !ss_files[fd1].fname)
+    ss_file_closed(fd2);
+  else
+    ss_file_opened(fd2, ss_files[fd1].fname, ss_files[fd1].flags);
+}
+
 /* syscall proxy handler, architect registers and memory are assumed to be
    precise when this function is called, register and memory are updated with
    the results of the sustem call */
@@ -283,6 +335,31 @@ void ss_syscall(mem_access_fn mem_fn, /* generic memory accessor */
   case SS_SYS_read:
   {
     char *buf;
+    struct iovec iov[SS_MAX_IOV_PAGES];
+    int niov = -1;
+
+    /* read straight into simulated memory, if possible */
+    if (mem_fn == mem_access)
+      niov = mem_iovec(Write, /*buf*/ regs_R[5], /*nbytes*/ regs_R[6],
+                       iov, SS_MAX_IOV_PAGES);
+    if (niov >= 0)
+    {
+      /*nread*/ regs_R[2] = readv(/*fd*/ regs_R[4], iov, niov);
+
+      /* check for error condition */
+      if (regs_R[2] != -1)
+      {
+        regs_R[7] = 0;
+        mem_iovec_done(/*buf*/ regs_R[5], /*nread*/ regs_R[2]);
+      }
+      else
+      {
+        /* got an error, return details */
+        regs_R[2] = errno;
+        regs_R[7] = 1;
+      }
+      break;
+    }
 
     /* allocate same-sized input buffer in host memory */
     if (!(buf = (char *)calloc(/*nbytes*/ regs_R[6], sizeof(char))))
@@ -312,6 +389,30 @@ void ss_syscall(mem_access_fn mem_fn, /* generic memory accessor */
   case SS_SYS_write:
   {
     char *buf;
+    struct iovec iov[SS_MAX_IOV_PAGES];
+    int niov = -1;
+
+    /* write straight from simulated memory, if possible */
+    if (mem_fn == mem_access)
+      niov = mem_iovec(Read, /*buf*/ regs_R[5], /*nbytes*/ regs_R[6],
+                       iov, SS_MAX_IOV_PAGES);
+    if (niov >= 0)
+    {
+      mem_iovec_done(/*buf*/ regs_R[5], /*nbytes*/ regs_R[6]);
+
+      /*nwritten*/ regs_R[2] = writev(/*fd*/ regs_R[4], iov, niov);
+
+      /* check for an error condition */
+      if (regs_R[2] == regs_R[6])
+        /*result*/ regs_R[7] = 0;
+      else
+      {
+        /* got an error, return details */
+        regs_R[2] = errno;
+        regs_R[7] = 1;
+      }
+      break;
+    }
 
     /* allocate same-sized output buffer in host memory */
     if (!(buf = (char *)calloc(/*nbytes*/ regs_R[6], sizeof(char))))
@@ -366,7 +467,10 @@ void ss_syscall(mem_access_fn mem_fn, /* generic memory accessor */
 
     /* check for an error condition */
     if (regs_R[2] != -1)
+    {
+      ss_file_opened(regs_R[2], buf, local_flags);
       regs_R[7] = 0;
+    }
     else
     {
       /* got an error, return details */
@@ -389,7 +493,10 @@ void ss_syscall(mem_access_fn mem_fn, /* generic memory accessor */
 
     /* check for an error condition */
     if (regs_R[2] != -1)
+    {
+      ss_file_closed(regs_R[4]);
       regs_R[7] = 0;
+    }
     else
     {
       /* got an error, return details */
@@ -410,7 +517,10 @@ void ss_syscall(mem_access_fn mem_fn, /* generic memory accessor */
 
     /* check for an error condition */
     if (regs_R[2] != -1)
+    {
+      ss_file_opened(regs_R[2], buf, O_WRONLY);
       regs_R[7] = 0;
+    }
     else
     {
       /* got an error, return details */
@@ -679,7 +789,10 @@ void ss_syscall(mem_access_fn mem_fn, /* generic memory accessor */
 
     /* check for an error condition */
     if (regs_R[2] != -1)
+    {
+      ss_file_duped(regs_R[4], regs_R[2]);
       regs_R[7] = 0;
+    }
     else
     {
       /* got an error, return details */
@@ -953,7 +1066,10 @@ void ss_syscall(mem_access_fn mem_fn, /* generic memory accessor */
 
     /* check for an error condition */
     if (regs_R[2] != -1)
+    {
+      ss_file_duped(regs_R[4], regs_R[5]);
       regs_R[7] = 0;
+    }
     else
     {
       /* got an error, return details */
@@ -1485,3 +1601,129 @@ void ss_syscall(mem_access_fn mem_fn, /* generic memory accessor */
     panic("invalid/unimplemented system call encountered, code %d", syscode);
   }
 }
+
+/* checkpoint record of one open file */
+struct ss_file_ckpt
+{
+  int fd;		/* descriptor */
+  int flags;		/* host open(2) flags */
+  long long offset;	/* file offset, -1 if not seekable */
+  int fname_len;	/* length of file name that follows, 0 for std fds */
+};
+
+/* files read from a checkpoint, waiting for ss_syscall_ckpt_reopen() */
+static struct ss_file_ckpt *pending_files = NULL;
+static char **pending_fnames = NULL;
+static int num_pending_files = 0;
+
+/* write the simulated program's open files, with their current offsets,
+   to checkpoint FD */
+void
+ss_syscall_ckpt_save(FILE *fd)
+{
+  struct ss_file_ckpt rec;
+  int i, num = 0;
+
+  for (i = 0; i < SS_MAX_FILES; i++)
+    if (i < 3 || ss_files[i].fname)
+      num++;
+
+  ckpt_put_tag(fd, "files");
+  CKPT_PUT(fd, num);
+  for (i = 0; i < SS_MAX_FILES; i++)
+  {
+    if (i >= 3 && !ss_files[i].fname)
+      continue;
+
+    rec.fd = i;
+    rec.flags = (i < 3) ? 0 : ss_files[i].flags;
+    rec.offset = lseek(i, 0, SEEK_CUR);
+    rec.fname_len = (i < 3) ? 0 : strlen(ss_files[i].fname) + 1;
+    CKPT_PUT(fd, rec);
+    if (rec.fname_len)
+      ckpt_write(fd, ss_files[i].fname, rec.fname_len);
+  }
+}
+
+/* read the simulated program's open files from checkpoint FD; the files
+   are reopened later by ss_syscall_ckpt_reopen(), because until the
+   checkpoint is closed its own descriptor may be one the program used */
+void
+ss_syscall_ckpt_restore(FILE *fd)
+{
+  int i;
+
+  ckpt_get_tag(fd, "files");
+  CKPT_GET(fd, num_pending_files);
+  pending_files = (struct ss_file_ckpt *)
+    calloc(num_pending_files, sizeof(struct ss_file_ckpt));
+  pending_fnames = (char **)calloc(num_pending_files, sizeof(char *));
+  if (!pending_files || !pending_fnames)
+    fatal("out of virtual memory");
+
+  for (i = 0; i < num_pending_files; i++)
+  {
+    CKPT_GET(fd, pending_files[i]);
+    if (pending_files[i].fname_len)
+    {
+      if (!(pending_fnames[i] = (char *)malloc(pending_files[i].fname_len)))
+        fatal("out of virtual memory");
+      ckpt_read(fd, pending_fnames[i], pending_files[i].fname_len);
+    }
+  }
+}
+
+/* reopen the files read by ss_syscall_ckpt_restore() on their original
+   descriptors, at their original offsets; stdout and stderr are not
+   touched, and stdin is only seeked back to where it was */
+void
+ss_syscall_ckpt_reopen(void)
+{
+  struct ss_file_ckpt *rec;
+  int i, host_fd;
+
+  for (i = 0; i < num_pending_files; i++)
+  {
+    rec = &pending_files[i];
+
+    /* stdin is still the program's input, so pick up where it left off;
+       stdout and stderr belong to the simulator, which may have been
+       started with them redirected elsewhere, and are left as they are */
+    if (rec->fd == 0)
+    {
+      if (rec->offset != -1 && lseek(0, rec->offset, SEEK_SET) == -1)
+        warn("checkpoint: stdin is not seekable, "
+             "input resumes from its current position");
+    }
+    else if (rec->fd >= 3)
+    {
+      if (fcntl(rec->fd, F_GETFD) != -1)
+        fatal("checkpoint: descriptor %d of `%s' is already in use",
+              rec->fd, pending_fnames[i]);
+      host_fd = open(pending_fnames[i], rec->flags);
+      if (host_fd == -1)
+        fatal("checkpoint: cannot reopen `%s'", pending_fnames[i]);
+      if (host_fd != rec->fd)
+      {
+        if (dup2(host_fd, rec->fd) == -1)
+          fatal("checkpoint: cannot move `%s' to descriptor %d",
+                pending_fnames[i], rec->fd);
+        close(host_fd);
+      }
+      ss_file_opened(rec->fd, pending_fnames[i], rec->flags);
+
+      if (rec->offset != -1 && lseek(rec->fd, rec->offset, SEEK_SET) == -1)
+        warn("checkpoint: cannot seek descriptor %d to offset %lld",
+             rec->fd, rec->offset);
+    }
+
+    if (pending_fnames[i])
+      free(pending_fnames[i]);
+  }
+
+  free(pending_files);
+  free(pending_fnames);
+  pending_files = NULL;
+  pending_fnames = NULL;
+  num_pending_files = 0;
+}
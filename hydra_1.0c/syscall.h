@@ -84,6 +84,7 @@
 #ifndef SYSCALL_H
 #define SYSCALL_H
 
+#include <stdio.h>
 #include <sys/types.h>
 #include <sys/time.h>
 
@@ -440,4 +441,18 @@ void
 ss_syscall(mem_access_fn mem_fn,	/* generic memory accessor */
 	   SS_INST_TYPE inst);		/* system call inst */
 
+/* write the simulated program's open files, and their offsets, to a
+   checkpoint */
+void
+ss_syscall_ckpt_save(FILE *fd);
+
+/* read the simulated program's open files from a checkpoint */
+void
+ss_syscall_ckpt_restore(FILE *fd);
+
+/* reopen the files read by ss_syscall_ckpt_restore(), once the checkpoint
+   file itself is closed */
+void
+ss_syscall_ckpt_reopen(void);
+
 #endif /* SYSCALL_H */
@@ -0,0 +1,137 @@
+/*
+ * tseries-read.c - convert a stats time series to CSV
+ *
+ * This file is a part of the SimpleScalar tool suite, and is distributed
+ * under the same terms as the rest of the tool suite; see the copyright
+ * notice in any of the original SimpleScalar sources.
+ *
+ * usage: tseries-read [-s <name>[,<name>...]] [-o <fname>] <series>
+ *
+ * Reads a stats time series (written with -stats:series) and prints one
+ * CSV line per interval: the cycle and instruction count at its end, the
+ * change of each counter over it, and each formula evaluated on those
+ * changes, e.g., the IPC or miss rate of the interval.  A formula that is
+ * undefined for an interval (say, divides by zero) is left empty.  With -s,
+ * only the named counters and formulas are printed, in the order given.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "misc.h"
+#include "ss.h"
+#include "stats.h"
+#include "tseries.h"
+#include "sim.h"
+
+static void
+usage(char *prog)
+{
+  fprintf(stderr,
+	  "usage: %s [-s <name>[,<name>...]] [-o <fname>] <series>\n", prog);
+  exit(1);
+}
+
+/* print value VAL of a CSV field to FD, integral values without a
+   fraction */
+static void
+print_value(FILE *fd, double val)
+{
+  if (val == (double)(long long)val)
+    fprintf(fd, ",%.0f", val);
+  else
+    fprintf(fd, ",%.6g", val);
+}
+
+int
+main(int argc, char **argv)
+{
+  struct tseries_reader_t *rd;
+  struct stat_sdb_t *sdb;
+  struct stat_stat_t **cols, *stat;
+  FILE *out = stdout;
+  char *fname = NULL, *select = NULL, *name;
+  int i, ncols;
+  double val;
+
+  /* where fatal() reports */
+  outfile = stderr;
+
+  for (i = 1; i < argc; i++)
+    {
+      if (!strcmp(argv[i], "-s") && i + 1 < argc)
+	select = argv[++i];
+      else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+	{
+	  out = fopen(argv[++i], "w");
+	  if (!out)
+	    fatal("cannot open output file `%s'", argv[i]);
+	}
+      else if (argv[i][0] != '-' && !fname)
+	fname = argv[i];
+      else
+	usage(argv[0]);
+    }
+  if (!fname)
+    usage(argv[0]);
+
+  rd = tseries_reader_open(fname);
+  if (!rd)
+    fatal("cannot open stats time series `%s'", fname);
+
+  /* the counters are the deltas of the interval read, so the formulas
+     evaluate on the interval */
+  sdb = stat_new();
+  for (i = 0; i < rd->hdr.ncounters; i++)
+    stat_reg_double(sdb, rd->counters[i], "", &rd->delta[i], 0.0, NULL);
+  for (i = 0; i < rd->hdr.nformulas; i++)
+    stat_reg_formula(sdb, rd->formulas[i], "", rd->exprs[i], NULL);
+
+  /* the columns printed */
+  cols = calloc(rd->hdr.ncounters + rd->hdr.nformulas + 1,
+		sizeof(struct stat_stat_t *));
+  if (!cols)
+    fatal("out of virtual memory");
+  ncols = 0;
+  if (select)
+    {
+      select = mystrdup(select);
+      for (name = strtok(select, ","); name; name = strtok(NULL, ","))
+	{
+	  if (!(stat = stat_find_stat(sdb, name)))
+	    fatal("no stat `%s' in stats time series `%s'", name, fname);
+	  if (ncols < rd->hdr.ncounters + rd->hdr.nformulas)
+	    cols[ncols++] = stat;
+	}
+    }
+  else
+    {
+      for (stat = sdb->stats; stat != NULL; stat = stat->next)
+	cols[ncols++] = stat;
+    }
+
+  fprintf(out, "cycle,insts");
+  for (i = 0; i < ncols; i++)
+    fprintf(out, ",%s", cols[i]->name);
+  fprintf(out, "\n");
+
+  while (tseries_reader_next(rd))
+    {
+      fprintf(out, "%.0f,%.0f", (double)rd->cycle, (double)rd->insts);
+      for (i = 0; i < ncols; i++)
+	{
+	  if (stat_value(sdb, cols[i], &val))
+	    print_value(out, val);
+	  else
+	    fprintf(out, ",");
+	}
+      fprintf(out, "\n");
+    }
+
+  tseries_reader_close(rd);
+  fclose(out);
+
+  return 0;
+}
@@ -0,0 +1,359 @@
+/*
+ * tseries.c - interval statistics time series
+ *
+ * This file is a part of the SimpleScalar tool suite, and is distributed
+ * under the same terms as the rest of the tool suite; see the copyright
+ * notice in any of the original SimpleScalar sources.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "misc.h"
+#include "ss.h"
+#include "stats.h"
+#include "tseries.h"
+
+/* bytes in a record header, and per changed counter */
+#define REC_HDR_SZ	(2 * sizeof(SS_COUNTER_TYPE) + sizeof(unsigned int))
+#define REC_PAIR_SZ	(sizeof(unsigned int) + sizeof(double))
+
+/* a sampled counter */
+struct ts_counter
+{
+  enum stat_class_t sc;		/* its type, sc_dist buckets are sc_uint */
+  void *var;			/* the variable */
+  double last;			/* its value at the last sample */
+};
+
+struct tseries_t
+{
+  ZFILE *zfd;			/* the file */
+  FILE *fd;
+  int ncounters;		/* counters sampled */
+  struct ts_counter *counters;
+  unsigned char *rec;		/* record being built, big enough for a
+				   change in every counter */
+};
+
+/* current value of counter C */
+static INLINE double
+counter_value(struct ts_counter *c)
+{
+  switch (c->sc)
+    {
+    case sc_int:
+      return (double)*(int *)c->var;
+    case sc_uint:
+      return (double)*(unsigned int *)c->var;
+#ifdef __GNUC__
+    case sc_llong:
+      return (double)*(long long *)c->var;
+#endif /* __GNUC__ */
+    case sc_float:
+      return (double)*(float *)c->var;
+    case sc_double:
+      return *(double *)c->var;
+    default:
+      panic("bogus time series counter class");
+      return 0.0;
+    }
+}
+
+/* write string STR to time series file FD, as its length (unsigned
+   short) and its characters */
+static void
+write_str(FILE *fd, char *str)
+{
+  unsigned short len = strlen(str);
+
+  if (fwrite(&len, sizeof(len), 1, fd) != 1
+      || fwrite(str, 1, len, fd) != len)
+    fatal("cannot write stats time series");
+}
+
+/* open time series file FNAME of the counters and formulas in SDB, sampled
+   every INTERVAL cycles, or instructions if BY_INSTS; stats registered
+   later are not included */
+struct tseries_t *
+tseries_open(char *fname, struct stat_sdb_t *sdb,
+	     unsigned int interval, int by_insts)
+{
+  struct tseries_t *ts;
+  struct tseries_hdr hdr;
+  struct stat_stat_t *stat;
+  struct ts_counter *c;
+  char name[1024];
+  unsigned int i;
+
+  ts = calloc(1, sizeof(struct tseries_t));
+  if (!ts)
+    fatal("out of virtual memory");
+
+  ts->zfd = zfopen(fname, "w");
+  if (!ts->zfd)
+    fatal("cannot open stats time series file `%s'", fname);
+  ts->fd = ts->zfd->fd;
+
+  /* count the counters and formulas */
+  hdr.ncounters = hdr.nformulas = 0;
+  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+    {
+      switch (stat->sc)
+	{
+	case sc_dist:
+	  hdr.ncounters += stat->variant.for_dist.arr_sz;
+	  break;
+	case sc_formula:
+	  hdr.nformulas++;
+	  break;
+	case sc_sdist:
+	case sc_sample:
+	  /* not sampled */
+	  break;
+	default:
+	  hdr.ncounters++;
+	  break;
+	}
+    }
+
+  ts->ncounters = hdr.ncounters;
+  ts->counters = calloc(hdr.ncounters + 1, sizeof(struct ts_counter));
+  ts->rec = malloc(REC_HDR_SZ + hdr.ncounters * REC_PAIR_SZ);
+  if (!ts->counters || !ts->rec)
+    fatal("out of virtual memory");
+
+  memcpy(hdr.magic, TSERIES_MAGIC, sizeof(hdr.magic));
+  hdr.byte_order = 0x01020304;
+  hdr.interval = interval;
+  hdr.by_insts = by_insts;
+  if (fwrite(&hdr, sizeof(hdr), 1, ts->fd) != 1)
+    fatal("cannot write stats time series");
+
+  /* name the counters, a distribution bucket is named after its first
+     index, e.g., `forked:dist.PP[4]' */
+  c = ts->counters;
+  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+    {
+      switch (stat->sc)
+	{
+	case sc_int:
+	  c->sc = sc_int;
+	  c->var = stat->variant.for_int.var;
+	  break;
+	case sc_uint:
+	  c->sc = sc_uint;
+	  c->var = stat->variant.for_uint.var;
+	  break;
+#ifdef __GNUC__
+	case sc_llong:
+	  c->sc = sc_llong;
+	  c->var = stat->variant.for_llong.var;
+	  break;
+#endif /* __GNUC__ */
+	case sc_float:
+	  c->sc = sc_float;
+	  c->var = stat->variant.for_float.var;
+	  break;
+	case sc_double:
+	  c->sc = sc_double;
+	  c->var = stat->variant.for_double.var;
+	  break;
+	case sc_dist:
+	  for (i = 0; i < stat->variant.for_dist.arr_sz; i++, c++)
+	    {
+	      c->sc = sc_uint;
+	      c->var = &stat->variant.for_dist.arr[i];
+	      c->last = counter_value(c);
+	      sprintf(name, "%.*s[%u]", (int)sizeof(name) - 16, stat->name,
+		      i * stat->variant.for_dist.bucket_sz);
+	      write_str(ts->fd, name);
+	    }
+	  continue;
+	default:
+	  continue;
+	}
+      c->last = counter_value(c);
+      write_str(ts->fd, stat->name);
+      c++;
+    }
+
+  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+    {
+      if (stat->sc == sc_formula)
+	{
+	  write_str(ts->fd, stat->name);
+	  write_str(ts->fd, stat->variant.for_formula.formula);
+	}
+    }
+
+  return ts;
+}
+
+/* record the interval ending at CYCLE and INSTS */
+void
+tseries_sample(struct tseries_t *ts, SS_COUNTER_TYPE cycle,
+	       SS_COUNTER_TYPE insts)
+{
+  struct ts_counter *c;
+  unsigned char *p = ts->rec + REC_HDR_SZ;
+  unsigned int i, nchanged = 0;
+  double val, delta;
+
+  for (i = 0, c = ts->counters; i < ts->ncounters; i++, c++)
+    {
+      val = counter_value(c);
+      if (val != c->last)
+	{
+	  delta = val - c->last;
+	  c->last = val;
+	  memcpy(p, &i, sizeof(i));
+	  memcpy(p + sizeof(i), &delta, sizeof(delta));
+	  p += REC_PAIR_SZ;
+	  nchanged++;
+	}
+    }
+
+  memcpy(ts->rec, &cycle, sizeof(cycle));
+  memcpy(ts->rec + sizeof(cycle), &insts, sizeof(insts));
+  memcpy(ts->rec + 2 * sizeof(cycle), &nchanged, sizeof(nchanged));
+  if (fwrite(ts->rec, 1, p - ts->rec, ts->fd) != p - ts->rec)
+    fatal("cannot write stats time series");
+}
+
+/* close time series TS */
+void
+tseries_close(struct tseries_t *ts)
+{
+  zfclose(ts->zfd);
+  free(ts->counters);
+  free(ts->rec);
+  free(ts);
+}
+
+/* read N bytes of time series RD into P, returns FALSE at the end of the
+   file, a partial read is an error */
+static int
+read_bytes(struct tseries_reader_t *rd, void *p, size_t n)
+{
+  size_t got = fread(p, 1, n, rd->zfd->fd);
+
+  if (got == 0)
+    return FALSE;
+  if (got != n)
+    fatal("truncated stats time series");
+  return TRUE;
+}
+
+/* read a string from time series RD */
+static char *
+read_str(struct tseries_reader_t *rd)
+{
+  unsigned short len;
+  char *str;
+
+  if (!read_bytes(rd, &len, sizeof(len)))
+    fatal("truncated stats time series");
+  str = malloc(len + 1);
+  if (!str)
+    fatal("out of virtual memory");
+  if (len && !read_bytes(rd, str, len))
+    fatal("truncated stats time series");
+  str[len] = '\0';
+  return str;
+}
+
+/* open time series FNAME for reading (".gz" files are decompressed on the
+   fly), returns NULL if it cannot be opened */
+struct tseries_reader_t *
+tseries_reader_open(char *fname)
+{
+  struct tseries_reader_t *rd;
+  unsigned int i;
+
+  rd = calloc(1, sizeof(struct tseries_reader_t));
+  if (!rd)
+    fatal("out of virtual memory");
+
+  rd->zfd = zfopen(fname, "r");
+  if (!rd->zfd)
+    {
+      free(rd);
+      return NULL;
+    }
+
+  if (!read_bytes(rd, &rd->hdr, sizeof(rd->hdr))
+      || memcmp(rd->hdr.magic, TSERIES_MAGIC, sizeof(rd->hdr.magic)))
+    fatal("`%s' is not a stats time series", fname);
+  if (rd->hdr.byte_order != 0x01020304)
+    fatal("stats time series `%s' was written on a host of different "
+	  "byte order", fname);
+
+  rd->counters = calloc(rd->hdr.ncounters + 1, sizeof(char *));
+  rd->formulas = calloc(rd->hdr.nformulas + 1, sizeof(char *));
+  rd->exprs = calloc(rd->hdr.nformulas + 1, sizeof(char *));
+  rd->delta = calloc(rd->hdr.ncounters + 1, sizeof(double));
+  if (!rd->counters || !rd->formulas || !rd->exprs || !rd->delta)
+    fatal("out of virtual memory");
+
+  for (i = 0; i < rd->hdr.ncounters; i++)
+    rd->counters[i] = read_str(rd);
+  for (i = 0; i < rd->hdr.nformulas; i++)
+    {
+      rd->formulas[i] = read_str(rd);
+      rd->exprs[i] = read_str(rd);
+    }
+
+  return rd;
+}
+
+/* read the next interval into RD->CYCLE, RD->INSTS and RD->DELTA, returns
+   FALSE at the end of the series */
+int
+tseries_reader_next(struct tseries_reader_t *rd)
+{
+  unsigned int nchanged, idx;
+  double delta;
+
+  if (!read_bytes(rd, &rd->cycle, sizeof(rd->cycle)))
+    return FALSE;
+  if (!read_bytes(rd, &rd->insts, sizeof(rd->insts))
+      || !read_bytes(rd, &nchanged, sizeof(nchanged)))
+    fatal("truncated stats time series");
+
+  memset(rd->delta, 0, rd->hdr.ncounters * sizeof(double));
+  while (nchanged-- > 0)
+    {
+      if (!read_bytes(rd, &idx, sizeof(idx))
+	  || !read_bytes(rd, &delta, sizeof(delta)))
+	fatal("truncated stats time series");
+      if (idx >= rd->hdr.ncounters)
+	fatal("corrupt stats time series");
+      rd->delta[idx] = delta;
+    }
+
+  return TRUE;
+}
+
+/* close time series RD */
+void
+tseries_reader_close(struct tseries_reader_t *rd)
+{
+  unsigned int i;
+
+  zfclose(rd->zfd);
+  for (i = 0; i < rd->hdr.ncounters; i++)
+    free(rd->counters[i]);
+  for (i = 0; i < rd->hdr.nformulas; i++)
+    {
+      free(rd->formulas[i]);
+      free(rd->exprs[i]);
+    }
+  free(rd->counters);
+  free(rd->formulas);
+  free(rd->exprs);
+  free(rd->delta);
+  free(rd);
+}
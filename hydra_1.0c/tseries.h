@@ -0,0 +1,100 @@
+/*
+ * tseries.h - interval statistics time series
+ *
+ * This file is a part of the SimpleScalar tool suite, and is distributed
+ * under the same terms as the rest of the tool suite; see the copyright
+ * notice in any of the original SimpleScalar sources.
+ *
+ */
+
+#ifndef TSERIES_H
+#define TSERIES_H
+
+#include "misc.h"
+#include "ss.h"
+#include "stats.h"
+
+/*
+ * A stats time series records how every counter in a stats database changes
+ * over a run, interval by interval, so that phase behavior (IPC, forks,
+ * cache misses, ...) can be looked at after the fact.  The counters are the
+ * integer and floating point stats and each bucket of the (non-sparse)
+ * distributions; formulas are not sampled, but their text is kept so that a
+ * reader can evaluate them on each interval's deltas, e.g., the IPC of an
+ * interval.
+ *
+ * The simulator only compares each counter with its value at the previous
+ * sample and appends the ones that changed to a buffer, nothing is
+ * formatted.  The file is binary: a struct tseries_hdr, the counter names,
+ * the formula names and expressions, then one record per interval:
+ *
+ *	cycle, instructions (SS_COUNTER_TYPE each), at the end of the interval
+ *	number of counters that changed (unsigned int)
+ *	that many (counter index (unsigned int), delta (double)) pairs
+ *
+ * all in the writer's byte order.  A file name ending in `.gz' is
+ * compressed through gzip (see zfopen()).  tseries-read converts a time
+ * series to CSV.
+ */
+
+/* time series file magic */
+#define TSERIES_MAGIC		"HTS1"
+
+/* time series file header */
+struct tseries_hdr
+{
+  char magic[4];		/* TSERIES_MAGIC */
+  unsigned int byte_order;	/* 0x01020304, in the writer's byte order */
+  unsigned int ncounters;	/* number of counters */
+  unsigned int nformulas;	/* number of formulas */
+  unsigned int interval;	/* sampling interval */
+  unsigned int by_insts;	/* is INTERVAL in instructions (else cycles)? */
+};
+
+/* a time series being written */
+struct tseries_t;
+
+/* open time series file FNAME of the counters and formulas in SDB, sampled
+   every INTERVAL cycles, or instructions if BY_INSTS; stats registered
+   later are not included */
+struct tseries_t *
+tseries_open(char *fname, struct stat_sdb_t *sdb,
+	     unsigned int interval, int by_insts);
+
+/* record the interval ending at CYCLE and INSTS */
+void
+tseries_sample(struct tseries_t *ts, SS_COUNTER_TYPE cycle,
+	       SS_COUNTER_TYPE insts);
+
+/* close time series TS */
+void
+tseries_close(struct tseries_t *ts);
+
+/* a time series being read */
+struct tseries_reader_t
+{
+  struct tseries_hdr hdr;	/* file header */
+  char **counters;		/* counter names, HDR.NCOUNTERS of them */
+  char **formulas;		/* formula names, HDR.NFORMULAS of them */
+  char **exprs;			/* and their expressions */
+  SS_COUNTER_TYPE cycle;	/* end of the last interval read */
+  SS_COUNTER_TYPE insts;
+  double *delta;		/* change of each counter in it */
+  ZFILE *zfd;			/* the file */
+};
+
+/* open time series FNAME for reading (".gz" files are decompressed on the
+   fly), returns NULL if it cannot be opened */
+struct tseries_reader_t *
+tseries_reader_open(char *fname);
+
+/* read the next interval into RD->CYCLE, RD->INSTS and RD->DELTA, returns
+   FALSE at the end of the series */
+int
+tseries_reader_next(struct tseries_reader_t *rd);
+
+/* close time series RD */
+void
+tseries_reader_close(struct tseries_reader_t *rd);
+
+#endif /* TSERIES_H */
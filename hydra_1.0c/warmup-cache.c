@@ -71,6 +71,7 @@
 #include "bconf.h"
 #include "loader.h"
 #include "syscall.h"
+#include "predecode.h"
 #if 0
 #include "dlite.h"
 #endif
@@ -169,11 +170,11 @@ cache_mstate_obj(FILE *stream,			/* output stream */
 /* precise architected memory state help functions */
 #define __READ_CACHE(addr, SRC_T)					\
   ((dtlb								\
-    ? cache_access(dtlb, Read, (addr), NULL, sizeof(SRC_T), 0, NULL, NULL)\
-    : 0),								\
+    ? cache_access_fast(dtlb, Read, (addr), sizeof(SRC_T))		\
+    : (void)0),								\
    (cache_dl1								\
-    ? cache_access(cache_dl1, Read, (addr), NULL, sizeof(SRC_T), 0, NULL, NULL)\
-    : 0))
+    ? cache_access_fast(cache_dl1, Read, (addr), sizeof(SRC_T))		\
+    : (void)0))
 
 #define __READ_WORD(DST_T, SRC_T, SRC)					\
   (addr = (SRC),							\
@@ -210,12 +211,11 @@ cache_mstate_obj(FILE *stream,			/* output stream */
 
 #define __WRITE_CACHE(addr, DST_T)					\
   ((dtlb								\
-    ? cache_access(dtlb, Write, (addr), NULL, sizeof(DST_T), 0, NULL, NULL)\
-    : 0),								\
+    ? cache_access_fast(dtlb, Write, (addr), sizeof(DST_T))		\
+    : (void)0),								\
    (cache_dl1								\
-    ? cache_access(cache_dl1, Write, (addr), NULL, sizeof(DST_T),	\
-		   0, NULL, NULL)					\
-    : 0))
+    ? cache_access_fast(cache_dl1, Write, (addr), sizeof(DST_T))	\
+    : (void)0))
 
 #define WRITE_WORD(SRC, DST)						\
   (addr = (DST),							\
@@ -275,14 +275,39 @@ warmup_done(void)
   cache_mstate_obj(outfile, NULL);
 }
 
-/* start simulation, program loaded, processor precise state initialized */
+/* functionally execute the next NUM_INSN instructions from regs_PC, warming
+   the caches, TLBs and predictors on the way; returns with regs_PC at the
+   next instruction to execute */
 void
-warmup_main(SS_COUNTER_TYPE num_warmup_insn)
+warmup_insts(SS_COUNTER_TYPE num_insn)
 {
+#ifdef __GNUC__
+  /* threaded code: each pre-decoded instruction's handler is the label of
+     its opcode's implementation below, a GNU GCC extension */
+  static void *op_handler[OP_MAX] = {
+    &&opcode_NA, /* NA */
+#define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3,EXPR)	\
+    &&opcode_##OP,
+#define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
+    &&opcode_##OP,
+#define CONNECT(OP)
+#include "ss.def"
+#undef DEFINST
+#undef DEFLINK
+#undef CONNECT
+  };
+#else /* !__GNUC__ */
+  static void **op_handler = NULL;
+#endif /* __GNUC__ */
+  /* pre-decoded blocks, shared by warmup and fast-forward */
+  static struct pd_cache_t *pd = NULL;
+  struct pd_block_t *blk;
+  struct pd_inst_t *di = NULL, *di_end = NULL;
   SS_INST_TYPE inst;
   register SS_ADDR_TYPE next_PC, pred_PC;
   register SS_ADDR_TYPE addr;
   enum ss_opcode op;
+  unsigned int flags;
   register int is_write;
   struct bpred_update_info b_update_rec;
   struct bpred_recover_info bpred_recover_rec;
@@ -291,7 +316,9 @@ warmup_main(SS_COUNTER_TYPE num_warmup_insn)
   int base_caller_supplies_tos = pred->retstack.caller_supplies_tos;
 
   pred->retstack.caller_supplies_tos = FALSE;
-  fprintf(outfile, "sim: ** starting functional simulation w/ caches **\n");
+
+  if (!pd)
+    pd = pd_create(op_handler);
 
   /* set up initial PC, default next PC */
   next_PC = regs_PC + SS_INST_SIZE;
@@ -304,10 +331,9 @@ warmup_main(SS_COUNTER_TYPE num_warmup_insn)
 
   while (TRUE)
     {
-      if (sim_num_insn - start_insn > num_warmup_insn)
+      if (sim_num_insn - start_insn >= num_insn)
 	{
 	  pred->retstack.caller_supplies_tos = base_caller_supplies_tos;
-	  warmup_done();
 	  return;
 	}
 
@@ -328,19 +354,26 @@ warmup_main(SS_COUNTER_TYPE num_warmup_insn)
       /* keep an instruction count */
       sim_num_insn++;
 
-      /* get the next instruction to execute */
+      /* get the next instruction to execute, moving on to the block at
+	 regs_PC at the end of a block or on a taken branch */
+      if (di == di_end || di->pc != regs_PC)
+	{
+	  blk = pd_lookup(pd, regs_PC);
+	  di = blk->insts;
+	  di_end = di + blk->ninsts;
+	}
       if (itlb)
-	cache_access(itlb, Read, IACOMPRESS(regs_PC),
-		     NULL, ISCOMPRESS(SS_INST_SIZE), 0, NULL, NULL);
+	cache_access_fast(itlb, Read, IACOMPRESS(regs_PC),
+			  ISCOMPRESS(SS_INST_SIZE));
       if (cache_il1)
-	cache_access(cache_il1, Read, IACOMPRESS(regs_PC),
-		     NULL, ISCOMPRESS(SS_INST_SIZE), 0, NULL, NULL);
-      mem_access(Read, regs_PC, &inst, SS_INST_SIZE);
+	cache_access_fast(cache_il1, Read, IACOMPRESS(regs_PC),
+			  ISCOMPRESS(SS_INST_SIZE));
+      inst = di->inst;
+      op = di->op;
+      flags = di->flags;
 
-      op = SS_OPCODE(inst);
- 
       /* prime the branch predictor: lookup */
-      if (pred && (SS_OP_FLAGS(op) & F_CTRL))
+      if (pred && (flags & F_CTRL))
 	{
 	  pred_PC = bpred_lookup(pred, regs_PC, 0, 0, 0, 
 				 op, (RS) == 31, (RD) == 31, &junk, TRUE,
@@ -357,7 +390,25 @@ warmup_main(SS_COUNTER_TYPE num_warmup_insn)
       /* set default reference address and access mode */
       addr = 0; is_write = FALSE;
 
-      /* decode the instruction */
+      /* execute the instruction */
+#ifdef __GNUC__
+      goto *di->handler;
+#define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3,EXPR)	\
+    opcode_##OP:							\
+      EXPR;								\
+      goto executed;
+#define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
+    opcode_##OP:							\
+      panic("attempted to execute a linking opcode");
+#define CONNECT(OP)
+#include "ss.def"
+#undef DEFINST
+#undef DEFLINK
+#undef CONNECT
+    opcode_NA:
+      panic("attempted to execute a bogus opcode");
+    executed:
+#else /* !__GNUC__ */
       switch (op)
 	{
 #define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3,EXPR)	\
@@ -375,18 +426,20 @@ warmup_main(SS_COUNTER_TYPE num_warmup_insn)
 	default:
           panic("attempted to execute a bogus opcode");
 	}
+#endif /* __GNUC__ */
+      di++;
 
-      if (SS_OP_FLAGS(op) & F_MEM)
+      if (flags & F_MEM)
 	{
 	  sim_num_refs++;
-	  if (SS_OP_FLAGS(op) & F_STORE)
+	  if (flags & F_STORE)
 	    is_write = TRUE;
 	  else
 	    sim_num_loads++;
 	}
 
       /* prime the branch predictor: update on mis-predict */
-      if (pred && (SS_OP_FLAGS(op) & F_CTRL))
+      if (pred && (flags & F_CTRL))
 	{
 	  if (pred_PC != next_PC)
 	    bpred_history_recover(pred, regs_PC,
@@ -413,7 +466,7 @@ warmup_main(SS_COUNTER_TYPE num_warmup_insn)
 	      bpred_recover_rec.contents.stack_copy = NULL;
 	    }
 	}
-      if (bconf && (SS_OP_FLAGS(op) & F_COND))
+      if (bconf && (flags & F_COND))
 	{
 	  int br_taken = (next_PC != (regs_PC + SS_INST_SIZE));
 	  int br_pred_taken = (pred_PC != (regs_PC + SS_INST_SIZE));
@@ -437,3 +490,14 @@ warmup_main(SS_COUNTER_TYPE num_warmup_insn)
       next_PC += SS_INST_SIZE;
     }
 }
+
+/* start simulation, program loaded, processor precise state initialized */
+void
+warmup_main(SS_COUNTER_TYPE num_warmup_insn)
+{
+  fprintf(outfile, "sim: ** starting functional simulation w/ caches **\n");
+
+  /* NOTE: warmup has always run one instruction past NUM_WARMUP_INSN */
+  warmup_insts(num_warmup_insn + 1);
+  warmup_done();
+}